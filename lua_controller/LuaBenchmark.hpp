@@ -0,0 +1,120 @@
+/**
+ * @file LuaBenchmark.hpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Timing utilities shared by the benchmarks of the LuaController module
+ * @date 2026-10-18
+ *
+ * @details
+ * Doesn't depend on Godot, so the same measurements can be taken by
+ * LuaControllerBenchmark inside Godot and by a standalone executable.
+ */
+
+#ifndef LUACPP_LUABENCHMARK_HPP
+#define LUACPP_LUABENCHMARK_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace LuaCpp {
+
+	namespace Benchmark {
+
+		/**
+		 * @brief Result of timing one operation many times
+		 */
+		struct Result {
+			std::string name;
+			size_t iterations = 0;
+			double median_usec = 0;
+			double p99_usec = 0;
+			double ops_per_sec = 0; //< From the mean time of an operation
+		};
+
+		/**
+		 * @brief Times each of `iterations` calls of operation, after a warm up of a tenth of them
+		 */
+		template <typename F>
+		Result Measure (const std::string &name, size_t iterations, F &&operation) {
+			using Clock = std::chrono::steady_clock;
+			iterations = std::max<size_t>(iterations, 1);
+			for (size_t i = 0; i < iterations / 10; i++) {
+				operation();
+			}
+
+			std::vector<double> times;
+			times.reserve(iterations);
+			double total = 0;
+			for (size_t i = 0; i < iterations; i++) {
+				Clock::time_point start = Clock::now();
+				operation();
+				double usec = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+				times.push_back(usec);
+				total += usec;
+			}
+			std::sort(times.begin(), times.end());
+
+			Result result;
+			result.name = name;
+			result.iterations = iterations;
+			result.median_usec = times[iterations / 2];
+			result.p99_usec = times[std::min(iterations - 1, iterations * 99 / 100)];
+			result.ops_per_sec = total > 0 ? iterations * 1e6 / total : 0;
+			return result;
+		}
+
+		/**
+		 * @brief Generates a valid Lua script with about `lines` lines, for compilation benchmarks
+		 */
+		inline std::string GenerateScript (int lines) {
+			// Blocks, so the locals stay under Lua's limit of 200 per function
+			const int BLOCK_LINES = 40;
+			std::string script;
+			for (int i = 0; i < lines; i++) {
+				if (i % BLOCK_LINES == 0) {
+					script += "do\n";
+				}
+				switch (i % 4) {
+				case 0:
+					script += "local v" + std::to_string(i) + " = " + std::to_string(i) + " * 2\n";
+					break;
+				case 1:
+					script += "local function f" + std::to_string(i) + " (a, b) return a + b end\n";
+					break;
+				case 2:
+					script += "local t" + std::to_string(i) + " = { x = 1, y = 'text', z = { 1, 2, 3 } }\n";
+					break;
+				default:
+					script += "if v" + std::to_string(i - 3) + " > 10 then v" + std::to_string(i - 3) + " = 0 end\n";
+					break;
+				}
+				if (i % BLOCK_LINES == BLOCK_LINES - 1 || i == lines - 1) {
+					script += "end\n";
+				}
+			}
+			return script;
+		}
+
+		/**
+		 * @brief Serializes the results as a JSON object, keyed by the name of each result
+		 */
+		inline std::string ToJson (const std::vector<Result> &results) {
+			std::string json = "{\n";
+			char line[256];
+			for (size_t i = 0; i < results.size(); i++) {
+				const Result &r = results[i];
+				snprintf(line, sizeof(line),
+					"\t\"%s\": { \"iterations\": %zu, \"median_usec\": %.4f, \"p99_usec\": %.4f, \"ops_per_sec\": %.1f }%s\n",
+					r.name.c_str(), r.iterations, r.median_usec, r.p99_usec, r.ops_per_sec,
+					i + 1 < results.size() ? "," : "");
+				json += line;
+			}
+			json += "}\n";
+			return json;
+		}
+	}
+}
+
+#endif // LUACPP_LUABENCHMARK_HPP
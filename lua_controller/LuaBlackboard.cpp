@@ -0,0 +1,290 @@
+/**
+ * @file LuaBlackboard.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Typed slots of values shared between the host and Lua scripts, without conversions through Variant
+ * @date 2026-10-18
+ */
+
+#include <new>
+
+#include "LuaBlackboard.hpp"
+#include "LuaVectorMath.hpp"
+
+namespace LuaCpp {
+
+const char *const BLACKBOARD_METATABLE = "luacpp.blackboard";
+
+namespace {
+	using BlackboardPtr = std::shared_ptr<LuaBlackboard>;
+
+	const std::string EMPTY_STRING;
+
+	/**
+	 * @brief Returns the handle of the key at idx: an integer handle, or an interned name.
+	 * Returns -1 if there is none, or if the name isn't interned and intern is false
+	 */
+	int keyToSlot (lua_State *L, LuaBlackboard &blackboard, int idx, bool intern) {
+		int key_type = lua_type(L, idx);
+		if (key_type == LUA_TNUMBER) {
+			int is_integer = 0;
+			lua_Integer handle = lua_tointegerx(L, idx, &is_integer);
+			return is_integer && handle >= 0 && blackboard.isValid((int) handle) ? (int) handle : -1;
+		}
+		if (key_type != LUA_TSTRING) {
+			return -1;
+		}
+		size_t len = 0;
+		const char *name = lua_tolstring(L, idx, &len);
+		std::string key(name, len);
+		return intern ? blackboard.Intern(key) : blackboard.Find(key);
+	}
+
+	int blackboardIndex (lua_State *L) {
+		LuaBlackboard &blackboard = **(BlackboardPtr *) luaL_checkudata(L, 1, BLACKBOARD_METATABLE);
+		int slot = keyToSlot(L, blackboard, 2, false);
+		if (slot < 0) {
+			lua_pushnil(L);
+		} else {
+			blackboard.Push(L, slot);
+		}
+		return 1;
+	}
+
+	int blackboardNewIndex (lua_State *L) {
+		LuaBlackboard &blackboard = **(BlackboardPtr *) luaL_checkudata(L, 1, BLACKBOARD_METATABLE);
+		// Integer keys must be handles, names are interned on the first write
+		int slot = keyToSlot(L, blackboard, 2, true);
+		if (slot < 0) {
+			return luaL_error(L, "invalid blackboard key, expected a handle or a name");
+		}
+		if (!blackboard.Assign(L, slot, 3)) {
+			return luaL_error(L, "a blackboard can't store a %s", luaL_typename(L, 3));
+		}
+		return 0;
+	}
+
+	/* blackboard(name) returns the handle of name */
+	int blackboardCall (lua_State *L) {
+		LuaBlackboard &blackboard = **(BlackboardPtr *) luaL_checkudata(L, 1, BLACKBOARD_METATABLE);
+		luaL_checktype(L, 2, LUA_TSTRING);
+		lua_pushinteger(L, keyToSlot(L, blackboard, 2, true));
+		return 1;
+	}
+
+	int blackboardLen (lua_State *L) {
+		LuaBlackboard &blackboard = **(BlackboardPtr *) luaL_checkudata(L, 1, BLACKBOARD_METATABLE);
+		lua_pushinteger(L, (lua_Integer) blackboard.Size());
+		return 1;
+	}
+
+	int blackboardGC (lua_State *L) {
+		BlackboardPtr *blackboard = (BlackboardPtr *) luaL_checkudata(L, 1, BLACKBOARD_METATABLE);
+		blackboard->~BlackboardPtr();
+		return 0;
+	}
+
+	void pushMetatable (lua_State *L) {
+		if (luaL_newmetatable(L, BLACKBOARD_METATABLE)) {
+			const luaL_Reg metamethods[] = {
+				{ "__index", blackboardIndex },
+				{ "__newindex", blackboardNewIndex },
+				{ "__call", blackboardCall },
+				{ "__len", blackboardLen },
+				{ "__gc", blackboardGC },
+				{ nullptr, nullptr }
+			};
+			luaL_setfuncs(L, metamethods, 0);
+		}
+	}
+}
+
+int LuaBlackboard::Intern (const std::string &name) {
+	auto found = handles.find(name);
+	if (found != handles.end()) {
+		return found->second;
+	}
+	int slot = (int) slots.size();
+	slots.emplace_back();
+	names.push_back(name);
+	handles.emplace(name, slot);
+	return slot;
+}
+
+int LuaBlackboard::Find (const std::string &name) const {
+	auto found = handles.find(name);
+	return found != handles.end() ? found->second : -1;
+}
+
+const std::string &LuaBlackboard::getName (int slot) const {
+	return isValid(slot) ? names[slot] : EMPTY_STRING;
+}
+
+void LuaBlackboard::SetNil (int slot) {
+	slots[slot].type = SLOT_NIL;
+	slots[slot].string.clear();
+}
+
+void LuaBlackboard::SetBool (int slot, bool value) {
+	slots[slot].type = SLOT_BOOL;
+	slots[slot].boolean = value;
+}
+
+void LuaBlackboard::SetInt (int slot, lua_Integer value) {
+	slots[slot].type = SLOT_INT;
+	slots[slot].integer = value;
+}
+
+void LuaBlackboard::SetFloat (int slot, lua_Number value) {
+	slots[slot].type = SLOT_FLOAT;
+	slots[slot].number = value;
+}
+
+void LuaBlackboard::SetVec2 (int slot, lua_Number x, lua_Number y) {
+	Slot &s = slots[slot];
+	s.type = SLOT_VEC2;
+	s.vec[0] = x;
+	s.vec[1] = y;
+	s.vec[2] = 0;
+}
+
+void LuaBlackboard::SetVec3 (int slot, lua_Number x, lua_Number y, lua_Number z) {
+	Slot &s = slots[slot];
+	s.type = SLOT_VEC3;
+	s.vec[0] = x;
+	s.vec[1] = y;
+	s.vec[2] = z;
+}
+
+void LuaBlackboard::SetString (int slot, const std::string &value) {
+	slots[slot].type = SLOT_STRING;
+	// Reuses the capacity of the slot's string
+	slots[slot].string.assign(value);
+}
+
+bool LuaBlackboard::getBool (int slot) const {
+	const Slot &s = slots[slot];
+	if (s.type == SLOT_BOOL) {
+		return s.boolean;
+	}
+	return s.type != SLOT_NIL;
+}
+
+lua_Integer LuaBlackboard::getInt (int slot) const {
+	const Slot &s = slots[slot];
+	switch (s.type) {
+	case SLOT_INT:
+		return s.integer;
+	case SLOT_FLOAT:
+		return (lua_Integer) s.number;
+	case SLOT_BOOL:
+		return s.boolean ? 1 : 0;
+	default:
+		return 0;
+	}
+}
+
+lua_Number LuaBlackboard::getFloat (int slot) const {
+	const Slot &s = slots[slot];
+	switch (s.type) {
+	case SLOT_FLOAT:
+		return s.number;
+	case SLOT_INT:
+		return (lua_Number) s.integer;
+	case SLOT_BOOL:
+		return s.boolean ? 1 : 0;
+	default:
+		return 0;
+	}
+}
+
+const std::string &LuaBlackboard::getString (int slot) const {
+	return slots[slot].type == SLOT_STRING ? slots[slot].string : EMPTY_STRING;
+}
+
+void LuaBlackboard::Clear () {
+	for (Slot &s : slots) {
+		s.type = SLOT_NIL;
+		s.string.clear();
+	}
+}
+
+void LuaBlackboard::Push (lua_State *L, int slot) const {
+	const Slot &s = slots[slot];
+	switch (s.type) {
+	case SLOT_BOOL:
+		lua_pushboolean(L, s.boolean);
+		break;
+	case SLOT_INT:
+		lua_pushinteger(L, s.integer);
+		break;
+	case SLOT_FLOAT:
+		lua_pushnumber(L, s.number);
+		break;
+	case SLOT_VEC2:
+		VectorMath::pushVec2(L, s.vec[0], s.vec[1]);
+		break;
+	case SLOT_VEC3:
+		VectorMath::pushVec3(L, s.vec[0], s.vec[1], s.vec[2]);
+		break;
+	case SLOT_STRING:
+		lua_pushlstring(L, s.string.data(), s.string.size());
+		break;
+	default:
+		lua_pushnil(L);
+		break;
+	}
+}
+
+bool LuaBlackboard::Assign (lua_State *L, int slot, int idx) {
+	switch (lua_type(L, idx)) {
+	case LUA_TNIL:
+		SetNil(slot);
+		return true;
+	case LUA_TBOOLEAN:
+		SetBool(slot, lua_toboolean(L, idx));
+		return true;
+	case LUA_TNUMBER:
+		if (lua_isinteger(L, idx)) {
+			SetInt(slot, lua_tointeger(L, idx));
+		} else {
+			SetFloat(slot, lua_tonumber(L, idx));
+		}
+		return true;
+	case LUA_TSTRING: {
+		size_t len = 0;
+		const char *value = lua_tolstring(L, idx, &len);
+		Slot &s = slots[slot];
+		s.type = SLOT_STRING;
+		s.string.assign(value, len);
+		return true;
+	}
+	case LUA_TUSERDATA:
+		if (VectorMath::Vec3 *v3 = VectorMath::toVec3(L, idx)) {
+			SetVec3(slot, v3->v[0], v3->v[1], v3->v[2]);
+			return true;
+		}
+		if (VectorMath::Vec2 *v2 = VectorMath::toVec2(L, idx)) {
+			SetVec2(slot, v2->v[0], v2->v[1]);
+			return true;
+		}
+		return false;
+	default:
+		return false;
+	}
+}
+
+void pushBlackboard (lua_State *L, const std::shared_ptr<LuaBlackboard> &blackboard) {
+	// The metatable first, so a memory error can't leave the pointer without its __gc
+	pushMetatable(L);
+	void *data = lua_newuserdata(L, sizeof(BlackboardPtr));
+	new (data) BlackboardPtr(blackboard);
+	lua_insert(L, -2);
+	lua_setmetatable(L, -2);
+}
+
+LuaBlackboard *toBlackboard (lua_State *L, int idx) {
+	BlackboardPtr *blackboard = (BlackboardPtr *) luaL_testudata(L, idx, BLACKBOARD_METATABLE);
+	return blackboard ? blackboard->get() : nullptr;
+}
+
+} /* namespace LuaCpp */
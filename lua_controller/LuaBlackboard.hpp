@@ -0,0 +1,146 @@
+/**
+ * @file LuaBlackboard.hpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Typed slots of values shared between the host and Lua scripts, without conversions through Variant
+ * @date 2026-10-18
+ *
+ * @details
+ * Each name is interned once into a slot, whose index is a handle valid for
+ * the lifetime of the blackboard. A slot holds a nil, boolean, integer, number,
+ * vec2, vec3 or string. In Lua, a blackboard is a userdata:
+ *
+ *     local health = blackboard("health")  -- interns the name, returns its handle
+ *     blackboard[health] = 100              -- by handle: an index into the slots
+ *     blackboard.target = vmath.vec3(1, 2, 3)
+ *     print(blackboard.target, #blackboard) -- by name: a hash lookup
+ *
+ * It isn't synchronized: it must be used from one thread at a time, like the
+ * states of a LuaControllerContext.
+ *
+ * This file doesn't depend on Godot, so the blackboard can be used by any LuaState.
+ */
+
+#ifndef LUACPP_LUABLACKBOARD_HPP
+#define LUACPP_LUABLACKBOARD_HPP
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <LuaCpp.hpp>
+
+namespace LuaCpp {
+
+	/**
+	 * @brief Name of the metatable of the blackboard userdata, stored in the registry of each LuaState
+	 */
+	extern const char *const BLACKBOARD_METATABLE;
+
+	class LuaBlackboard {
+	public:
+		enum SlotType {
+			SLOT_NIL,
+			SLOT_BOOL,
+			SLOT_INT,
+			SLOT_FLOAT,
+			SLOT_VEC2,
+			SLOT_VEC3,
+			SLOT_STRING
+		};
+
+		struct Slot {
+			SlotType type;
+			union {
+				bool boolean;
+				lua_Integer integer;
+				lua_Number number;
+				lua_Number vec[3];
+			};
+			std::string string;
+
+			Slot () : type(SLOT_NIL), vec{ 0, 0, 0 }, string() {}
+		};
+
+	private:
+		std::vector<Slot> slots;
+		std::vector<std::string> names;
+		std::unordered_map<std::string, int> handles;
+
+	public:
+		/**
+		 * @brief Returns the handle of name, creating a nil slot the first time
+		 */
+		int Intern (const std::string &name);
+
+		/**
+		 * @brief Returns the handle of name, or -1 if it was never interned
+		 */
+		int Find (const std::string &name) const;
+
+		bool isValid (int slot) const {
+			return slot >= 0 && (size_t) slot < slots.size();
+		}
+
+		size_t Size () const {
+			return slots.size();
+		}
+
+		const std::string &getName (int slot) const;
+
+		/**
+		 * @brief Returns the slot. The handle must be valid
+		 */
+		const Slot &getSlot (int slot) const {
+			return slots[slot];
+		}
+
+		/**
+		 * @brief Setters of each type. The handle must be valid, and the slot takes the new type
+		 */
+		void SetNil (int slot);
+		void SetBool (int slot, bool value);
+		void SetInt (int slot, lua_Integer value);
+		void SetFloat (int slot, lua_Number value);
+		void SetVec2 (int slot, lua_Number x, lua_Number y);
+		void SetVec3 (int slot, lua_Number x, lua_Number y, lua_Number z);
+		void SetString (int slot, const std::string &value);
+
+		/**
+		 * @brief Getters of each type. Numbers are converted between integer and float,
+		 * booleans follow Lua's truthiness, and any other mismatch returns zero or empty
+		 */
+		bool getBool (int slot) const;
+		lua_Integer getInt (int slot) const;
+		lua_Number getFloat (int slot) const;
+		const std::string &getString (int slot) const;
+
+		/**
+		 * @brief Sets every slot to nil. The handles stay valid
+		 */
+		void Clear ();
+
+		/**
+		 * @brief Pushes the value of the slot on L, vectors as vmath userdata
+		 */
+		void Push (lua_State *L, int slot) const;
+
+		/**
+		 * @brief Stores the value at idx of L into the slot
+		 *
+		 * @return false if the value's type can't be stored, the slot is unchanged
+		 */
+		bool Assign (lua_State *L, int slot, int idx);
+	};
+
+	/**
+	 * @brief Pushes a userdata that shares the ownership of blackboard
+	 */
+	void pushBlackboard (lua_State *L, const std::shared_ptr<LuaBlackboard> &blackboard);
+
+	/**
+	 * @brief Returns the blackboard of the userdata at idx, or nullptr if it isn't one
+	 */
+	LuaBlackboard *toBlackboard (lua_State *L, int idx);
+}
+
+#endif // LUACPP_LUABLACKBOARD_HPP
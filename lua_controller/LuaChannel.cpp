@@ -0,0 +1,495 @@
+/**
+ * @file LuaChannel.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Bounded lock-free message channels between Lua states, found by name
+ * @date 2026-10-18
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "LuaChannel.hpp"
+#include "LuaVectorMath.hpp"
+
+namespace LuaCpp {
+
+const char *const CHANNEL_METATABLE = "luacpp.channel";
+
+namespace {
+	using ChannelPtr = std::shared_ptr<LuaChannel>;
+
+	/**
+	 * @brief First byte of each serialized value
+	 */
+	enum Tag : uint8_t {
+		TAG_NIL,
+		TAG_FALSE,
+		TAG_TRUE,
+		TAG_INTEGER,
+		TAG_NUMBER,
+		TAG_STRING,
+		TAG_TABLE,
+		TAG_TABLE_END,
+		TAG_VEC2,
+		TAG_VEC3,
+		TAG_QUAT,
+		TAG_TRANSFORM
+	};
+
+	struct ChannelRegistry {
+		std::mutex mutex;
+		std::map<std::string, ChannelPtr> channels;
+	};
+
+	ChannelRegistry &registry () {
+		static ChannelRegistry instance;
+		return instance;
+	}
+
+	/* Integers are written 7 bits per byte, zigzag encoded so small negatives are short too */
+	void writeVarint (std::string &out, uint64_t value) {
+		while (value >= 0x80) {
+			out += (char) ((value & 0x7f) | 0x80);
+			value >>= 7;
+		}
+		out += (char) value;
+	}
+
+	bool readVarint (const char *&p, const char *end, uint64_t &value) {
+		value = 0;
+		for (int shift = 0; shift < 64 && p < end; shift += 7) {
+			uint8_t byte = (uint8_t) *p++;
+			value |= (uint64_t) (byte & 0x7f) << shift;
+			if (!(byte & 0x80)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	template <typename T>
+	void writeRaw (std::string &out, const T &value) {
+		out.append((const char *) &value, sizeof(T));
+	}
+
+	template <typename T>
+	bool readRaw (const char *&p, const char *end, T &value) {
+		if ((size_t) (end - p) < sizeof(T)) {
+			return false;
+		}
+		memcpy(&value, p, sizeof(T));
+		p += sizeof(T);
+		return true;
+	}
+
+	struct SerializeState {
+		std::vector<const void *> path;  //< Tables being serialized, from the outermost
+		size_t tables = 0;
+	};
+
+	bool serializeValue (lua_State *L, int idx, std::string &out, SerializeState &state) {
+		switch (lua_type(L, idx)) {
+		case LUA_TNIL:
+			out += (char) TAG_NIL;
+			return true;
+		case LUA_TBOOLEAN:
+			out += (char) (lua_toboolean(L, idx) ? TAG_TRUE : TAG_FALSE);
+			return true;
+		case LUA_TNUMBER:
+			if (lua_isinteger(L, idx)) {
+				uint64_t value = (uint64_t) lua_tointeger(L, idx);
+				out += (char) TAG_INTEGER;
+				writeVarint(out, (value << 1) ^ ((value >> 63) ? ~(uint64_t) 0 : 0));
+			} else {
+				out += (char) TAG_NUMBER;
+				writeRaw(out, lua_tonumber(L, idx));
+			}
+			return true;
+		case LUA_TSTRING: {
+			size_t len = 0;
+			const char *value = lua_tolstring(L, idx, &len);
+			out += (char) TAG_STRING;
+			writeVarint(out, len);
+			out.append(value, len);
+			return true;
+		}
+		case LUA_TTABLE: {
+			if (state.path.size() >= (size_t) LuaChannel::MAX_NESTING || ++state.tables > LuaChannel::MAX_TABLES
+					|| !lua_checkstack(L, 2)) {
+				return false;
+			}
+			const void *table = lua_topointer(L, idx);
+			// A table inside itself is a cycle
+			if (std::find(state.path.begin(), state.path.end(), table) != state.path.end()) {
+				return false;
+			}
+			state.path.push_back(table);
+			idx = lua_absindex(L, idx);
+			out += (char) TAG_TABLE;
+			lua_pushnil(L);
+			while (lua_next(L, idx)) {
+				if (!serializeValue(L, -2, out, state) || !serializeValue(L, -1, out, state)) {
+					lua_pop(L, 2);
+					return false;
+				}
+				lua_pop(L, 1);
+			}
+			state.path.pop_back();
+			out += (char) TAG_TABLE_END;
+			return true;
+		}
+		case LUA_TUSERDATA:
+			if (VectorMath::Vec3 *v3 = VectorMath::toVec3(L, idx)) {
+				out += (char) TAG_VEC3;
+				writeRaw(out, *v3);
+				return true;
+			}
+			if (VectorMath::Vec2 *v2 = VectorMath::toVec2(L, idx)) {
+				out += (char) TAG_VEC2;
+				writeRaw(out, *v2);
+				return true;
+			}
+			if (VectorMath::Quat *q = VectorMath::toQuat(L, idx)) {
+				out += (char) TAG_QUAT;
+				writeRaw(out, *q);
+				return true;
+			}
+			if (VectorMath::Transform *t = VectorMath::toTransform(L, idx)) {
+				out += (char) TAG_TRANSFORM;
+				writeRaw(out, *t);
+				return true;
+			}
+			return false;
+		default:
+			return false;
+		}
+	}
+
+	/**
+	 * @brief Pushes the value at p, advancing it. Pushes nothing on failure
+	 */
+	bool deserializeValue (lua_State *L, const char *&p, const char *end, int depth) {
+		if (p >= end || !lua_checkstack(L, 3)) {
+			return false;
+		}
+		switch ((Tag) (uint8_t) *p++) {
+		case TAG_NIL:
+			lua_pushnil(L);
+			return true;
+		case TAG_FALSE:
+		case TAG_TRUE:
+			lua_pushboolean(L, p[-1] == (char) TAG_TRUE);
+			return true;
+		case TAG_INTEGER: {
+			uint64_t value = 0;
+			if (!readVarint(p, end, value)) {
+				return false;
+			}
+			lua_pushinteger(L, (lua_Integer) ((value >> 1) ^ ((value & 1) ? ~(uint64_t) 0 : 0)));
+			return true;
+		}
+		case TAG_NUMBER: {
+			lua_Number value = 0;
+			if (!readRaw(p, end, value)) {
+				return false;
+			}
+			lua_pushnumber(L, value);
+			return true;
+		}
+		case TAG_STRING: {
+			uint64_t len = 0;
+			if (!readVarint(p, end, len) || len > (uint64_t) (end - p)) {
+				return false;
+			}
+			lua_pushlstring(L, p, (size_t) len);
+			p += len;
+			return true;
+		}
+		case TAG_TABLE:
+			if (depth >= LuaChannel::MAX_NESTING) {
+				return false;
+			}
+			lua_newtable(L);
+			while (p < end && *p != (char) TAG_TABLE_END) {
+				if (!deserializeValue(L, p, end, depth + 1)) {
+					lua_pop(L, 1);
+					return false;
+				}
+				// A table can't have a nil or NaN key
+				bool valid_key = !lua_isnil(L, -1) &&
+					!(lua_type(L, -1) == LUA_TNUMBER && !lua_isinteger(L, -1) && std::isnan(lua_tonumber(L, -1)));
+				if (!valid_key || !deserializeValue(L, p, end, depth + 1)) {
+					lua_pop(L, 2);
+					return false;
+				}
+				lua_rawset(L, -3);
+			}
+			if (p >= end) {
+				lua_pop(L, 1);
+				return false;
+			}
+			p++;
+			return true;
+		case TAG_VEC2: {
+			VectorMath::Vec2 v;
+			if (!readRaw(p, end, v)) {
+				return false;
+			}
+			VectorMath::pushVec2(L, v.v[0], v.v[1]);
+			return true;
+		}
+		case TAG_VEC3: {
+			VectorMath::Vec3 v;
+			if (!readRaw(p, end, v)) {
+				return false;
+			}
+			VectorMath::pushVec3(L, v.v[0], v.v[1], v.v[2]);
+			return true;
+		}
+		case TAG_QUAT: {
+			VectorMath::Quat q;
+			if (!readRaw(p, end, q)) {
+				return false;
+			}
+			VectorMath::pushQuat(L, q.x, q.y, q.z, q.w);
+			return true;
+		}
+		case TAG_TRANSFORM: {
+			VectorMath::Transform t;
+			if (!readRaw(p, end, t)) {
+				return false;
+			}
+			VectorMath::pushTransform(L, t);
+			return true;
+		}
+		default:
+			return false;
+		}
+	}
+
+	/**
+	 * @brief Buffer of the messages posted and received by this thread. It only holds
+	 * one message at a time, and is swapped with the buffers of the cells
+	 */
+	std::string &threadBuffer () {
+		thread_local std::string buffer;
+		return buffer;
+	}
+
+	int channelOpen (lua_State *L) {
+		const char *name = luaL_checkstring(L, 1);
+		lua_Integer capacity = luaL_optinteger(L, 2, (lua_Integer) LuaChannel::DEFAULT_CAPACITY);
+		luaL_argcheck(L, capacity > 0, 2, "the capacity must be positive");
+		luaL_argcheck(L, (size_t) capacity <= LuaChannel::MAX_CAPACITY, 2, "the capacity is too large");
+		pushChannel(L, LuaChannel::Open(name, (size_t) capacity));
+		return 1;
+	}
+
+	int channelPost (lua_State *L) {
+		LuaChannel &channel = **(ChannelPtr *) luaL_checkudata(L, 1, CHANNEL_METATABLE);
+		luaL_checkany(L, 2);
+		std::string &buffer = threadBuffer();
+		buffer.clear();
+		if (!LuaChannel::Serialize(L, 2, buffer)) {
+			return luaL_error(L, "can't post a %s: only nil, booleans, numbers, strings, vmath values "
+				"and tables of them, without cycles, up to %d levels deep and %d tables, can be posted",
+				luaL_typename(L, 2), LuaChannel::MAX_NESTING, (int) LuaChannel::MAX_TABLES);
+		}
+		lua_pushboolean(L, channel.Post(buffer));
+		return 1;
+	}
+
+	int channelReceive (lua_State *L) {
+		LuaChannel &channel = **(ChannelPtr *) luaL_checkudata(L, 1, CHANNEL_METATABLE);
+		std::string &buffer = threadBuffer();
+		if (!channel.Receive(buffer)) {
+			lua_pushboolean(L, false);
+			return 1;
+		}
+		lua_pushboolean(L, true);
+		if (!LuaChannel::Deserialize(L, buffer)) {
+			return luaL_error(L, "malformed message in the channel");
+		}
+		return 2;
+	}
+
+	int channelCapacity (lua_State *L) {
+		LuaChannel &channel = **(ChannelPtr *) luaL_checkudata(L, 1, CHANNEL_METATABLE);
+		lua_pushinteger(L, (lua_Integer) channel.Capacity());
+		return 1;
+	}
+
+	int channelLen (lua_State *L) {
+		LuaChannel &channel = **(ChannelPtr *) luaL_checkudata(L, 1, CHANNEL_METATABLE);
+		lua_pushinteger(L, (lua_Integer) channel.Size());
+		return 1;
+	}
+
+	int channelGC (lua_State *L) {
+		ChannelPtr *channel = (ChannelPtr *) luaL_checkudata(L, 1, CHANNEL_METATABLE);
+		channel->~ChannelPtr();
+		return 0;
+	}
+
+	void pushMetatable (lua_State *L) {
+		if (luaL_newmetatable(L, CHANNEL_METATABLE)) {
+			const luaL_Reg metamethods[] = {
+				{ "__len", channelLen },
+				{ "__gc", channelGC },
+				{ nullptr, nullptr }
+			};
+			luaL_setfuncs(L, metamethods, 0);
+			const luaL_Reg methods[] = {
+				{ "post", channelPost },
+				{ "receive", channelReceive },
+				{ "capacity", channelCapacity },
+				{ nullptr, nullptr }
+			};
+			luaL_newlib(L, methods);
+			lua_setfield(L, -2, "__index");
+		}
+	}
+}
+
+LuaChannel::LuaChannel (size_t capacity) {
+	capacity = std::min(capacity, MAX_CAPACITY);
+	size_t size = 2;
+	while (size < capacity) {
+		size <<= 1;
+	}
+	cells.reset(new Cell[size]);
+	mask = size - 1;
+	for (size_t i = 0; i < size; i++) {
+		cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	post_position.store(0, std::memory_order_relaxed);
+	receive_position.store(0, std::memory_order_relaxed);
+}
+
+bool LuaChannel::Post (std::string &message) {
+	size_t position = post_position.load(std::memory_order_relaxed);
+	Cell *cell;
+	for (;;) {
+		cell = &cells[position & mask];
+		size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+		if (difference == 0) {
+			// The cell is free: claims it
+			if (post_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (difference < 0) {
+			// The cell still holds the message of the previous lap
+			return false;
+		} else {
+			position = post_position.load(std::memory_order_relaxed);
+		}
+	}
+	cell->message.swap(message);
+	// Publishes the message to the receivers
+	cell->sequence.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+bool LuaChannel::Receive (std::string &message) {
+	size_t position = receive_position.load(std::memory_order_relaxed);
+	Cell *cell;
+	for (;;) {
+		cell = &cells[position & mask];
+		size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		intptr_t difference = (intptr_t) sequence - (intptr_t) (position + 1);
+		if (difference == 0) {
+			if (receive_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+				break;
+			}
+		} else if (difference < 0) {
+			// Nothing was posted to the cell yet
+			return false;
+		} else {
+			position = receive_position.load(std::memory_order_relaxed);
+		}
+	}
+	cell->message.swap(message);
+	// Frees the cell for the next lap of the posters
+	cell->sequence.store(position + mask + 1, std::memory_order_release);
+	return true;
+}
+
+size_t LuaChannel::Size () const {
+	size_t received = receive_position.load(std::memory_order_relaxed);
+	size_t posted = post_position.load(std::memory_order_relaxed);
+	return posted > received ? posted - received : 0;
+}
+
+bool LuaChannel::Serialize (lua_State *L, int idx, std::string &out) {
+	SerializeState state;
+	return serializeValue(L, idx, out, state);
+}
+
+bool LuaChannel::Deserialize (lua_State *L, const std::string &message) {
+	const char *p = message.data();
+	const char *end = p + message.size();
+	if (!deserializeValue(L, p, end, 0)) {
+		return false;
+	}
+	if (p != end) {
+		lua_pop(L, 1);
+		return false;
+	}
+	return true;
+}
+
+std::shared_ptr<LuaChannel> LuaChannel::Open (const std::string &name, size_t capacity) {
+	ChannelRegistry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	ChannelPtr &channel = reg.channels[name];
+	if (!channel) {
+		channel = std::make_shared<LuaChannel>(capacity);
+	}
+	return channel;
+}
+
+bool LuaChannel::Remove (const std::string &name) {
+	ChannelRegistry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	return reg.channels.erase(name) > 0;
+}
+
+std::vector<std::string> LuaChannel::Names () {
+	ChannelRegistry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	std::vector<std::string> names;
+	names.reserve(reg.channels.size());
+	for (const auto &channel : reg.channels) {
+		names.push_back(channel.first);
+	}
+	return names;
+}
+
+void pushChannel (lua_State *L, const std::shared_ptr<LuaChannel> &channel) {
+	// The metatable first, so a memory error can't leave the pointer without its __gc
+	pushMetatable(L);
+	void *data = lua_newuserdata(L, sizeof(ChannelPtr));
+	new (data) ChannelPtr(channel);
+	lua_insert(L, -2);
+	lua_setmetatable(L, -2);
+}
+
+LuaChannel *toChannel (lua_State *L, int idx) {
+	ChannelPtr *channel = (ChannelPtr *) luaL_testudata(L, idx, CHANNEL_METATABLE);
+	return channel ? channel->get() : nullptr;
+}
+
+std::shared_ptr<Registry::LuaLibrary> newChannelLibrary () {
+	auto lib = std::make_shared<Registry::LuaLibrary>("channel");
+	lib->AddCFunction("open", channelOpen);
+	return lib;
+}
+
+} /* namespace LuaCpp */
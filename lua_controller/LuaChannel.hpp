@@ -0,0 +1,169 @@
+/**
+ * @file LuaChannel.hpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Bounded lock-free message channels between Lua states, found by name
+ * @date 2026-10-18
+ *
+ * @details
+ * A channel is a ring of message buffers with a sequence number per cell
+ * (Vyukov's bounded queue): any number of threads can post and receive without
+ * locks, so it works as SPSC and MPSC alike. Messages are Lua values serialized
+ * to a compact binary form, so a state only reads copies, never another state's
+ * objects. The buffers are swapped in and out of the cells, so a steady flow of
+ * messages doesn't allocate.
+ *
+ * In Lua, the "channel" library opens channels by name:
+ *
+ *     local inbox = channel.open("squad", 256)  -- the capacity is only used by the first open
+ *     inbox:post({ kind = "seen", at = vmath.vec3(1, 2, 3) })  -- false if the channel is full
+ *     local ok, message = inbox:receive()       -- false if it's empty
+ *     print(#inbox, inbox:capacity())
+ *
+ * This file doesn't depend on Godot, so channels can be used by any LuaState.
+ */
+
+#ifndef LUACPP_LUACHANNEL_HPP
+#define LUACPP_LUACHANNEL_HPP
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <LuaCpp.hpp>
+
+namespace LuaCpp {
+
+	/**
+	 * @brief Name of the metatable of the channel userdata, stored in the registry of each LuaState
+	 */
+	extern const char *const CHANNEL_METATABLE;
+
+	class LuaChannel {
+	public:
+		static const size_t DEFAULT_CAPACITY = 1024;
+
+		/**
+		 * @brief Larger capacities are lowered to it
+		 */
+		static const size_t MAX_CAPACITY = 1 << 20;
+
+		/**
+		 * @brief Tables nested deeper can't be serialized
+		 */
+		static const int MAX_NESTING = 32;
+
+		/**
+		 * @brief Messages with more tables can't be serialized. A table reached twice counts, and is copied, twice
+		 */
+		static const size_t MAX_TABLES = 1 << 16;
+
+	private:
+		struct Cell {
+			std::atomic<size_t> sequence;
+			std::string message;
+		};
+
+		std::unique_ptr<Cell[]> cells;
+		size_t mask;
+		/* Each position in its own cache line, so producers and consumers don't share one */
+		char padding_before[64];
+		std::atomic<size_t> post_position;
+		char padding_between[64 - sizeof(std::atomic<size_t>)];
+		std::atomic<size_t> receive_position;
+		char padding_after[64 - sizeof(std::atomic<size_t>)];
+
+	public:
+		/**
+		 * @brief Creates an empty channel. The capacity is rounded up to a power of two, at least 2, and at most MAX_CAPACITY
+		 */
+		explicit LuaChannel (size_t capacity = DEFAULT_CAPACITY);
+
+		LuaChannel (const LuaChannel &) = delete;
+		LuaChannel &operator= (const LuaChannel &) = delete;
+
+		/**
+		 * @brief Posts message, swapping it with the buffer of a free cell. Safe to call from any thread
+		 *
+		 * @return false if the channel is full, message is unchanged
+		 */
+		bool Post (std::string &message);
+
+		/**
+		 * @brief Takes the oldest message, swapping it with message. Safe to call from any thread
+		 *
+		 * @return false if the channel is empty, message is unchanged
+		 */
+		bool Receive (std::string &message);
+
+		size_t Capacity () const {
+			return mask + 1;
+		}
+
+		/**
+		 * @brief Number of messages waiting. Only a hint while other threads use the channel
+		 */
+		size_t Size () const;
+
+		/**
+		 * @brief Appends the binary form of the value at idx of L to out
+		 *
+		 * Nil, booleans, numbers, strings, the vmath vectors, quat and transform, and tables
+		 * of them can be serialized. Tables are read raw, without their metatables.
+		 *
+		 * @return false if the value, or a value in it, can't be serialized. out is left partly written
+		 */
+		static bool Serialize (lua_State *L, int idx, std::string &out);
+
+		/**
+		 * @brief Pushes the value serialized in message
+		 *
+		 * @return false if the message is malformed, nothing is pushed
+		 */
+		static bool Deserialize (lua_State *L, const std::string &message);
+
+		/**
+		 * @brief Returns the channel named name, creating it with capacity if it doesn't exist
+		 */
+		static std::shared_ptr<LuaChannel> Open (const std::string &name, size_t capacity = DEFAULT_CAPACITY);
+
+		/**
+		 * @brief Forgets the channel. The states that opened it keep it until they release it
+		 *
+		 * @return true if the name was found
+		 */
+		static bool Remove (const std::string &name);
+
+		/**
+		 * @brief Returns the names of the open channels, in alphabetical order
+		 */
+		static std::vector<std::string> Names ();
+	};
+
+	/**
+	 * @brief Pushes a userdata that shares the ownership of channel
+	 */
+	void pushChannel (lua_State *L, const std::shared_ptr<LuaChannel> &channel);
+
+	/**
+	 * @brief Returns the channel of the userdata at idx, or nullptr if it isn't one
+	 */
+	LuaChannel *toChannel (lua_State *L, int idx);
+
+	/**
+	 * @brief Creates the "channel" library, to be added to a context with LuaControllerContext::AddLibrary
+	 *
+	 * @details
+	 * Functions of the library:
+	 * - open(name [, capacity]): the channel named name, created with capacity (1024 by default, 2^20 at most) the first time.
+	 *
+	 * Methods of a channel:
+	 * - post(value): sends a copy of value, returns false if the channel is full. Raises an error
+	 *   if value can't be serialized (functions, other userdata, threads, cycles, tables over 32 levels deep,
+	 *   or over 65536 tables in one message).
+	 * - receive(): returns true and the oldest message, or false if the channel is empty.
+	 * - capacity(), and #channel for the number of messages waiting.
+	 */
+	std::shared_ptr<Registry::LuaLibrary> newChannelLibrary ();
+}
+
+#endif // LUACPP_LUACHANNEL_HPP
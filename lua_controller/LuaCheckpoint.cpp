@@ -0,0 +1,627 @@
+/**
+ * @file LuaCheckpoint.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Saves a table graph of a Lua state to a binary blob, and rebuilds it in any state
+ * @date 2026-10-18
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "LuaCheckpoint.hpp"
+#include "LuaVectorMath.hpp"
+
+namespace LuaCpp {
+
+namespace {
+	const char MAGIC[4] = { 'L', 'C', 'K', 'P' };
+	const uint8_t VERSION = 2;
+
+	/**
+	 * @brief Bytes before the saved values: the magic, the version and the checksum of the values
+	 */
+	const size_t HEADER_SIZE = sizeof(MAGIC) + 1 + sizeof(uint64_t);
+
+	/**
+	 * @brief 64 bit FNV-1a hash of the saved values, so a truncated or corrupted checkpoint isn't loaded
+	 */
+	uint64_t checksum (const char *p, size_t size) {
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++) {
+			hash ^= (uint8_t) p[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	/**
+	 * @brief First byte of each saved value
+	 */
+	enum Tag : uint8_t {
+		TAG_NIL,
+		TAG_FALSE,
+		TAG_TRUE,
+		TAG_INTEGER,
+		TAG_NUMBER,
+		TAG_STRING,
+		TAG_TABLE,
+		TAG_TABLE_END,
+		TAG_FUNCTION,
+		/* A table or function saved before, by its index */
+		TAG_REFERENCE,
+		/* A value found from the roots, by its path */
+		TAG_NAMED,
+		/* An upvalue of a function saved before, by the index of the function and the upvalue's number */
+		TAG_SHARED_UPVALUE,
+		TAG_VEC2,
+		TAG_VEC3,
+		TAG_QUAT,
+		TAG_TRANSFORM
+	};
+
+	/* Same encoding as the messages of LuaChannel */
+	void writeVarint (std::string &out, uint64_t value) {
+		while (value >= 0x80) {
+			out += (char) ((value & 0x7f) | 0x80);
+			value >>= 7;
+		}
+		out += (char) value;
+	}
+
+	bool readVarint (const char *&p, const char *end, uint64_t &value) {
+		value = 0;
+		for (int shift = 0; shift < 64 && p < end; shift += 7) {
+			uint8_t byte = (uint8_t) *p++;
+			value |= (uint64_t) (byte & 0x7f) << shift;
+			if (!(byte & 0x80)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void writeString (std::string &out, const char *value, size_t len) {
+		writeVarint(out, len);
+		out.append(value, len);
+	}
+
+	template <typename T>
+	void writeRaw (std::string &out, const T &value) {
+		out.append((const char *) &value, sizeof(T));
+	}
+
+	template <typename T>
+	bool readRaw (const char *&p, const char *end, T &value) {
+		if ((size_t) (end - p) < sizeof(T)) {
+			return false;
+		}
+		memcpy(&value, p, sizeof(T));
+		p += sizeof(T);
+		return true;
+	}
+
+	/**
+	 * @brief Replaces the table and the key on top of the stack with the table's value for the key
+	 *
+	 * Called protected, since the lookup isn't raw and the `__index` of the roots may raise errors.
+	 */
+	int getField (lua_State *L) {
+		lua_gettable(L, 1);
+		return 1;
+	}
+
+	int writeChunk (lua_State *L, const void *p, size_t size, void *ud) {
+		((std::string *) ud)->append((const char *) p, size);
+		return 0;
+	}
+
+	std::string joinPath (const std::vector<std::string> &path) {
+		std::string joined;
+		for (const std::string &key : path) {
+			if (!joined.empty()) {
+				joined += '.';
+			}
+			joined += key;
+		}
+		return joined;
+	}
+
+	class Saver {
+		lua_State *L;
+		std::string &out;
+		/* Index of each table and function saved, in the order they were saved */
+		std::unordered_map<const void *, uint64_t> objects;
+		uint64_t next_object = 0;
+		/* Path of each value found from the roots */
+		std::unordered_map<const void *, std::vector<std::string>> names;
+		/* Index of the function, and number of the upvalue, where each upvalue was first saved */
+		std::unordered_map<void *, std::pair<uint64_t, int>> upvalues;
+		/* Keys leading to the value being saved, for the error messages */
+		std::vector<std::string> location;
+
+		[[noreturn]] void fail (const std::string &reason) {
+			throw std::runtime_error("Can't save " + (location.empty() ? std::string("the table") : joinPath(location)) + ": " + reason);
+		}
+
+	public:
+		Saver (lua_State *L, std::string &out) : L(L), out(out) {}
+
+		void findNames (int idx, std::vector<std::string> &path, int depth) {
+			lua_pushnil(L);
+			while (lua_next(L, idx)) {
+				int type = lua_type(L, -1);
+				if (lua_type(L, -2) == LUA_TSTRING && (type == LUA_TTABLE || type == LUA_TFUNCTION || type == LUA_TUSERDATA)) {
+					const void *p = lua_topointer(L, -1);
+					if (names.find(p) == names.end()) {
+						path.push_back(lua_tostring(L, -2));
+						names[p] = path;
+						if (type == LUA_TTABLE && depth < LuaCheckpoint::ROOTS_DEPTH && lua_checkstack(L, 3)) {
+							findNames(lua_gettop(L), path, depth + 1);
+						}
+						path.pop_back();
+					}
+				}
+				lua_pop(L, 1);
+			}
+		}
+
+		void value (int idx, int depth) {
+			idx = lua_absindex(L, idx);
+			switch (lua_type(L, idx)) {
+			case LUA_TNIL:
+				out += (char) TAG_NIL;
+				return;
+			case LUA_TBOOLEAN:
+				out += (char) (lua_toboolean(L, idx) ? TAG_TRUE : TAG_FALSE);
+				return;
+			case LUA_TNUMBER:
+				if (lua_isinteger(L, idx)) {
+					uint64_t value = (uint64_t) lua_tointeger(L, idx);
+					out += (char) TAG_INTEGER;
+					writeVarint(out, (value << 1) ^ ((value >> 63) ? ~(uint64_t) 0 : 0));
+				} else {
+					out += (char) TAG_NUMBER;
+					writeRaw(out, lua_tonumber(L, idx));
+				}
+				return;
+			case LUA_TSTRING: {
+				size_t len = 0;
+				const char *value = lua_tolstring(L, idx, &len);
+				out += (char) TAG_STRING;
+				writeString(out, value, len);
+				return;
+			}
+			case LUA_TTABLE:
+			case LUA_TFUNCTION:
+			case LUA_TUSERDATA: {
+				const void *p = lua_topointer(L, idx);
+				auto object = objects.find(p);
+				if (object != objects.end()) {
+					out += (char) TAG_REFERENCE;
+					writeVarint(out, object->second);
+					return;
+				}
+				auto name = names.find(p);
+				if (name != names.end()) {
+					out += (char) TAG_NAMED;
+					writeVarint(out, name->second.size());
+					for (const std::string &key : name->second) {
+						writeString(out, key.data(), key.size());
+					}
+					return;
+				}
+				if (lua_istable(L, idx)) {
+					table(idx, depth, true);
+				} else if (lua_isfunction(L, idx)) {
+					function(idx, depth);
+				} else {
+					userdata(idx);
+				}
+				return;
+			}
+			default:
+				fail(std::string("values of type ") + luaL_typename(L, idx) + " can't be saved");
+			}
+		}
+
+		void table (int idx, int depth, bool with_metatable) {
+			if (depth >= LuaCheckpoint::MAX_NESTING || !lua_checkstack(L, 4)) {
+				fail("the tables are nested too deep");
+			}
+			objects[lua_topointer(L, idx)] = next_object++;
+			out += (char) TAG_TABLE;
+			lua_pushnil(L);
+			while (lua_next(L, idx)) {
+				int top = lua_gettop(L);
+				location.push_back(lua_type(L, -2) == LUA_TSTRING ? lua_tostring(L, -2) : "[]");
+				value(top - 1, depth + 1);
+				value(top, depth + 1);
+				location.pop_back();
+				lua_pop(L, 1);
+			}
+			out += (char) TAG_TABLE_END;
+			if (with_metatable && lua_getmetatable(L, idx)) {
+				location.push_back("(metatable)");
+				value(-1, depth + 1);
+				location.pop_back();
+				lua_pop(L, 1);
+			} else {
+				out += (char) TAG_NIL;
+			}
+		}
+
+		void function (int idx, int depth) {
+			if (lua_iscfunction(L, idx)) {
+				fail("C functions are only saved by name, and this one isn't found from the roots");
+			}
+			if (depth >= LuaCheckpoint::MAX_NESTING || !lua_checkstack(L, 3)) {
+				fail("the values are nested too deep");
+			}
+			uint64_t index = next_object++;
+			objects[lua_topointer(L, idx)] = index;
+			out += (char) TAG_FUNCTION;
+			std::string chunk;
+			lua_pushvalue(L, idx);
+			lua_dump(L, writeChunk, &chunk, 0);
+			writeString(out, chunk.data(), chunk.size());
+
+			lua_Debug ar;
+			lua_getinfo(L, ">u", &ar);
+			writeVarint(out, ar.nups);
+			for (int i = 1; i <= ar.nups; i++) {
+				void *id = lua_upvalueid(L, idx, i);
+				auto shared = upvalues.find(id);
+				if (shared != upvalues.end()) {
+					out += (char) TAG_SHARED_UPVALUE;
+					writeVarint(out, shared->second.first);
+					writeVarint(out, (uint64_t) shared->second.second);
+					continue;
+				}
+				upvalues[id] = std::make_pair(index, i);
+				const char *name = lua_getupvalue(L, idx, i);
+				location.push_back(std::string("(upvalue ") + (name && *name ? name : "?") + ")");
+				value(-1, depth + 1);
+				location.pop_back();
+				lua_pop(L, 1);
+			}
+		}
+
+		void userdata (int idx) {
+			if (VectorMath::Vec3 *v3 = VectorMath::toVec3(L, idx)) {
+				out += (char) TAG_VEC3;
+				writeRaw(out, *v3);
+			} else if (VectorMath::Vec2 *v2 = VectorMath::toVec2(L, idx)) {
+				out += (char) TAG_VEC2;
+				writeRaw(out, *v2);
+			} else if (VectorMath::Quat *q = VectorMath::toQuat(L, idx)) {
+				out += (char) TAG_QUAT;
+				writeRaw(out, *q);
+			} else if (VectorMath::Transform *t = VectorMath::toTransform(L, idx)) {
+				out += (char) TAG_TRANSFORM;
+				writeRaw(out, *t);
+			} else {
+				fail("only the vmath userdata are saved by value, and this one isn't found from the roots");
+			}
+		}
+	};
+
+	class Loader {
+		lua_State *L;
+		const char *p;
+		const char *end;
+		int roots;
+		/* Table of the tables and functions loaded, by their index plus one */
+		int objects;
+		lua_Integer next_object = 0;
+
+		[[noreturn]] void malformed () {
+			throw std::runtime_error("The checkpoint is malformed");
+		}
+
+		uint64_t varint () {
+			uint64_t value = 0;
+			if (!readVarint(p, end, value)) {
+				malformed();
+			}
+			return value;
+		}
+
+		size_t length () {
+			uint64_t len = varint();
+			if (len > (uint64_t) (end - p)) {
+				malformed();
+			}
+			return (size_t) len;
+		}
+
+		template <typename T>
+		void raw (T &value) {
+			if (!readRaw(p, end, value)) {
+				malformed();
+			}
+		}
+
+	public:
+		Loader (lua_State *L, const char *begin, const char *end, int roots, int objects)
+			: L(L), p(begin), end(end), roots(roots), objects(objects) {}
+
+		bool finished () const {
+			return p == end;
+		}
+
+		void value (int depth) {
+			if (p >= end || !lua_checkstack(L, 4)) {
+				malformed();
+			}
+			switch ((Tag) (uint8_t) *p++) {
+			case TAG_NIL:
+				lua_pushnil(L);
+				return;
+			case TAG_FALSE:
+			case TAG_TRUE:
+				lua_pushboolean(L, p[-1] == (char) TAG_TRUE);
+				return;
+			case TAG_INTEGER: {
+				uint64_t value = varint();
+				lua_pushinteger(L, (lua_Integer) ((value >> 1) ^ ((value & 1) ? ~(uint64_t) 0 : 0)));
+				return;
+			}
+			case TAG_NUMBER: {
+				lua_Number value = 0;
+				raw(value);
+				lua_pushnumber(L, value);
+				return;
+			}
+			case TAG_STRING: {
+				size_t len = length();
+				lua_pushlstring(L, p, len);
+				p += len;
+				return;
+			}
+			case TAG_REFERENCE: {
+				uint64_t index = varint();
+				if (index >= (uint64_t) next_object || lua_rawgeti(L, objects, (lua_Integer) index + 1) == LUA_TNIL) {
+					malformed();
+				}
+				return;
+			}
+			case TAG_NAMED:
+				named();
+				return;
+			case TAG_TABLE:
+				table(depth);
+				return;
+			case TAG_FUNCTION:
+				function(depth);
+				return;
+			case TAG_VEC2: {
+				VectorMath::Vec2 v;
+				raw(v);
+				VectorMath::pushVec2(L, v.v[0], v.v[1]);
+				return;
+			}
+			case TAG_VEC3: {
+				VectorMath::Vec3 v;
+				raw(v);
+				VectorMath::pushVec3(L, v.v[0], v.v[1], v.v[2]);
+				return;
+			}
+			case TAG_QUAT: {
+				VectorMath::Quat q;
+				raw(q);
+				VectorMath::pushQuat(L, q.x, q.y, q.z, q.w);
+				return;
+			}
+			case TAG_TRANSFORM: {
+				VectorMath::Transform t;
+				raw(t);
+				VectorMath::pushTransform(L, t);
+				return;
+			}
+			default:
+				malformed();
+			}
+		}
+
+		void named () {
+			uint64_t count = varint();
+			if (count == 0) {
+				malformed();
+			}
+			std::vector<std::string> path;
+			lua_pushvalue(L, roots);
+			for (uint64_t i = 0; i < count; i++) {
+				size_t len = length();
+				path.emplace_back(p, len);
+				p += len;
+				// The lookup isn't raw, so the lazy core libraries are opened
+				if (lua_istable(L, -1)) {
+					lua_pushcfunction(L, getField);
+					lua_pushvalue(L, -2);
+					lua_pushlstring(L, path.back().data(), path.back().size());
+					if (lua_pcall(L, 2, 1, 0) != LUA_OK) {
+						// A lookup that fails finds nothing
+						lua_pop(L, 1);
+						lua_pushnil(L);
+					}
+					lua_remove(L, -2);
+				} else {
+					lua_pop(L, 1);
+					lua_pushnil(L);
+				}
+			}
+			if (lua_isnil(L, -1)) {
+				lua_pop(L, 1);
+				throw std::runtime_error("Can't restore the checkpoint: " + joinPath(path) + " isn't found");
+			}
+		}
+
+		void table (int depth) {
+			if (depth >= LuaCheckpoint::MAX_NESTING) {
+				malformed();
+			}
+			lua_newtable(L);
+			int table = lua_gettop(L);
+			lua_pushvalue(L, table);
+			lua_rawseti(L, objects, ++next_object);
+			while (true) {
+				if (p >= end) {
+					malformed();
+				}
+				if (*p == (char) TAG_TABLE_END) {
+					p++;
+					break;
+				}
+				value(depth + 1);
+				// A table can't have a nil or NaN key
+				if (lua_isnil(L, -1) || (lua_type(L, -1) == LUA_TNUMBER && !lua_isinteger(L, -1) && std::isnan(lua_tonumber(L, -1)))) {
+					malformed();
+				}
+				value(depth + 1);
+				lua_rawset(L, table);
+			}
+			value(depth + 1);
+			if (lua_istable(L, -1)) {
+				lua_setmetatable(L, table);
+			} else if (lua_isnil(L, -1)) {
+				lua_pop(L, 1);
+			} else {
+				malformed();
+			}
+		}
+
+		void function (int depth) {
+			if (depth >= LuaCheckpoint::MAX_NESTING) {
+				malformed();
+			}
+			size_t len = length();
+			if (luaL_loadbufferx(L, p, len, "=checkpoint", "b") != LUA_OK) {
+				std::string message = lua_tostring(L, -1);
+				lua_pop(L, 1);
+				throw std::runtime_error("Can't restore a function of the checkpoint: " + message);
+			}
+			p += len;
+			int function = lua_gettop(L);
+			lua_pushvalue(L, function);
+			lua_rawseti(L, objects, ++next_object);
+
+			uint64_t nups = varint();
+			for (uint64_t i = 1; i <= nups; i++) {
+				if (lua_getupvalue(L, function, (int) i) == NULL) {
+					malformed();
+				}
+				lua_pop(L, 1);
+				if (p < end && *p == (char) TAG_SHARED_UPVALUE) {
+					p++;
+					uint64_t owner = varint();
+					uint64_t n = varint();
+					// The owner's upvalue may not be set yet: joined, the value set later is shared
+					if (owner >= (uint64_t) next_object || lua_rawgeti(L, objects, (lua_Integer) owner + 1) != LUA_TFUNCTION ||
+							lua_iscfunction(L, -1) || n == 0 || n > 255 || lua_getupvalue(L, -1, (int) n) == NULL) {
+						malformed();
+					}
+					lua_pop(L, 1);
+					lua_upvaluejoin(L, function, (int) i, -1, (int) n);
+					lua_pop(L, 1);
+				} else {
+					value(depth + 1);
+					lua_setupvalue(L, function, (int) i);
+				}
+			}
+		}
+	};
+}
+
+void LuaCheckpoint::Save (lua_State *L, int idx, int roots, std::string &out) {
+	idx = lua_absindex(L, idx);
+	roots = lua_absindex(L, roots);
+	if (!lua_istable(L, idx) || !lua_istable(L, roots)) {
+		throw std::runtime_error("Can't save the checkpoint: it needs a table and a table of roots");
+	}
+	int top = lua_gettop(L);
+	Saver saver(L, out);
+	try {
+		std::vector<std::string> path;
+		saver.findNames(roots, path, 0);
+		out.append(MAGIC, sizeof(MAGIC));
+		out += (char) VERSION;
+		size_t checksum_at = out.size();
+		out.append(sizeof(uint64_t), '\0');
+		size_t values_at = out.size();
+		saver.table(idx, 0, false);
+		uint64_t hash = checksum(out.data() + values_at, out.size() - values_at);
+		memcpy(&out[checksum_at], &hash, sizeof(hash));
+	} catch (...) {
+		lua_settop(L, top);
+		throw;
+	}
+}
+
+namespace {
+	struct LoadCall {
+		const std::string *checkpoint;
+		/* Set if the loader threw */
+		std::string error;
+	};
+
+	/**
+	 * @brief Leaves the loaded table on top of the stack, or nothing if the loader threw
+	 *
+	 * Called protected, with a LoadCall and the roots: a Lua error, like running out of memory,
+	 * unwinds to lua_pcall() instead of the panic function. The exceptions of the loader are
+	 * caught here, so they don't cross Lua's frames.
+	 */
+	int protectedLoad (lua_State *L) {
+		LoadCall *call = (LoadCall *) lua_touserdata(L, 1);
+		const std::string &checkpoint = *call->checkpoint;
+		luaL_checkstack(L, 8, "LuaCheckpoint");
+		lua_newtable(L);
+		try {
+			Loader loader(L, checkpoint.data() + HEADER_SIZE, checkpoint.data() + checkpoint.size(), 2, 3);
+			loader.value(0);
+			if (!lua_istable(L, -1) || !loader.finished()) {
+				throw std::runtime_error("The checkpoint is malformed");
+			}
+		} catch (std::exception &e) {
+			call->error = e.what();
+			return 0;
+		}
+		return 1;
+	}
+}
+
+void LuaCheckpoint::Load (lua_State *L, const std::string &checkpoint, int roots) {
+	roots = lua_absindex(L, roots);
+	if (checkpoint.size() < HEADER_SIZE || memcmp(checkpoint.data(), MAGIC, sizeof(MAGIC)) != 0 ||
+			checkpoint[sizeof(MAGIC)] != (char) VERSION) {
+		throw std::runtime_error("The checkpoint is malformed, or was saved by another version");
+	}
+	uint64_t hash = 0;
+	memcpy(&hash, checkpoint.data() + sizeof(MAGIC) + 1, sizeof(hash));
+	if (hash != checksum(checkpoint.data() + HEADER_SIZE, checkpoint.size() - HEADER_SIZE)) {
+		throw std::runtime_error("The checkpoint is truncated or corrupted");
+	}
+
+	luaL_checkstack(L, 4, "LuaCheckpoint");
+	LoadCall call;
+	call.checkpoint = &checkpoint;
+	lua_pushcfunction(L, protectedLoad);
+	lua_pushlightuserdata(L, &call);
+	lua_pushvalue(L, roots);
+	if (lua_pcall(L, 2, 1, 0) != LUA_OK) {
+		std::string message = lua_tostring(L, -1) ? lua_tostring(L, -1) : "error object is not a string";
+		lua_pop(L, 1);
+		throw std::runtime_error("Can't restore the checkpoint: " + message);
+	}
+	if (!call.error.empty()) {
+		lua_pop(L, 1);
+		throw std::runtime_error(call.error);
+	}
+}
+
+} /* namespace LuaCpp */
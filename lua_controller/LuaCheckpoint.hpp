@@ -0,0 +1,70 @@
+/**
+ * @file LuaCheckpoint.hpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Saves a table graph of a Lua state to a binary blob, and rebuilds it in any state
+ * @date 2026-10-18
+ *
+ * @details
+ * Unlike LuaChannel's messages, a checkpoint keeps the identity of the values:
+ * a table or function reached twice is saved once and restored as one object,
+ * cycles included. Lua functions are saved as their bytecode and upvalues, and
+ * upvalues shared by several closures are joined again when they're restored.
+ *
+ * Values that can't be rebuilt from bytes, like C functions, the libraries or the
+ * callables of a controller, are saved by name: before saving, the tables given
+ * as roots are walked, and any table, function or userdata found in them is
+ * saved as its path from a root, like `_G.math.floor`. On restore, the path is
+ * looked up from the roots of the target state, which must hold the same values.
+ * The vmath values are saved by value. Coroutines and any other userdata can't be saved.
+ *
+ * Only restore blobs made by Save(): Lua doesn't verify the bytecode it loads.
+ * A checksum detects the blobs that were truncated or corrupted, not the ones
+ * that were edited on purpose.
+ * This file doesn't depend on Godot.
+ */
+
+#ifndef LUACPP_LUACHECKPOINT_HPP
+#define LUACPP_LUACHECKPOINT_HPP
+
+#include <string>
+#include <LuaCpp.hpp>
+
+namespace LuaCpp {
+
+	class LuaCheckpoint {
+	public:
+		/**
+		 * @brief Tables nested deeper, counting through upvalues, can't be saved
+		 */
+		static const int MAX_NESTING = 200;
+
+		/**
+		 * @brief Depth of the walk of the roots looking for the values saved by name
+		 */
+		static const int ROOTS_DEPTH = 4;
+
+		/**
+		 * @brief Appends the table at idx, and every value reached from it, to out
+		 *
+		 * The metatable of the table at idx isn't saved, the metatables of the tables in it are.
+		 *
+		 * @param roots Index of a table of named roots, see the details of this file
+		 * @throws std::runtime_error if a value can't be saved. out is left partly written
+		 */
+		static void Save (lua_State *L, int idx, int roots, std::string &out);
+
+		/**
+		 * @brief Pushes the table saved in checkpoint
+		 *
+		 * The checksum saved with the values is verified first, which rejects truncated and
+		 * corrupted checkpoints, but not crafted ones. Loading runs in a protected call, so
+		 * the errors raised by Lua, like the `__index` of a root, become exceptions.
+		 *
+		 * @param roots Index of a table with the roots that were given to Save()
+		 * @throws std::runtime_error if the checkpoint is malformed, or a value saved by name isn't found. Nothing is pushed
+		 */
+		static void Load (lua_State *L, const std::string &checkpoint, int roots);
+	};
+}
+
+#endif // LUACPP_LUACHECKPOINT_HPP
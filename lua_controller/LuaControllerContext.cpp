@@ -34,21 +34,392 @@
 
 #include <stdexcept>
 #include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <thread>
 
 #include "LuaControllerContext.hpp"
+#include "LuaTracer.hpp"
+#include "LuaCheckpoint.hpp"
+#include "LuaTablePool.hpp"
 
 namespace LuaCpp {
 
+const char *const PACKAGE_SEARCHERS_KEY = "LuaControllerContext.package_searchers";
+
+namespace {
+	/**
+	 * @brief Registry field, in the run state, with a light userdata to the LuaRunError filled by errorHandler
+	 */
+	const char *const RUN_ERROR_KEY = "LuaControllerContext.run_error";
+
+	const char *const SNIPPET_NOT_FOUND = "Error: The code snipped not found ...";
+
+	/**
+	 * @brief Pushes the roots of the checkpoints: the metatable at idx, with the global variables, and the global table
+	 */
+	void pushCheckpointRoots (lua_State *L, int idx) {
+		lua_createtable(L, 0, 2);
+		lua_pushvalue(L, idx);
+		lua_setfield(L, -2, "env");
+		lua_pushglobaltable(L);
+		lua_setfield(L, -2, "_G");
+	}
+
+	/**
+	 * @brief Message handler of the runs with error details
+	 *
+	 * Runs where the error was raised, before the stack unwinds: records the
+	 * location of the innermost Lua function and returns the message with the traceback.
+	 * It's a light C function, so installing it doesn't allocate.
+	 */
+	int errorHandler (lua_State *L) {
+		const char *message = lua_tostring(L, 1);
+		if (message == NULL) {
+			message = lua_pushfstring(L, "(error object is a %s value)", luaL_typename(L, 1));
+		}
+		lua_getfield(L, LUA_REGISTRYINDEX, RUN_ERROR_KEY);
+		LuaRunError *error = static_cast<LuaRunError *>(lua_touserdata(L, -1));
+		lua_pop(L, 1);
+		if (error != NULL) {
+			lua_Debug ar;
+			// Level 0 is the handler, C functions like error() have no current line
+			for (int level = 1; lua_getstack(L, level, &ar); level++) {
+				lua_getinfo(L, "Sl", &ar);
+				if (ar.currentline >= 0) {
+					memcpy(error->source, ar.short_src, sizeof(error->source));
+					error->line = ar.currentline;
+					break;
+				}
+			}
+		}
+		luaL_traceback(L, L, message, 1);
+		return 1;
+	}
+
+	RunStatus toRunStatus (int lua_status) {
+		switch (lua_status) {
+		case LUA_OK:
+			return RUN_OK;
+		case LUA_ERRMEM:
+			return RUN_ERROR_MEMORY;
+		case LUA_ERRERR:
+			return RUN_ERROR_HANDLER;
+		case LUA_ERRGCMM:
+			return RUN_ERROR_GC;
+		default:
+			return RUN_ERROR_RUNTIME;
+		}
+	}
+
+	/**
+	 * @brief Pending changes smaller than this are not reported to the global statistics at each allocation
+	 */
+	const int64_t STATS_FLUSH_BYTES = 64 * 1024;
+
+	/* Same as the panic function of luaL_newstate, which isn't exposed by lauxlib */
+	int panic (lua_State *L) {
+		fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", lua_tostring(L, -1));
+		return 0;
+	}
+
+	/**
+	 * @brief Resurrects a new sentinel, with the metatable of the one being finalized, for the next cycle
+	 */
+	void renewGCSentinel (lua_State *L) {
+		lua_newtable(L);
+		lua_getmetatable(L, 1);
+		lua_setmetatable(L, -2);
+	}
+
+	/**
+	 * @brief __gc of the sentinel object that counts collection cycles
+	 *
+	 * The sentinel is unreachable from its creation, so it is finalized at the end of
+	 * every cycle. The finalizer resurrects a new sentinel for the next cycle.
+	 */
+	int countGCCycle (lua_State *L) {
+		LuaMemoryStats *stats = static_cast<LuaMemoryStats *>(lua_touserdata(L, lua_upvalueindex(1)));
+		stats->gc_cycles++;
+		stats->pending_gc_cycles++;
+		renewGCSentinel(L);
+		return 0;
+	}
+
+	/**
+	 * @brief Adds bytes to the global current_bytes, and updates the global peak
+	 */
+	void reportBytes (int64_t bytes) {
+		LuaGlobalMemoryStats &global = getGlobalMemoryStats();
+		int64_t current = global.current_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+		int64_t peak = global.peak_bytes.load(std::memory_order_relaxed);
+		while (current > peak && !global.peak_bytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+		}
+	}
+
+	/**
+	 * @brief Inserts the searchers from PACKAGE_SEARCHERS_KEY after the preload searcher of the package table at pkg_idx
+	 */
+	void addPackageSearchers (lua_State *L, int pkg_idx) {
+		pkg_idx = lua_absindex(L, pkg_idx);
+		if (lua_getfield(L, LUA_REGISTRYINDEX, PACKAGE_SEARCHERS_KEY) != LUA_TTABLE) {
+			lua_pop(L, 1);
+			return;
+		}
+		if (lua_getfield(L, pkg_idx, "searchers") != LUA_TTABLE) {
+			lua_pop(L, 2);
+			return;
+		}
+		lua_Integer added = luaL_len(L, -2);
+		lua_Integer stock = luaL_len(L, -1);
+		// Moves the stock searchers, except preload, to make room
+		for (lua_Integer i = stock; i >= 2; i--) {
+			lua_rawgeti(L, -1, i);
+			lua_rawseti(L, -2, i + added);
+		}
+		for (lua_Integer i = 1; i <= added; i++) {
+			lua_rawgeti(L, -2, i);
+			lua_rawseti(L, -2, i + 1);
+		}
+		lua_pop(L, 2);
+	}
+
+	/**
+	 * @brief Opens the package library with the searchers added by the context
+	 */
+	int openPackage (lua_State *L) {
+		luaopen_package(L);
+		addPackageSearchers(L, -1);
+		return 1;
+	}
+
+	struct CoreLibrary {
+		int flag;
+		const char *name;
+		lua_CFunction open;
+	};
+
+	/**
+	 * @brief The core libraries that can be opened lazily. Base and string are always opened eagerly
+	 */
+	const CoreLibrary LAZY_CORE_LIBRARIES[] = {
+		{ LIB_COROUTINE, LUA_COLIBNAME, luaopen_coroutine },
+		{ LIB_TABLE, LUA_TABLIBNAME, luaopen_table },
+		{ LIB_IO, LUA_IOLIBNAME, luaopen_io },
+		{ LIB_OS, LUA_OSLIBNAME, luaopen_os },
+		{ LIB_UTF8, LUA_UTF8LIBNAME, luaopen_utf8 },
+		{ LIB_MATH, LUA_MATHLIBNAME, luaopen_math },
+		{ LIB_DEBUG, LUA_DBLIBNAME, luaopen_debug },
+		{ LIB_PACKAGE, LUA_LOADLIBNAME, openPackage },
+	};
+
+	/**
+	 * @brief `__index` of the global table when the libraries are opened lazily
+	 *
+	 * The upvalue maps global names to the name of the library that defines them.
+	 * Once opened, the library's globals are removed from the map, so a global that
+	 * is later set to nil by the script isn't opened again.
+	 */
+	int openLazyLibrary (lua_State *L) {
+		lua_pushvalue(L, 2);
+		lua_rawget(L, lua_upvalueindex(1));
+		if (lua_type(L, -1) != LUA_TSTRING) {
+			return 0;
+		}
+		const char *library_name = lua_tostring(L, -1);
+		for (const CoreLibrary &library : LAZY_CORE_LIBRARIES) {
+			if (strcmp(library.name, library_name) != 0) {
+				continue;
+			}
+			lua_pushstring(L, library.name);
+			lua_pushnil(L);
+			lua_rawset(L, lua_upvalueindex(1));
+			if (library.flag == LIB_PACKAGE) {
+				lua_pushnil(L);
+				lua_setfield(L, lua_upvalueindex(1), "require");
+			}
+			luaL_requiref(L, library.name, library.open, 1);
+			lua_pop(L, 1);
+			// Returns the global that was asked for, now that its library is open
+			lua_pushvalue(L, 2);
+			lua_rawget(L, 1);
+			return 1;
+		}
+		return 0;
+	}
+
+	/**
+	 * @brief Creates the first sentinel, whose finalizer is counter with stats as its upvalue
+	 */
+	void createGCSentinel (lua_State *L, void *stats, lua_CFunction counter) {
+		lua_newtable(L);
+		lua_newtable(L);
+		lua_pushlightuserdata(L, stats);
+		lua_pushcclosure(L, counter, 1);
+		lua_setfield(L, -2, "__gc");
+		lua_setmetatable(L, -2);
+		lua_pop(L, 1);
+	}
+}
+
+LuaGlobalMemoryStats &getGlobalMemoryStats () {
+	static LuaGlobalMemoryStats global_stats;
+	return global_stats;
+}
+
+LuaControllerContext::~LuaControllerContext() {
+	// Closes the kept state before the last report, so it's memory is discounted
+	run_state.reset();
+	flushStats();
+	getGlobalMemoryStats().contexts--;
+}
+
+void *LuaControllerContext::allocate(void *ud, void *ptr, size_t osize, size_t nsize) {
+	LuaMemoryStats *s = static_cast<LuaMemoryStats *>(ud);
+	// When ptr is NULL, osize encodes the type of the object, not a size
+	const int64_t old_size = ptr ? (int64_t) osize : 0;
+	void *block = NULL;
+
+	if (nsize == 0) {
+		free(ptr);
+	} else {
+		block = realloc(ptr, nsize);
+		if (block == NULL) {
+			return NULL;
+		}
+		if (ptr == NULL) {
+			s->allocations++;
+			s->run_allocations++;
+			s->pending_allocations++;
+		}
+	}
+
+	const int64_t delta = (int64_t) nsize - old_size;
+	s->current_bytes += delta;
+	s->pending_bytes += delta;
+	if (delta > 0) {
+		s->run_bytes_allocated += delta;
+		if (s->current_bytes > s->peak_bytes) {
+			s->peak_bytes = s->current_bytes;
+		}
+	}
+	if (s->pending_bytes >= STATS_FLUSH_BYTES || s->pending_bytes <= -STATS_FLUSH_BYTES) {
+		reportBytes(s->pending_bytes);
+		s->pending_bytes = 0;
+	}
+	return block;
+}
+
+void *LuaControllerContext::allocateDetached(void *ud, void *ptr, size_t osize, size_t nsize) {
+	DetachedStats::Slot &slot = static_cast<DetachedStats *>(ud)->slots[snapshotSlot()];
+	const int64_t old_size = ptr ? (int64_t) osize : 0;
+	void *block = NULL;
+
+	if (nsize == 0) {
+		free(ptr);
+	} else {
+		block = realloc(ptr, nsize);
+		if (block == NULL) {
+			return NULL;
+		}
+		if (ptr == NULL) {
+			slot.allocations.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	const int64_t delta = (int64_t) nsize - old_size;
+	const int64_t current = slot.current_bytes.fetch_add(delta, std::memory_order_relaxed) + delta;
+	int64_t reported = slot.reported_bytes.load(std::memory_order_relaxed);
+	// The slot is shared by the threads that hash to it, so only the one that moves reported_bytes reports
+	if ((current - reported >= STATS_FLUSH_BYTES || current - reported <= -STATS_FLUSH_BYTES)
+			&& slot.reported_bytes.compare_exchange_strong(reported, current, std::memory_order_relaxed)) {
+		reportBytes(current - reported);
+	}
+	return block;
+}
+
+int LuaControllerContext::countDetachedGCCycle(lua_State *L) {
+	DetachedStats *detached = static_cast<DetachedStats *>(lua_touserdata(L, lua_upvalueindex(1)));
+	detached->slots[snapshotSlot()].gc_cycles.fetch_add(1, std::memory_order_relaxed);
+	renewGCSentinel(L);
+	return 0;
+}
+
+void LuaControllerContext::flushStats() {
+	LuaGlobalMemoryStats &global = getGlobalMemoryStats();
+	reportBytes(stats.pending_bytes);
+	global.allocations.fetch_add(stats.pending_allocations, std::memory_order_relaxed);
+	global.gc_cycles.fetch_add(stats.pending_gc_cycles, std::memory_order_relaxed);
+	stats.pending_bytes = 0;
+	stats.pending_allocations = 0;
+	stats.pending_gc_cycles = 0;
+
+	uint64_t allocations = 0;
+	uint64_t gc_cycles = 0;
+	for (DetachedStats::Slot &slot : detached_stats.slots) {
+		int64_t current = slot.current_bytes.load(std::memory_order_relaxed);
+		reportBytes(current - slot.reported_bytes.exchange(current, std::memory_order_relaxed));
+		allocations += slot.allocations.load(std::memory_order_relaxed);
+		gc_cycles += slot.gc_cycles.load(std::memory_order_relaxed);
+	}
+	global.allocations.fetch_add(allocations - detached_stats.reported_allocations, std::memory_order_relaxed);
+	global.gc_cycles.fetch_add(gc_cycles - detached_stats.reported_gc_cycles, std::memory_order_relaxed);
+	detached_stats.reported_allocations = allocations;
+	detached_stats.reported_gc_cycles = gc_cycles;
+}
+
+void LuaControllerContext::publishTemplate() {
+	globals_unpublished = false;
+	StateTemplate state;
+	state.libraries = libraries;
+	state.package_searchers = package_searchers;
+	state.globals = globalEnvironment;
+	state.lua_core_libraries = lua_core_libraries;
+	state.lazy_core_libraries = lazy_core_libraries;
+	state.gc_pause = gc_pause;
+	state.gc_step_multiplier = gc_step_multiplier;
+	state.gc_automatic = gc_automatic;
+	state_template.Publish(std::move(state));
+}
+
 std::unique_ptr<Engine::LuaState> LuaControllerContext::newState() {
-	return newState(globalEnvironment);
+	LuaSnapshot<StateTemplate>::Reader state(state_template);
+	return createState(*state, state->globals, true);
 }
 
 std::unique_ptr<Engine::LuaState> LuaControllerContext::newState(const LuaEnvironment &env) {
-	std::unique_ptr<Engine::LuaState> L = std::make_unique<Engine::LuaState>();
+	LuaSnapshot<StateTemplate>::Reader state(state_template);
+	return createState(*state, env, true);
+}
+
+std::unique_ptr<Engine::LuaState> LuaControllerContext::createState(const StateTemplate &state, const LuaEnvironment &env, bool detached) {
+	LUA_TRACE_SCOPE("newState");
+	lua_State *raw_state = detached
+		? lua_newstate(&LuaControllerContext::allocateDetached, &detached_stats)
+		: lua_newstate(&LuaControllerContext::allocate, &stats);
+	if (raw_state == NULL) {
+		throw std::runtime_error("Error: Not enough memory to create a LuaState");
+	}
+	lua_atpanic(raw_state, &panic);
+	// noclose is false: the wrapper closes the state, running its finalizers and freeing its memory
+	std::unique_ptr<Engine::LuaState> L = std::make_unique<Engine::LuaState>(raw_state, false);
+
+	const std::vector<lua_CFunction> &package_searchers = state.package_searchers;
+	if (!package_searchers.empty()) {
+		lua_createtable(*L, (int) package_searchers.size(), 0);
+		for (size_t i = 0; i < package_searchers.size(); i++) {
+			lua_pushcfunction(*L, package_searchers[i]);
+			lua_rawseti(*L, -2, (lua_Integer) i + 1);
+		}
+		lua_setfield(*L, LUA_REGISTRYINDEX, PACKAGE_SEARCHERS_KEY);
+	}
 	
-	openLibs(*L, getLuaCoreLibraries());
+	openLibs(*L, state.lua_core_libraries, state.lazy_core_libraries);
 	
-	for(const auto &lib : libraries ) {
+	for(const auto &lib : state.libraries ) {
 		((std::shared_ptr<Registry::LuaLibrary>) lib.second)->RegisterFunctions(*L);
 	}
 	for(const auto &var : env) {
@@ -57,93 +428,767 @@ std::unique_ptr<Engine::LuaState> LuaControllerContext::newState(const LuaEnviro
 	lua_pushstring(*L, std::string(Version).c_str());
 	lua_setglobal(*L, "_luacppversion");
 
+	applyGCSettings(*L, state);
+	if (detached) {
+		createGCSentinel(*L, &detached_stats, countDetachedGCCycle);
+	} else {
+		createGCSentinel(*L, &stats, countGCCycle);
+	}
+
 	return L;
 }
 
 std::unique_ptr<Engine::LuaState> LuaControllerContext::newStateFor(const std::string &name) {
-	return newStateFor(name, globalEnvironment);
+	LuaSnapshot<StateTemplate>::Reader state(state_template);
+	return createStateFor(name, *state, state->globals);
 }
 
 std::unique_ptr<Engine::LuaState> LuaControllerContext::newStateFor(const std::string &name, const LuaEnvironment &env) {
-	if (registry.Exists(name)) {
-		std::unique_ptr<Registry::LuaCodeSnippet> cs = registry.getByName(name);
-		std::unique_ptr<Engine::LuaState> L = newState(env);
-		cs->UploadCode(*L);
-		return L;	
-	}	
-	throw std::runtime_error("Error: The code snipped not found ...");
+	LuaSnapshot<StateTemplate>::Reader state(state_template);
+	return createStateFor(name, *state, env);
+}
+
+std::unique_ptr<Engine::LuaState> LuaControllerContext::createStateFor(const std::string &name, const StateTemplate &state, const LuaEnvironment &env) {
+	if (!registry.Exists(name)) {
+		throw std::runtime_error(SNIPPET_NOT_FOUND);
+	}
+	std::unique_ptr<Engine::LuaState> L = createState(state, env, true);
+	// The snippet may have been removed since
+	if (!registry.Upload(name, *L)) {
+		throw std::runtime_error(SNIPPET_NOT_FOUND);
+	}
+	return L;
 }
 
 void LuaControllerContext::CompileString(const std::string &name, const std::string &code) {
-	registry.CompileAndAddString(name, code);
+	CompileString(name, code, false);
 }
 
 void LuaControllerContext::CompileString(const std::string &name, const std::string &code, bool recompile) {
-	registry.CompileAndAddString(name, code, recompile);
+	if (recompile || !registry.Exists(name)) {
+		registry.Add(LuaSnippetRegistry::CompileString(name, code));
+	}
 }
 
 
 void LuaControllerContext::CompileFile(const std::string &name, const std::string &fname) {
-	registry.CompileAndAddFile(name,fname);
+	CompileFile(name, fname, false);
 }
 
 void LuaControllerContext::CompileFile(const std::string &name, const std::string &fname, bool recompile) {
-	registry.CompileAndAddFile(name,fname, recompile);
+	if (recompile || !registry.Exists(name)) {
+		registry.Add(LuaSnippetRegistry::CompileFile(name, fname));
+	}
+}
+
+void LuaControllerContext::CompileReader(const std::string &name, lua_Reader reader, void *data, const std::string &chunkname) {
+	registry.Add(LuaSnippetRegistry::CompileReader(name, reader, data, chunkname));
+}
+
+void LuaControllerContext::AddSnippet(std::shared_ptr<const LuaSnippet> snippet) {
+	registry.Add(std::move(snippet));
+}
+
+std::shared_ptr<const LuaSnippet> LuaControllerContext::getSnippet(const std::string &name) const {
+	return registry.Get(name);
+}
+
+bool LuaControllerContext::RemoveSnippet(const std::string &name) {
+	return registry.Remove(name);
+}
+
+std::vector<std::string> LuaControllerContext::getSnippetNames() const {
+	return registry.Names();
+}
+
+std::map<std::string, std::string> LuaControllerContext::CompileAll(const std::vector<std::pair<std::string, std::string>> &sources, unsigned threads) {
+	LUA_TRACE_SCOPE("compileAll");
+	if (threads == 0) {
+		threads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+	threads = (unsigned) std::min<size_t>(threads, sources.size());
+
+	// Each slot is written by the one thread that took its index
+	std::vector<std::shared_ptr<const LuaSnippet>> snippets(sources.size());
+	std::vector<std::string> errors(sources.size());
+	std::atomic<size_t> next(0);
+	auto work = [&]() {
+		for (size_t i = next++; i < sources.size(); i = next++) {
+			try {
+				snippets[i] = LuaSnippetRegistry::CompileString(sources[i].first, sources[i].second);
+			} catch (const std::exception &e) {
+				errors[i] = e.what();
+			}
+		}
+	};
+	std::vector<std::thread> workers;
+	// The calling thread works too
+	for (unsigned i = 1; i < threads; i++) {
+		workers.emplace_back(work);
+	}
+	work();
+	for (std::thread &worker : workers) {
+		worker.join();
+	}
+
+	std::map<std::string, std::string> failures;
+	for (size_t i = 0; i < sources.size(); i++) {
+		if (snippets[i]) {
+			registry.Add(std::move(snippets[i]));
+		} else {
+			failures[sources[i].first] = errors[i];
+		}
+	}
+	return failures;
 }
 
 
 void LuaControllerContext::CompileStringAndRun(const std::string &code) {
-	registry.CompileAndAddString("default", code, true);
+	CompileString("default", code, true);
 	Run("default");
 }
 
 void LuaControllerContext::CompileFileAndRun(const std::string &code) {
-	registry.CompileAndAddFile("default", code, true);
+	CompileFile("default", code, true);
 	Run("default");
 }
 
-void LuaControllerContext::Run(const std::string &name) {
-	RunWithEnvironment(name, globalEnvironment);
+Engine::LuaState &LuaControllerContext::getRunState() {
+	if (!run_state) {
+		// The global variables go to the script environment, not to the global table
+		LuaSnapshot<StateTemplate>::Reader state(state_template);
+		run_state = createState(*state, LuaEnvironment(), false);
+		lua_pushlightuserdata(*run_state, &last_error);
+		lua_setfield(*run_state, LUA_REGISTRYINDEX, RUN_ERROR_KEY);
+		env_meta_ref = LUA_NOREF;
+		script_env_ref = LUA_NOREF;
+		env_dirty = true;
+		if (profiler_active) {
+			profiler->Attach(*run_state);
+		}
+	}
+	return *run_state;
 }
 
-void LuaControllerContext::RunWithEnvironment(const std::string &name, const LuaEnvironment &env) {
-	std::unique_ptr<Engine::LuaState> L = newStateFor(name);
-	
-	for(const auto &var : env) {
-		((std::shared_ptr<Engine::LuaType>) var.second)->PushGlobal(*L, var.first);
+void LuaControllerContext::resetRunState() {
+	// The references die with the state
+	run_state.reset();
+	env_meta_ref = LUA_NOREF;
+	script_env_ref = LUA_NOREF;
+	env_dirty = true;
+}
+
+void LuaControllerContext::pushEnvironmentMetatable(Engine::LuaState &L) {
+	if (env_dirty || env_meta_ref == LUA_NOREF) {
+		luaL_unref(L, LUA_REGISTRYINDEX, env_meta_ref);
+
+		lua_createtable(L, 0, (int) globalEnvironment.size());
+		for(const auto &var : globalEnvironment) {
+			var.second->PushValue(L);
+			lua_setfield(L, -2, var.first.c_str());
+		}
+		// Anything that isn't a global variable of the context is looked up in the global table
+		lua_createtable(L, 0, 1);
+		lua_pushglobaltable(L);
+		lua_setfield(L, -2, "__index");
+		lua_setmetatable(L, -2);
+
+		lua_createtable(L, 0, 1);
+		lua_insert(L, -2);
+		lua_setfield(L, -2, "__index");
+		env_meta_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+		env_dirty = false;
 	}
+	lua_rawgeti(L, LUA_REGISTRYINDEX, env_meta_ref);
+}
 
-	int res = lua_pcall(*L, 0, LUA_MULTRET, 0);
-	if (res != LUA_OK ) {
-		throw std::runtime_error(lua_tostring(*L,1));
+void LuaControllerContext::pushScriptEnvironment(Engine::LuaState &L) {
+	if (keep_state) {
+		if (script_env_ref == LUA_NOREF) {
+			lua_newtable(L);
+			script_env_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+		}
+		lua_rawgeti(L, LUA_REGISTRYINDEX, script_env_ref);
+	} else {
+		lua_newtable(L);
 	}
+	pushEnvironmentMetatable(L);
+	lua_setmetatable(L, -2);
+}
 
-	for(const auto &var : env) {
-		((std::shared_ptr<Engine::LuaType>) var.second)->PopGlobal(*L);
+RunStatus LuaControllerContext::recordError(lua_State *L, RunStatus status) {
+	last_error.status = status;
+	const char *message = lua_tostring(L, -1);
+	if (message == NULL) {
+		message = "(error object is not a string)";
+	}
+	if (status == RUN_ERROR_RUNTIME && error_details) {
+		// The handler returned the message followed by the traceback
+		last_error.traceback.assign(message);
+		last_error.message.assign(last_error.traceback, 0, last_error.traceback.find("\nstack traceback:"));
+	} else {
+		last_error.message.assign(message);
+		last_error.traceback.clear();
+		last_error.source[0] = '\0';
+		last_error.line = -1;
 	}
+	lua_pop(L, 1);
+	return status;
+}
+
+RunStatus LuaControllerContext::fail(lua_State *L, RunStatus status) {
+	recordError(L, status);
+	lua_settop(L, 0);
+	return status;
+}
 
+RunStatus LuaControllerContext::fail(RunStatus status, const char *message) {
+	last_error.status = status;
+	last_error.message.assign(message);
+	last_error.traceback.clear();
+	last_error.source[0] = '\0';
+	last_error.line = -1;
+	return status;
+}
+
+RunStatus LuaControllerContext::callChunkChecked(Engine::LuaState &L) {
+	LUA_TRACE_SCOPE("run");
+	// The first upvalue of a main chunk is it's _ENV
+	lua_pushvalue(L, -1);
+	if (lua_setupvalue(L, 1, 1) == NULL) {
+		lua_pop(L, 1);
+	}
+
+	int handler = 0;
+	if (error_details) {
+		last_error.source[0] = '\0';
+		last_error.line = -1;
+		lua_pushcfunction(L, errorHandler);
+		handler = lua_gettop(L);
+	}
+	lua_pushvalue(L, 1);
+	int res = lua_pcall(L, 0, LUA_MULTRET, handler);
+	if (handler != 0) {
+		// The results, or the error, are left right above the chunk and its environment
+		lua_remove(L, handler);
+	}
+	if (res != LUA_OK) {
+		return fail(L, toRunStatus(res));
+	}
+	return RUN_OK;
+}
+
+RunStatus LuaControllerContext::loadRun(const std::string &name, Engine::LuaState *&L) {
+	stats.run_allocations = 0;
+	stats.run_bytes_allocated = 0;
+
+	std::shared_ptr<const LuaSnippet> snippet = registry.Get(name);
+	if (!snippet) {
+		return fail(RUN_ERROR_NOT_FOUND, SNIPPET_NOT_FOUND);
+	}
+	try {
+		// Only throws if lua_newstate() fails
+		L = &getRunState();
+	} catch (std::runtime_error &e) {
+		return fail(RUN_ERROR_MEMORY, e.what());
+	}
+	lua_settop(*L, 0);
+	int res = snippet->Load(*L);
+	if (res != LUA_OK) {
+		return fail(*L, res == LUA_ERRMEM ? RUN_ERROR_MEMORY : RUN_ERROR_LOAD);
+	}
+	return RUN_OK;
+}
+
+RunStatus LuaControllerContext::runChecked(const std::string &name, const LuaEnvironment *env) {
+	Engine::LuaState *state = NULL;
+	RunStatus status = loadRun(name, state);
+	if (status != RUN_OK) {
+		return status;
+	}
+	Engine::LuaState &L = *state;
+	pushScriptEnvironment(L);
+	if (env != NULL) {
+		for(const auto &var : *env) {
+			var.second->PushValue(L);
+			lua_setfield(L, 2, var.first.c_str());
+		}
+	}
+
+	status = callChunkChecked(L);
+	if (status != RUN_OK) {
+		return status;
+	}
+
+	// PopValue() throws if the script gave a variable a value of another type
+	try {
+		if (env != NULL) {
+			for(const auto &var : *env) {
+				lua_getfield(L, 2, var.first.c_str());
+				var.second->PopValue(L, -1);
+				lua_pop(L, 1);
+			}
+		}
+		readBackGlobals(L, 2, env);
+	} catch (std::exception &e) {
+		lua_settop(L, 0);
+		publishReadBackGlobals();
+		return fail(RUN_ERROR_RUNTIME, e.what());
+	}
+	lua_settop(L, 0);
+	publishReadBackGlobals();
+	return RUN_OK;
+}
+
+namespace {
+	/**
+	 * @brief Returns a new variable of the same Lua type as var, or null if var is a handle, like a userdata
+	 */
+	std::shared_ptr<Engine::LuaType> newVariableLike(const Engine::LuaType &var) {
+		switch (var.getTypeId()) {
+			case LUA_TNIL:
+				return std::make_shared<Engine::LuaTNil>();
+			case LUA_TBOOLEAN:
+				return std::make_shared<Engine::LuaTBoolean>(false);
+			case LUA_TNUMBER:
+				return std::make_shared<Engine::LuaTNumber>(0);
+			case LUA_TSTRING:
+				return std::make_shared<Engine::LuaTString>("");
+			case LUA_TTABLE:
+				return std::make_shared<Engine::LuaTTable>();
+			default:
+				return nullptr;
+		}
+	}
+}
+
+void LuaControllerContext::readBackGlobals(Engine::LuaState &L, int env_idx, const LuaEnvironment *skip) {
+	if (globalEnvironment.empty()) {
+		return;
+	}
+	// The table of the global variables, the `__index` of the metatable pushed for this run
+	lua_rawgeti(L, LUA_REGISTRYINDEX, env_meta_ref);
+	lua_pushliteral(L, "__index");
+	lua_rawget(L, -2);
+	lua_remove(L, -2);
+	int globals = lua_gettop(L);
+
+	lua_pushnil(L);
+	while (lua_next(L, env_idx)) {
+		if (lua_type(L, -2) == LUA_TSTRING) {
+			std::string name(lua_tostring(L, -2));
+			auto var = globalEnvironment.find(name);
+			std::shared_ptr<Engine::LuaType> value;
+			if (var != globalEnvironment.end() && (skip == NULL || skip->count(name) == 0)) {
+				value = newVariableLike(*var->second);
+			}
+			if (value) {
+				// The published variable may be read by other threads, so it's replaced, not changed
+				value->PopValue(L, -1);
+				var->second = std::move(value);
+				globals_unpublished = true;
+				// The next runs find the value in the table of the global variables
+				lua_pushvalue(L, -2);
+				lua_pushvalue(L, -2);
+				lua_rawset(L, globals);
+				lua_pushvalue(L, -2);
+				lua_pushnil(L);
+				lua_rawset(L, env_idx);
+			}
+		}
+		lua_pop(L, 1);
+	}
+	lua_pop(L, 1);
+}
+
+void LuaControllerContext::publishReadBackGlobals() {
+	if (globals_unpublished) {
+		publishTemplate();
+	}
+}
+
+RunStatus LuaControllerContext::RunBatch(const std::string &name, size_t count, const BatchSetup &setup, const BatchResult &result) {
+	LUA_TRACE_SCOPE("runBatch");
+	Engine::LuaState *state = NULL;
+	RunStatus status = loadRun(name, state);
+	if (status != RUN_OK) {
+		return status;
+	}
+	Engine::LuaState &L = *state;
+
+	int handler = 0;
+	if (error_details) {
+		lua_pushcfunction(L, errorHandler);
+		handler = lua_gettop(L);
+	}
+	pushEnvironmentMetatable(L);
+	int metatable = lua_gettop(L);
+	int env = metatable + 1;
+
+	for (size_t i = 0; i < count; i++) {
+		lua_newtable(L);
+		lua_pushvalue(L, metatable);
+		lua_setmetatable(L, env);
+		setup(L, i);
+		lua_settop(L, env);
+
+		// The first upvalue of a main chunk is it's _ENV
+		lua_pushvalue(L, env);
+		if (lua_setupvalue(L, 1, 1) == NULL) {
+			lua_pop(L, 1);
+		}
+		if (error_details) {
+			last_error.source[0] = '\0';
+			last_error.line = -1;
+		}
+		lua_pushvalue(L, 1);
+		int res = lua_pcall(L, 0, LUA_MULTRET, handler);
+		if (res == LUA_OK) {
+			int nresults = lua_gettop(L) - env;
+			RunStatus status = RUN_OK;
+			// Like in Run(), the next runs see the context's global variables assigned by this one
+			try {
+				readBackGlobals(L, env, NULL);
+			} catch (std::exception &e) {
+				status = fail(RUN_ERROR_RUNTIME, e.what());
+				nresults = 0;
+			}
+			result(L, i, status, env, nresults);
+		} else {
+			result(L, i, recordError(L, toRunStatus(res)), env, 0);
+		}
+		lua_settop(L, metatable);
+	}
+	lua_settop(L, 0);
+	publishReadBackGlobals();
+	return RUN_OK;
+}
+
+std::string LuaControllerContext::Checkpoint() {
+	LUA_TRACE_SCOPE("checkpoint");
+	if (!keep_state) {
+		throw std::runtime_error("Checkpoint() needs keep_state, otherwise the runs don't keep any variable");
+	}
+	Engine::LuaState &L = getRunState();
+	lua_settop(L, 0);
+	pushScriptEnvironment(L);
+	pushEnvironmentMetatable(L);
+	pushCheckpointRoots(L, 2);
+	std::string checkpoint;
+	try {
+		LuaCheckpoint::Save(L, 1, 3, checkpoint);
+	} catch (...) {
+		lua_settop(L, 0);
+		throw;
+	}
+	lua_settop(L, 0);
+	return checkpoint;
+}
+
+void LuaControllerContext::Restore(const std::string &checkpoint) {
+	LUA_TRACE_SCOPE("restore");
+	if (!keep_state) {
+		throw std::runtime_error("Restore() needs keep_state, otherwise the next run discards the restored variables");
+	}
+	Engine::LuaState &L = getRunState();
+	lua_settop(L, 0);
+	pushEnvironmentMetatable(L);
+	pushCheckpointRoots(L, 1);
+	try {
+		LuaCheckpoint::Load(L, checkpoint, 2);
+	} catch (...) {
+		lua_settop(L, 0);
+		throw;
+	}
+	// Replaces the kept environment, pushScriptEnvironment() gives it the metatable
+	luaL_unref(L, LUA_REGISTRYINDEX, script_env_ref);
+	script_env_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+	lua_settop(L, 0);
+}
+
+RunStatus LuaControllerContext::RunChecked(const std::string &name) {
+	return runChecked(name, NULL);
+}
+
+RunStatus LuaControllerContext::RunChecked(const std::string &name, const LuaEnvironment &env) {
+	return runChecked(name, &env);
+}
+
+void LuaControllerContext::Run(const std::string &name) {
+	if (runChecked(name, NULL) != RUN_OK) {
+		throw std::runtime_error(last_error.message);
+	}
+}
+
+void LuaControllerContext::RunWithResults(const std::string &name, const ResultHandler &handler) {
+	if (RunWithResultsChecked(name, handler) != RUN_OK) {
+		throw std::runtime_error(last_error.message);
+	}
+}
+
+RunStatus LuaControllerContext::RunWithResultsChecked(const std::string &name, const ResultHandler &handler) {
+	Engine::LuaState *state = NULL;
+	RunStatus status = loadRun(name, state);
+	if (status != RUN_OK) {
+		return status;
+	}
+	Engine::LuaState &L = *state;
+	pushScriptEnvironment(L);
+	status = callChunkChecked(L);
+	if (status != RUN_OK) {
+		return status;
+	}
+	// Above the chunk and its environment
+	try {
+		handler(L, lua_gettop(L) - 2);
+		readBackGlobals(L, 2, NULL);
+	} catch (std::exception &e) {
+		lua_settop(L, 0);
+		publishReadBackGlobals();
+		return fail(RUN_ERROR_RUNTIME, e.what());
+	}
+	lua_settop(L, 0);
+	publishReadBackGlobals();
+	return RUN_OK;
+}
+
+void LuaControllerContext::RunWithEnvironment(const std::string &name, const LuaEnvironment &env) {
+	if (runChecked(name, &env) != RUN_OK) {
+		throw std::runtime_error(last_error.message);
+	}
 }
 		
+void LuaControllerContext::ReleaseTables(const void *owner) {
+	if (run_state) {
+		LuaTablePool::Forget(*run_state, owner);
+	}
+}
+
 void LuaControllerContext::AddLibrary(std::shared_ptr<Registry::LuaLibrary> &library) {
 	libraries[library->getName()] = std::move(library);
+	publishTemplate();
+	// The run state doesn't have the new library
+	resetRunState();
+}
+
+void LuaControllerContext::AddPackageSearcher(lua_CFunction searcher) {
+	package_searchers.push_back(searcher);
+	publishTemplate();
+	// The run state doesn't have the new searcher
+	resetRunState();
 }
 
 void LuaControllerContext::AddGlobalVariable(const std::string &name, std::shared_ptr<Engine::LuaType> var) {
 	globalEnvironment[name] = std::move(var);
+	publishTemplate();
+	env_dirty = true;
+}
+
+void LuaControllerContext::RemoveGlobalVariable(const std::string &name) {
+	if (globalEnvironment.erase(name) > 0) {
+		publishTemplate();
+		env_dirty = true;
+	}
 }
 
-std::shared_ptr<Engine::LuaType> &LuaControllerContext::getGlobalVariable(const std::string &name) {
-	return globalEnvironment[name];
+void LuaControllerContext::InvalidateGlobalEnvironment() {
+	publishTemplate();
+	env_dirty = true;
+}
+
+std::shared_ptr<Engine::LuaType> LuaControllerContext::getGlobalVariable(const std::string &name) const {
+	auto var = globalEnvironment.find(name);
+	if (var == globalEnvironment.end()) {
+		return nullptr;
+	}
+	return var->second;
 }
 
 void LuaControllerContext::setLuaCoreLibraries (int flags) {
+	if (lua_core_libraries != flags) {
+		// The run state was opened with the old flags
+		resetRunState();
+	}
 	lua_core_libraries = flags;
+	publishTemplate();
 }
 
 int LuaControllerContext::getLuaCoreLibraries () const {
 	return lua_core_libraries;
 }
 
+void LuaControllerContext::setLazyCoreLibraries (bool lazy) {
+	if (lazy_core_libraries != lazy) {
+		// The run state was opened the other way
+		resetRunState();
+	}
+	lazy_core_libraries = lazy;
+	publishTemplate();
+}
+
+bool LuaControllerContext::getLazyCoreLibraries () const {
+	return lazy_core_libraries;
+}
+
+void LuaControllerContext::setKeepState (bool keep) {
+	keep_state = keep;
+	if (!keep_state && run_state) {
+		luaL_unref(*run_state, LUA_REGISTRYINDEX, script_env_ref);
+		script_env_ref = LUA_NOREF;
+	}
+}
+
+bool LuaControllerContext::getKeepState () const {
+	return keep_state;
+}
+
+void LuaControllerContext::setGCPause (int pause) {
+	gc_pause = pause;
+	publishTemplate();
+	if (run_state) {
+		lua_gc(*run_state, LUA_GCSETPAUSE, gc_pause);
+	}
+}
+
+int LuaControllerContext::getGCPause () const {
+	return gc_pause;
+}
+
+void LuaControllerContext::setGCStepMultiplier (int multiplier) {
+	gc_step_multiplier = multiplier;
+	publishTemplate();
+	if (run_state) {
+		lua_gc(*run_state, LUA_GCSETSTEPMUL, gc_step_multiplier);
+	}
+}
+
+int LuaControllerContext::getGCStepMultiplier () const {
+	return gc_step_multiplier;
+}
+
+void LuaControllerContext::setGCAutomatic (bool automatic) {
+	gc_automatic = automatic;
+	publishTemplate();
+	if (run_state) {
+		lua_gc(*run_state, gc_automatic ? LUA_GCRESTART : LUA_GCSTOP, 0);
+	}
+}
+
+bool LuaControllerContext::isGCAutomatic () const {
+	return gc_automatic;
+}
+
+void LuaControllerContext::applyGCSettings(Engine::LuaState &L, const StateTemplate &state) {
+	lua_gc(L, LUA_GCSETPAUSE, state.gc_pause);
+	lua_gc(L, LUA_GCSETSTEPMUL, state.gc_step_multiplier);
+	if (!state.gc_automatic) {
+		lua_gc(L, LUA_GCSTOP, 0);
+	}
+}
+
+bool LuaControllerContext::StepGC (int budget_usec) {
+	if (!run_state) {
+		return false;
+	}
+	LUA_TRACE_SCOPE("gcStep");
+	const auto start = std::chrono::steady_clock::now();
+	const auto deadline = start + std::chrono::microseconds(budget_usec);
+	bool finished_cycle = false;
+	auto now = start;
+	do {
+		// With data 0, LUA_GCSTEP does a single basic step, and returns 1 at the end of a cycle
+		finished_cycle = lua_gc(*run_state, LUA_GCSTEP, 0);
+		now = std::chrono::steady_clock::now();
+	} while (!finished_cycle && now < deadline);
+
+	uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
+	stats.gc_time_usec += elapsed;
+	getGlobalMemoryStats().gc_time_usec.fetch_add(elapsed, std::memory_order_relaxed);
+	return finished_cycle;
+}
+
+const LuaMemoryStats &LuaControllerContext::getMemoryStats () {
+	flushStats();
+	int64_t detached_bytes = 0;
+	for (const DetachedStats::Slot &slot : detached_stats.slots) {
+		detached_bytes += slot.current_bytes.load(std::memory_order_relaxed);
+	}
+	int64_t peak = std::max(reported_stats.peak_bytes, stats.peak_bytes);
+	reported_stats = stats;
+	reported_stats.current_bytes += detached_bytes;
+	reported_stats.peak_bytes = std::max(peak, reported_stats.current_bytes);
+	reported_stats.allocations += detached_stats.reported_allocations;
+	reported_stats.gc_cycles += detached_stats.reported_gc_cycles;
+	return reported_stats;
+}
+
+int64_t LuaControllerContext::getRunStateBytes () {
+	if (!run_state) {
+		return 0;
+	}
+	return ((int64_t) lua_gc(*run_state, LUA_GCCOUNT, 0)) * 1024 + lua_gc(*run_state, LUA_GCCOUNTB, 0);
+}
+
+void LuaControllerContext::StartProfiler (int sample_period_usec, int hook_instruction_count) {
+	StopProfiler();
+	profiler = std::make_unique<LuaSamplingProfiler>(sample_period_usec, hook_instruction_count);
+	profiler_active = true;
+	if (run_state) {
+		profiler->Attach(*run_state);
+	}
+}
+
+void LuaControllerContext::StopProfiler () {
+	if (profiler_active && run_state) {
+		profiler->Detach(*run_state);
+	}
+	profiler_active = false;
+}
+
+bool LuaControllerContext::isProfiling () const {
+	return profiler_active;
+}
+
+const LuaSamplingProfiler *LuaControllerContext::getProfiler () const {
+	return profiler.get();
+}
+
+void openLibs (Engine::LuaState &L, int lib_flags, bool lazy) {
+	if (!lazy) {
+		openLibs(L, lib_flags);
+		return;
+	}
+
+	openLibs(L, lib_flags & (LIB_BASE | LIB_STRING));
+
+	// Maps each global name to the library that defines it
+	lua_newtable(L);
+	bool any_lazy = false;
+	for (const CoreLibrary &library : LAZY_CORE_LIBRARIES) {
+		if (lib_flags & library.flag) {
+			lua_pushstring(L, library.name);
+			lua_setfield(L, -2, library.name);
+			any_lazy = true;
+		}
+	}
+	if (!any_lazy) {
+		lua_pop(L, 1);
+		return;
+	}
+	if (lib_flags & LIB_PACKAGE) {
+		lua_pushstring(L, LUA_LOADLIBNAME);
+		lua_setfield(L, -2, "require");
+	}
+
+	lua_pushglobaltable(L);
+	lua_createtable(L, 0, 1);
+	lua_pushvalue(L, -3);
+	lua_pushcclosure(L, openLazyLibrary, 1);
+	lua_setfield(L, -2, "__index");
+	lua_setmetatable(L, -2);
+	lua_pop(L, 2);
+}
+
 /* Serviu de referência luaL_openlibs em linit.c, mas este código é só muito mais feio e hard-coded */
 void openLibs (Engine::LuaState &L, int lib_flags) {
 	if (lib_flags == LIB_NONE)
@@ -151,6 +1196,10 @@ void openLibs (Engine::LuaState &L, int lib_flags) {
 	
 	if (lib_flags == LIB_ALL) {
 		luaL_openlibs(L);
+		if (lua_getglobal(L, LUA_LOADLIBNAME) == LUA_TTABLE) {
+			addPackageSearchers(L, -1);
+		}
+		lua_pop(L, 1);
 		return;
 	}
 	if ( lib_flags & LIB_BASE) {
@@ -190,7 +1239,7 @@ void openLibs (Engine::LuaState &L, int lib_flags) {
 		lua_pop(L, 1);
 	}
 	if ( lib_flags & LIB_PACKAGE) {
-		luaL_requiref(L, "package", luaopen_package, 1);
+		luaL_requiref(L, "package", openPackage, 1);
 		lua_pop(L, 1);
 	}
 }
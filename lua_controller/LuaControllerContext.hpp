@@ -36,14 +36,26 @@
 #ifndef LUACPP_LUACONTROLLERCONTEXT_HPP
 #define LUACPP_LUACONTROLLERCONTEXT_HPP
 
+#include <functional>
 #include <memory>
+#include <vector>
+#include <atomic>
+#include <cstdint>
 #include <LuaCpp.hpp>
+#include "LuaSamplingProfiler.hpp"
+#include "LuaSnapshot.hpp"
+#include "LuaSnippetRegistry.hpp"
 
 // Forward declaration necessary for friend declaration
 class LuaControllerUnitTester;
 
 namespace LuaCpp {
 
+	/**
+	 * @brief Registry field with the searchers added to package.searchers by openLibs()
+	 */
+	extern const char *const PACKAGE_SEARCHERS_KEY;
+
 
     enum CORE_LIBS_FLAGS {
 		LIB_NONE = 0,
@@ -60,6 +72,90 @@ namespace LuaCpp {
 		LIB_ALL = 1023, //< the combination of all libraries
     };
 
+	/**
+	 * @brief Lua 5.3's default values for the garbage collector's tuning parameters
+	 */
+	enum GC_DEFAULTS {
+		GC_DEFAULT_PAUSE = 200,
+		GC_DEFAULT_STEP_MULTIPLIER = 200,
+	};
+
+	/**
+	 * @brief Memory and garbage collector statistics of the states created by one LuaControllerContext
+	 *
+	 * @details
+	 * Collected by the allocator of the states. The run state's allocations are
+	 * counted without synchronization, so the runs of one context must happen on
+	 * one thread at a time. The states returned by newState() and newStateFor()
+	 * may be used on any thread: they count in per thread slots, summed by
+	 * LuaControllerContext::getMemoryStats().
+	 */
+	struct LuaMemoryStats {
+		int64_t current_bytes = 0;         //< Bytes currently allocated
+		int64_t peak_bytes = 0;            //< Highest value reached by current_bytes
+		uint64_t allocations = 0;          //< Blocks allocated since the context was created
+		uint64_t run_allocations = 0;      //< Blocks allocated during the last run
+		uint64_t run_bytes_allocated = 0;  //< Bytes requested during the last run
+		uint64_t gc_cycles = 0;            //< Finished collection cycles, including the final one of a closed state
+		uint64_t gc_time_usec = 0;         //< Time spent inside StepGC()
+
+		// Changes not yet added to the global statistics
+		int64_t pending_bytes = 0;
+		uint64_t pending_allocations = 0;
+		uint64_t pending_gc_cycles = 0;
+	};
+
+	/**
+	 * @brief Sum of the LuaMemoryStats of every LuaControllerContext
+	 *
+	 * @details
+	 * Contexts report to it in batches, so it may lag behind the
+	 * per context statistics by a few dozens of kilobytes.
+	 */
+	struct LuaGlobalMemoryStats {
+		std::atomic<int64_t> current_bytes{0};
+		std::atomic<int64_t> peak_bytes{0};
+		std::atomic<uint64_t> allocations{0};
+		std::atomic<uint64_t> gc_cycles{0};
+		std::atomic<uint64_t> gc_time_usec{0};
+		std::atomic<int64_t> contexts{0};   //< Amount of LuaControllerContext alive
+	};
+
+	/**
+	 * @brief Outcome of LuaControllerContext::RunChecked()
+	 */
+	enum RunStatus {
+		RUN_OK = 0,
+		RUN_ERROR_NOT_FOUND,  //< No snippet is registered with the name
+		RUN_ERROR_LOAD,       //< The bytecode of the snippet couldn't be loaded
+		RUN_ERROR_RUNTIME,    //< The script raised an error
+		RUN_ERROR_MEMORY,     //< Lua ran out of memory, or the state couldn't be created
+		RUN_ERROR_HANDLER,    //< The message handler failed while building the traceback
+		RUN_ERROR_GC,         //< A __gc metamethod raised an error
+	};
+
+	/**
+	 * @brief Description of the last run that failed
+	 *
+	 * @details
+	 * The message is always set. The source, line and traceback are only set when
+	 * the context's error details are enabled, since they need a message handler
+	 * that walks the stack before it unwinds. Otherwise line is -1, and source and
+	 * traceback are empty.
+	 */
+	struct LuaRunError {
+		RunStatus status = RUN_OK;
+		std::string message;
+		char source[LUA_IDSIZE] = "";   //< Chunk of the innermost Lua function, as in `lua_Debug::short_src`
+		int line = -1;                  //< Line of source where the error was raised
+		std::string traceback;          //< The message followed by the stack traceback, like `luaL_traceback`
+	};
+
+	/**
+	 * @brief Returns the process-wide statistics
+	 */
+	LuaGlobalMemoryStats &getGlobalMemoryStats ();
+
 	class LuaControllerContext {
 	private:
     	friend class ::LuaControllerUnitTester;
@@ -71,25 +167,291 @@ namespace LuaCpp {
 		/**
 		 * @brief Repository that will keep the code snippets
 		 * 
-		 * @see LuaControllerContext::Registry::LuaRegistry
+		 * @see LuaSnippetRegistry
 		 */
-		Registry::LuaRegistry registry;
+		LuaSnippetRegistry registry;
 
 		/**
 		 * Custom `C` libraries for the session
 		 */
 		std::map<std::string, std::shared_ptr<Registry::LuaLibrary>> libraries;
 
+		/**
+		 * The searchers added to package.searchers, after the preload searcher, in every new state
+		 */
+		std::vector<lua_CFunction> package_searchers;
+
 		/**
 		 * Each bit is a flag that indicates if a specific core Lua library should be opened in LuaState
 		 */
 		int lua_core_libraries;
 
+		/**
+		 * If true, the core libraries selected by lua_core_libraries are only opened when first accessed
+		 */
+		bool lazy_core_libraries;
+
 		/**
 		 *	The values to load onto the context as global
 		 */
 		LuaEnvironment globalEnvironment;
 
+		/**
+		 * @brief What the creation of a state reads from the context
+		 *
+		 * A copy of libraries, package_searchers, globalEnvironment, the core
+		 * libraries flags and the garbage collector's settings, published again by
+		 * every method that changes them, so newState() can read it from any thread.
+		 * The copy is shallow: the published libraries and variables are shared, and
+		 * never changed in place, only replaced.
+		 */
+		struct StateTemplate {
+			std::map<std::string, std::shared_ptr<Registry::LuaLibrary>> libraries;
+			std::vector<lua_CFunction> package_searchers;
+			LuaEnvironment globals;
+			int lua_core_libraries = LIB_ALL;
+			bool lazy_core_libraries = false;
+			int gc_pause = GC_DEFAULT_PAUSE;
+			int gc_step_multiplier = GC_DEFAULT_STEP_MULTIPLIER;
+			bool gc_automatic = true;
+		};
+
+		LuaSnapshot<StateTemplate> state_template;
+
+		/**
+		 * @brief Memory statistics of the states created by newState() and newStateFor()
+		 *
+		 * Each thread counts in its own slot, padded to a cache line, with relaxed atomics.
+		 * A state created on one thread and closed on another leaves its bytes spread over
+		 * two slots, which only matters to their sum.
+		 */
+		struct DetachedStats {
+			struct Slot {
+				std::atomic<int64_t> current_bytes{0};
+				std::atomic<int64_t> reported_bytes{0};  //< Part of current_bytes already added to the global statistics
+				std::atomic<uint64_t> allocations{0};
+				std::atomic<uint64_t> gc_cycles{0};
+				char padding[64 - 4 * sizeof(std::atomic<uint64_t>)];
+			};
+			Slot slots[SNAPSHOT_SLOTS];
+
+			// Only touched by the context's thread, when the slots are summed
+			uint64_t reported_allocations = 0;
+			uint64_t reported_gc_cycles = 0;
+		};
+
+		/**
+		 * @brief Statistics of the run state
+		 *
+		 * Declared before run_state, so it outlives the run state
+		 */
+		LuaMemoryStats stats;
+
+		/**
+		 * @brief Statistics of the other states. They must not outlive the context
+		 */
+		DetachedStats detached_stats;
+
+		/**
+		 * @brief Sum of stats and detached_stats, returned by getMemoryStats()
+		 */
+		LuaMemoryStats reported_stats;
+
+		/**
+		 * @brief Filled by the failed runs, reusing the capacity of its strings
+		 *
+		 * Declared before run_state, since the message handler of run_state writes to it
+		 */
+		LuaRunError last_error;
+
+		/**
+		 * @brief If true, runs capture the location and the traceback of their errors
+		 */
+		bool error_details;
+
+		/**
+		 * @brief Profiler attached to run_state while profiler_active is true
+		 *
+		 * Declared before run_state, so the state and its hook die first.
+		 * Kept after StopProfiler(), so its samples can still be read.
+		 */
+		std::unique_ptr<LuaSamplingProfiler> profiler;
+
+		bool profiler_active;
+
+		/**
+		 * @brief State where Run() executes the snippets
+		 *
+		 * Created on the first run and kept alive until the libraries or the
+		 * lua_core_libraries flags change. Keeping the state alive between runs
+		 * lets the garbage collector be stepped by StepGC() outside of the
+		 * script's execution.
+		 */
+		std::unique_ptr<Engine::LuaState> run_state;
+
+		/**
+		 * @brief Registry reference, in run_state, to the metatable given to each script environment
+		 *
+		 * The metatable's `__index` is a table with the values of globalEnvironment,
+		 * whose own `__index` is the global table of run_state. It is built once and
+		 * rebuilt only when globalEnvironment changes.
+		 */
+		int env_meta_ref;
+
+		/**
+		 * @brief If true, globalEnvironment changed since env_meta_ref was built
+		 */
+		bool env_dirty;
+
+		/**
+		 * @brief If true, readBackGlobals() replaced variables that aren't published yet
+		 */
+		bool globals_unpublished;
+
+		/**
+		 * @brief Registry reference, in run_state, to the script environment kept between runs
+		 */
+		int script_env_ref;
+
+		/**
+		 * @brief If true, variables written by a run are still visible on the next one
+		 */
+		bool keep_state;
+
+		/**
+		 * @brief Value passed to `lua_gc(LUA_GCSETPAUSE)` on every new state
+		 */
+		int gc_pause;
+
+		/**
+		 * @brief Value passed to `lua_gc(LUA_GCSETSTEPMUL)` on every new state
+		 */
+		int gc_step_multiplier;
+
+		/**
+		 * @brief If false, the collector of every new state is stopped with `lua_gc(LUA_GCSTOP)`
+		 * and only does work when StepGC() is called
+		 */
+		bool gc_automatic;
+
+		/**
+		 * @brief Applies the garbage collector's settings of state on L
+		 */
+		static void applyGCSettings(Engine::LuaState &L, const StateTemplate &state);
+
+		/**
+		 * @brief Publishes the current libraries, globals and settings to state_template
+		 */
+		void publishTemplate();
+
+		/**
+		 * @brief Creates a state with the libraries of state, and the variables of env as globals
+		 *
+		 * @param detached If true, the state counts its memory in detached_stats and may be used
+		 * on any thread, otherwise in stats
+		 */
+		std::unique_ptr<Engine::LuaState> createState(const StateTemplate &state, const LuaEnvironment &env, bool detached);
+
+		/**
+		 * @brief Body of newStateFor()
+		 */
+		std::unique_ptr<Engine::LuaState> createStateFor(const std::string &name, const StateTemplate &state, const LuaEnvironment &env);
+
+		/**
+		 * @brief Returns run_state, creating it if needed
+		 */
+		Engine::LuaState &getRunState();
+
+		/**
+		 * @brief Discards run_state and every reference into it
+		 */
+		void resetRunState();
+
+		/**
+		 * @brief Pushes on run_state the table to be used as `_ENV` by a run
+		 *
+		 * @details
+		 * The table is new for each run, unless keep_state is true. Either way
+		 * it is empty of globalEnvironment's values, which are found through
+		 * the metatable referenced by env_meta_ref, rebuilt here if dirty.
+		 */
+		void pushScriptEnvironment(Engine::LuaState &L);
+
+		/**
+		 * @brief Pushes the metatable given to each script environment, rebuilding it if dirty
+		 */
+		void pushEnvironmentMetatable(Engine::LuaState &L);
+
+		/**
+		 * @brief Calls the chunk at index 1 of the stack with the table on top of the stack as it's `_ENV`
+		 *
+		 * If the execution fails, fills last_error, clears the stack and returns the failure.
+		 * The traceback is only built if error_details is true.
+		 */
+		RunStatus callChunkChecked(Engine::LuaState &L);
+
+		/**
+		 * @brief Fills last_error with status and the error message on top of L, and pops the message
+		 */
+		RunStatus recordError(lua_State *L, RunStatus status);
+
+		/**
+		 * @brief Same as recordError(), but clears the stack
+		 */
+		RunStatus fail(lua_State *L, RunStatus status);
+
+		/**
+		 * @brief Fills last_error with a failure that happened outside of Lua
+		 */
+		RunStatus fail(RunStatus status, const char *message);
+
+		/**
+		 * @brief Leaves the chunk of the snippet alone on the stack of run_state, returned in L
+		 */
+		RunStatus loadRun(const std::string &name, Engine::LuaState *&L);
+
+		/**
+		 * @brief Reads the context's global variables assigned by a run back from its `_ENV`, at env_idx
+		 *
+		 * The value is popped into a new LuaType that replaces the variable, since the old one
+		 * may be read by threads creating states. publishReadBackGlobals() publishes it. It's also set in the table
+		 * of the global variables, and removed from `_ENV`, so the next runs find it without
+		 * rebuilding the metatable. The variables of skip, which may be null, and the handles,
+		 * like the registered methods, are left alone: an assignment to a handle stays in `_ENV`.
+		 * Throws like `LuaType::PopValue` if a value has the wrong type.
+		 */
+		void readBackGlobals(Engine::LuaState &L, int env_idx, const LuaEnvironment *skip);
+
+		/**
+		 * @brief Publishes the variables replaced by readBackGlobals(), once per run or batch
+		 */
+		void publishReadBackGlobals();
+
+		/**
+		 * @brief Body of RunChecked(). env may be null
+		 */
+		RunStatus runChecked(const std::string &name, const LuaEnvironment *env);
+
+		/**
+		 * @brief Adds the pending changes of stats and detached_stats to the global statistics
+		 */
+		void flushStats();
+
+		/**
+		 * @brief `lua_Alloc` of the run state. `ud` is a pointer to a LuaMemoryStats
+		 */
+		static void *allocate(void *ud, void *ptr, size_t osize, size_t nsize);
+
+		/**
+		 * @brief `lua_Alloc` of the states that may be used on any thread. `ud` is a pointer to a DetachedStats
+		 */
+		static void *allocateDetached(void *ud, void *ptr, size_t osize, size_t nsize);
+
+		/**
+		 * @brief __gc of the sentinel that counts the collection cycles of the states of allocateDetached()
+		 */
+		static int countDetachedGCCycle(lua_State *L);
+
 	public:
 
 		/**
@@ -99,9 +461,17 @@ namespace LuaCpp {
 		 * Creates empty Lua cotext. This is the main entry point
 		 * for the communication with the Lua virtual machine
 		 * from the high level APIs.
+		 *
+		 * The methods that change the context, and the runs, must be called from
+		 * one thread at a time, usually the one that owns the context. newState(),
+		 * newStateFor(), getSnippet() and the snippet compilation and registration
+		 * methods may be called from any thread, concurrently with them: they read a
+		 * snapshot of the context without locking, see LuaSnapshot.
 		 */
-		LuaControllerContext() : registry(), libraries(), lua_core_libraries(LIB_ALL), globalEnvironment() {};
-		~LuaControllerContext() {};
+		LuaControllerContext() : registry(), libraries(), package_searchers(), lua_core_libraries(LIB_ALL), lazy_core_libraries(false), globalEnvironment(),
+			state_template(), stats(), detached_stats(), reported_stats(), last_error(), error_details(false), profiler(), profiler_active(false), run_state(), env_meta_ref(LUA_NOREF), env_dirty(true), globals_unpublished(false), script_env_ref(LUA_NOREF), keep_state(false), gc_pause(GC_DEFAULT_PAUSE), gc_step_multiplier(GC_DEFAULT_STEP_MULTIPLIER),
+			gc_automatic(true) { getGlobalMemoryStats().contexts++; };
+		~LuaControllerContext();
 
 		/**
 		 * @brief Creates new Lua execution state from the context
@@ -113,6 +483,9 @@ namespace LuaCpp {
 		 *
 		 * The globalEnvironment variables will also be loaded to the context.
 		 *
+		 * Safe to call from any thread. The state may be used on another thread
+		 * than the context's, but must be closed before the context is destroyed.
+		 *
 		 * @return Pointer to the LuaState object holding the pointer of the lua_State
 		 */
 		std::unique_ptr<Engine::LuaState> newState();
@@ -151,6 +524,10 @@ namespace LuaCpp {
 		 *
 		 * If the name is not found, the method will throw exception
 		 *
+		 * Safe to call from any thread, like newState(). Neither the snippet
+		 * lookup nor the creation of the state take a lock, so threads creating
+		 * states don't wait for each other, nor for a snippet being recompiled.
+		 *
 		 * @param name Name of the snippet to be loaded
 		 *
 		 * @return Pointer to the LuaState object holding the pointer of the lua_State
@@ -186,7 +563,7 @@ namespace LuaCpp {
 		 *
 		 * @details
 		 * Compiles a string containing Lua code and adds the compiled binary to the
-		 * repository as a LuaCodeSnippet. The code is registered in Lua engine and in 
+		 * repository as a LuaSnippet. The code is registered in Lua engine and in 
 		 * the repository under the same name. If the compilation fails, the function
 		 * will throw an `std::logic_error` with the error code received from Lua engin
 		 *
@@ -200,7 +577,7 @@ namespace LuaCpp {
 		 *
 		 * @details
 		 * Compiles a string containing Lua code and adds the compiled binary to the
-		 * repository as a LuaCodeSnippet. The code is registered in Lua engine and in 
+		 * repository as a LuaSnippet. The code is registered in Lua engine and in 
 		 * the repository under the same name. If the compilation fails, the function
 		 * will throw an `std::logic_error` with the error code received from Lua engin
 		 *
@@ -215,7 +592,7 @@ namespace LuaCpp {
 		 *
 		 * @details
 		 * Compiles a file containing Lua code and adds the compiled binary to the
-		 * repository as a LuaCodeSnippet. The code is registered in Lua engine and in 
+		 * repository as a LuaSnippet. The code is registered in Lua engine and in 
 		 * the repository under the same name. If the compilation fails, the function
 		 * will throw an `std::logic_error` with the error code received from Lua engin
 		 *
@@ -229,7 +606,7 @@ namespace LuaCpp {
 		 *
 		 * @details
 		 * Compiles a file containing Lua code and adds the compiled binary to the
-		 * repository as a LuaCodeSnippet. The code is registered in Lua engine and in 
+		 * repository as a LuaSnippet. The code is registered in Lua engine and in 
 		 * the repository under the same name. If the compilation fails, the function
 		 * will throw an `std::logic_error` with the error code received from Lua engin
 		 *
@@ -239,6 +616,63 @@ namespace LuaCpp {
 		 */
 		void CompileFile(const std::string &name, const std::string &fname, bool recompile);
 
+		/**
+		 * @brief Compiles the chunk read by a `lua_Reader` and adds it to the registry, replacing the previous one
+		 *
+		 * @details
+		 * The reader streams the source into the parser, so only the block it returns
+		 * is in memory at a time. If the compilation fails, the function will throw
+		 * an `std::logic_error` with the error message from Lua
+		 *
+		 * @param name Name under which the snippet is registered in the registry
+		 * @param reader Gives the source a block at a time, see `lua_load`
+		 * @param data Passed to reader
+		 * @param chunkname Name of the chunk in error messages, like "@path" for files
+		 */
+		void CompileReader(const std::string &name, lua_Reader reader, void *data, const std::string &chunkname);
+
+		/**
+		 * @brief Adds a snippet compiled by LuaSnippetRegistry::CompileString() or CompileFile(), replacing
+		 * the one with the same name
+		 *
+		 * @details
+		 * The snippet can be compiled on another thread, and added from any thread. A run
+		 * that already started, or a state being created by newStateFor(), keeps the old snippet.
+		 */
+		void AddSnippet(std::shared_ptr<const LuaSnippet> snippet);
+
+		/**
+		 * @brief Returns the snippet registered under name, or nullptr
+		 */
+		std::shared_ptr<const LuaSnippet> getSnippet(const std::string &name) const;
+
+		/**
+		 * @brief Removes the snippet registered under name
+		 *
+		 * @return true if the name was found
+		 */
+		bool RemoveSnippet(const std::string &name);
+
+		/**
+		 * @brief Returns the names of the registered snippets, in alphabetical order
+		 */
+		std::vector<std::string> getSnippetNames() const;
+
+		/**
+		 * @brief Compiles many snippets in parallel, and adds the ones that compiled
+		 *
+		 * @details
+		 * The sources are split among up to `threads` worker threads, each
+		 * compiling in states of its own, and the snippets are added to the
+		 * registry once all of them finish. A failure doesn't stop the others.
+		 *
+		 * @param sources Pairs of {name, code}
+		 * @param threads Maximum amount of threads. If 0, one per hardware thread
+		 *
+		 * @return The error message of each snippet that failed, by name
+		 */
+		std::map<std::string, std::string> CompileAll(const std::vector<std::pair<std::string, std::string>> &sources, unsigned threads = 0);
+
 		/**
 		 * @brief Compiles a code snippet and runs
 		 *
@@ -277,18 +711,65 @@ namespace LuaCpp {
 		 * @brief Run a code snippet
 		 *
 		 * @details
-		 * Run a snippet that was previously compiled and stored in the registry
+		 * Run a snippet that was previously compiled and stored in the registry.
+		 *
+		 * All runs share one state. The snippet's `_ENV` is a table whose
+		 * metatable gives access to the global variables and to the
+		 * libraries, so the cost of a run doesn't depend on how many global
+		 * variables are registered. Variables written by the snippet stay in
+		 * that table, which is new for each run unless keep_state is true.
+		 * After the run, the values it assigned to the context's global
+		 * variables are read back into them, except for the registered methods
+		 * and other userdata. A value of the wrong type fails the run.
+		 *
+		 * The `_ENV` only isolates the plain assignments. Since the state is
+		 * shared, changes made through the global table (`_G.x = 1`,
+		 * `rawset(_G, ...)`), to the libraries (`string.f = ...`), to
+		 * `package.loaded`, and to tables held by global variables of the
+		 * context, are seen by the later runs of every snippet, until the
+		 * state is recreated by a change of the libraries or of the core
+		 * libraries flags.
 		 *
 		 * @param name Name under which the snippet is registered
 		 */
 		void Run(const std::string &name);
 
+		/**
+		 * @brief Receives the values returned by a chunk: they are the top `nresults` values of the stack of L
+		 *
+		 * The values are only valid during the call, and must not be popped.
+		 */
+		using ResultHandler = std::function<void(lua_State *L, int nresults)>;
+
+		/**
+		 * @brief Run a code snippet, and pass the values it returns to handler
+		 *
+		 * @details
+		 * Same as Run(), but the values returned by the chunk are read directly
+		 * off the stack, before it's cleared.
+		 *
+		 * @param name Name under which the snippet is registered
+		 * @param handler Called once, if the run succeeds
+		 */
+		void RunWithResults(const std::string &name, const ResultHandler &handler);
+
+		/**
+		 * @brief Same as RunWithResults(), but returns the outcome like RunChecked() instead of throwing
+		 *
+		 * An exception thrown by handler is returned as RUN_ERROR_RUNTIME, with its message.
+		 */
+		RunStatus RunWithResultsChecked(const std::string &name, const ResultHandler &handler);
+
 		/**
 		 * @brief Run a code snippet with a given `lua` global table
 		 *
 		 * @details
 		 * Run a snippet that was previously compiled and stored in the registry
-		 * with a given environment (lua global variables)
+		 * with a given environment (lua global variables), in addition to the
+		 * global variables of the context.
+		 *
+		 * The variables from env are set in the snippet's `_ENV` for this run
+		 * only, and read back from it after the execution.
 		 *
 		 * @param name Name under which the snippet is registered
 		 * @param env Variables from this environment will be loaded as global 
@@ -296,6 +777,112 @@ namespace LuaCpp {
 		 */
 		void RunWithEnvironment(const std::string &name, const LuaEnvironment &env);
 
+		/**
+		 * @brief Run a code snippet, returning the outcome instead of throwing
+		 *
+		 * @details
+		 * Same as Run(), and RunWithEnvironment() when env is given, but a failure
+		 * is returned as a status and described by getLastError(). Scripts that fail
+		 * often cost about the same as the ones that succeed: no exception is
+		 * thrown, and the message reuses the memory of the previous one.
+		 *
+		 * @param name Name under which the snippet is registered
+		 * @return RUN_OK, or the reason of the failure
+		 */
+		RunStatus RunChecked(const std::string &name);
+		RunStatus RunChecked(const std::string &name, const LuaEnvironment &env);
+
+		/**
+		 * @brief Fills the `_ENV` of one run of RunBatch(), the table on top of the stack of L. It must be left there
+		 */
+		using BatchSetup = std::function<void(lua_State *L, size_t index)>;
+
+		/**
+		 * @brief Receives the outcome of one run of RunBatch()
+		 *
+		 * The `_ENV` of the run is at index env of L. If status is RUN_OK, the values returned
+		 * by the chunk are the top nresults values of the stack, otherwise getLastError()
+		 * describes the failure. Nothing must be popped.
+		 */
+		using BatchResult = std::function<void(lua_State *L, size_t index, RunStatus status, int env, int nresults)>;
+
+		/**
+		 * @brief Runs a snippet count times, each with its own `_ENV`
+		 *
+		 * @details
+		 * The snippet is loaded once, and every run happens in the run state, so each
+		 * one costs about a `lua_pcall`, plus the new `_ENV` table. The tables have the
+		 * global variables and the libraries, like Run()'s, but keep_state is ignored:
+		 * the variables of a run aren't seen by the others. The values a run assigns to
+		 * the context's global variables are read back like in Run(), so the next runs
+		 * see them, and a value of the wrong type fails that run. A failed run doesn't
+		 * stop the batch.
+		 *
+		 * @param name Name under which the snippet is registered
+		 * @param count Amount of runs
+		 * @param setup Called before each run, to fill its `_ENV`
+		 * @param result Called after each run
+		 * @return RUN_OK, or the reason why the batch couldn't start: RUN_ERROR_NOT_FOUND, RUN_ERROR_LOAD or RUN_ERROR_MEMORY
+		 */
+		RunStatus RunBatch(const std::string &name, size_t count, const BatchSetup &setup, const BatchResult &result);
+
+		/**
+		 * @brief Returns the description of the last run that failed
+		 *
+		 * Only valid until the next run.
+		 */
+		const LuaRunError &getLastError () const {
+			return last_error;
+		}
+
+		/**
+		 * @brief Set the error_details flag
+		 *
+		 * @details
+		 * If true, failed runs also capture the source, line and traceback of the
+		 * error, with a `luaL_traceback` message handler. Off by default, so a failing
+		 * run doesn't pay for walking the stack unless the details are wanted.
+		 */
+		void setErrorDetails (bool details) {
+			error_details = details;
+		}
+
+		bool getErrorDetails () const {
+			return error_details;
+		}
+
+		/**
+		 * @brief Saves the script environment kept between runs, with LuaCheckpoint
+		 *
+		 * @details
+		 * Every variable written by the runs is saved, with the tables and closures
+		 * reached from them. The global variables of the context and the values of
+		 * the global table, like the libraries, are saved by name, so they must exist
+		 * where the checkpoint is restored. Changes made by the scripts to those
+		 * values, like a field added to a library table, aren't saved.
+		 *
+		 * @throws std::runtime_error if keep_state is false, or a value can't be saved
+		 */
+		std::string Checkpoint();
+
+		/**
+		 * @brief Replaces the script environment kept between runs with the one saved in checkpoint
+		 *
+		 * Rebuilding the environment doesn't run any code, so it's usually much
+		 * faster than running the scripts that built it. The run state is reused, or
+		 * created if there's none: the checkpoint can come from another context.
+		 *
+		 * @throws std::runtime_error if keep_state is false, or the checkpoint can't be restored. The environment is unchanged
+		 */
+		void Restore(const std::string &checkpoint);
+
+		/**
+		 * @brief Releases the tables lent to owner by the LuaTablePool of the run state, and forgets owner
+		 *
+		 * Call it before owner is destroyed. Does nothing if there is no run state.
+		 */
+		void ReleaseTables(const void *owner);
+
 		/**
 		* @brief Add a `C` library to the context
 		*
@@ -307,6 +894,18 @@ namespace LuaCpp {
 		*/
 		void AddLibrary(std::shared_ptr<Registry::LuaLibrary> &library);
 
+		/**
+		 * @brief Add a searcher to the `package.searchers` of every new state
+		 *
+		 * @details
+		 * The searchers are tried by `require` in the order they were added,
+		 * after `package.preload` and before Lua's own file searchers. The
+		 * package library must be among the core libraries for them to be used.
+		 *
+		 * @param searcher A searcher, as described by the Lua manual for `package.searchers`
+		 */
+		void AddPackageSearcher(lua_CFunction searcher);
+
 		/**
 		 * @brief Add a global variable
 		 *
@@ -318,11 +917,35 @@ namespace LuaCpp {
 		 * The variables will be accessible from the lua enging
 		 * under the registered name.
 		 *
+		 * The environment used by Run() is rebuilt before the next run.
+		 *
+		 * var is shared with the states created on other threads, so it must
+		 * not be changed once added: call AddGlobalVariable() again with a new
+		 * value instead.
+		 *
 		 * @param name name of the global variable
 		 * @param var the variable
 		 */
 		void AddGlobalVariable(const std::string &name, std::shared_ptr<Engine::LuaType> var);
 
+		/**
+		 * @brief Removes a global variable
+		 *
+		 * @param name name of the global variable
+		 */
+		void RemoveGlobalVariable(const std::string &name);
+
+		/**
+		 * @brief Forces the environment used by Run() to be rebuilt before the next run
+		 *
+		 * @details
+		 * The values of the global variables are copied into the environment when it
+		 * is built, and the variables are published again to the states created by
+		 * newState(). The variables themselves must not be changed in place: replace
+		 * them with AddGlobalVariable(), which already does this.
+		 */
+		void InvalidateGlobalEnvironment();
+
 		/**
 		 * @brief Retrurns the shared pointer to a global variable
 		 *
@@ -330,12 +953,16 @@ namespace LuaCpp {
 		 * Returns a shared pointer to the global variable. The variable
 		 * should be reinterpreted as the proper type.
 		 *
+		 * The variable is shared with the states created on other threads, so it
+		 * must only be read: replace it with AddGlobalVariable(). A run that assigns
+		 * the variable replaces it too, so call this again to see the new value.
+		 *
 		 * @param name Name of the global variable
 		 *
 		 * @returns
-		 * The shared pointer of the global variable
+		 * The shared pointer of the global variable, or null if there's none
 		 */
-		std::shared_ptr<Engine::LuaType> &getGlobalVariable(const std::string &name);
+		std::shared_ptr<Engine::LuaType> getGlobalVariable(const std::string &name) const;
 
 		/**
 		 * @brief Set the lua_core_libraries flags
@@ -348,6 +975,131 @@ namespace LuaCpp {
 		 * @brief Get the lua_core_libraries flags
 		 */
 		int getLuaCoreLibraries () const;
+
+		/**
+		 * @brief Set if the core libraries are opened lazily
+		 *
+		 * @see openLibs(Engine::LuaState &L, int lib_flags, bool lazy)
+		 */
+		void setLazyCoreLibraries (bool lazy);
+
+		/**
+		 * @brief Get if the core libraries are opened lazily
+		 */
+		bool getLazyCoreLibraries () const;
+
+		/**
+		 * @brief Set the keep_state flag
+		 *
+		 * @details
+		 * If true, Run() reuses the same `_ENV` table on the following runs,
+		 * so variables written by a run are still visible on the next one.
+		 * Setting it to false discards the kept variables.
+		 *
+		 * The kept variables are also discarded whenever the libraries or the
+		 * lua_core_libraries flags change, since the state is recreated.
+		 */
+		void setKeepState (bool keep);
+
+		/**
+		 * @brief Get the keep_state flag
+		 */
+		bool getKeepState () const;
+
+		/**
+		 * @brief Set the garbage collector's pause (`LUA_GCSETPAUSE`)
+		 *
+		 * @details
+		 * Applied to every new state, and to the run state if there is one.
+		 */
+		void setGCPause (int pause);
+
+		/**
+		 * @brief Get the garbage collector's pause
+		 */
+		int getGCPause () const;
+
+		/**
+		 * @brief Set the garbage collector's step multiplier (`LUA_GCSETSTEPMUL`)
+		 *
+		 * @details
+		 * Applied to every new state, and to the run state if there is one.
+		 */
+		void setGCStepMultiplier (int multiplier);
+
+		/**
+		 * @brief Get the garbage collector's step multiplier
+		 */
+		int getGCStepMultiplier () const;
+
+		/**
+		 * @brief Enables or stops the automatic garbage collection
+		 *
+		 * @details
+		 * When automatic collection is stopped, allocations made by the scripts
+		 * never trigger the collector. Garbage is only collected by StepGC(),
+		 * or freed when the state is closed.
+		 */
+		void setGCAutomatic (bool automatic);
+
+		/**
+		 * @brief Get if the automatic garbage collection is enabled
+		 */
+		bool isGCAutomatic () const;
+
+		/**
+		 * @brief Does incremental garbage collection work on the run state
+		 *
+		 * @details
+		 * Runs basic steps of `lua_gc(LUA_GCSTEP)` until the budget is
+		 * spent or the collector finishes a cycle. A single step is always
+		 * done, so the budget can be exceeded by the duration of one step.
+		 * Works even if the automatic collection is stopped.
+		 *
+		 * Does nothing if Run() wasn't called yet.
+		 *
+		 * @param budget_usec Time budget, in microseconds
+		 *
+		 * @return true if a collection cycle was finished
+		 */
+		bool StepGC (int budget_usec);
+
+		/**
+		 * @brief Returns the statistics of the states created by this context
+		 *
+		 * @details
+		 * Also reports the pending changes to the global statistics.
+		 * States returned by newState() and newStateFor() are accounted
+		 * for as well, so they must not outlive the context. The peak
+		 * of those states is sampled when this method is called.
+		 */
+		const LuaMemoryStats &getMemoryStats ();
+
+		/**
+		 * @brief Returns the amount of bytes in use by the run state, as reported by `lua_gc(LUA_GCCOUNT)`
+		 *
+		 * @return 0 if there is no run state
+		 */
+		int64_t getRunStateBytes ();
+
+		/**
+		 * @brief Starts sampling the Lua call stacks of Run(), discarding the previous samples
+		 *
+		 * @see LuaSamplingProfiler for the parameters and the overhead
+		 */
+		void StartProfiler (int sample_period_usec, int hook_instruction_count);
+
+		/**
+		 * @brief Stops sampling. The samples can still be read with getProfiler()
+		 */
+		void StopProfiler ();
+
+		bool isProfiling () const;
+
+		/**
+		 * @brief Returns the last started profiler, or nullptr if StartProfiler() was never called
+		 */
+		const LuaSamplingProfiler *getProfiler () const;
 		
 	};
 
@@ -356,8 +1108,28 @@ namespace LuaCpp {
 	 * 
 	 * @param L The state where the libraries will be opened
 	 * @param lib_flags Bitwise OR of the flags from CORE_LIBS_FLAGS
+	 *
+	 * @details
+	 * If the registry field PACKAGE_SEARCHERS_KEY holds a sequence of searchers,
+	 * they are inserted in `package.searchers` when the package library is opened.
 	 */
 	void openLibs (Engine::LuaState &L, int lib_flags);
+
+	/**
+	 * @brief Opens the chosen core Lua libraries inside the passed LuaState, optionally on first access
+	 *
+	 * @details
+	 * If lazy is true, the global table gets a metatable whose `__index` opens a
+	 * library with `luaL_requiref` the first time its global (or `require`, for
+	 * the package library) is read. The base and string libraries are always
+	 * opened immediately: base only defines global functions, and string sets the
+	 * metatable of strings, which scripts use without touching the global `string`.
+	 *
+	 * @param L The state where the libraries will be opened
+	 * @param lib_flags Bitwise OR of the flags from CORE_LIBS_FLAGS
+	 * @param lazy If true, libraries are opened on first access
+	 */
+	void openLibs (Engine::LuaState &L, int lib_flags, bool lazy);
 }
 
 /**
@@ -0,0 +1,140 @@
+/**
+ * @file LuaSamplingProfiler.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Sampling profiler of Lua call stacks, with folded-stack output for flame graphs
+ * @date 2026-10-18
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "LuaSamplingProfiler.hpp"
+
+namespace LuaCpp {
+
+namespace {
+	/**
+	 * @brief Its address is the registry key of the profiler attached to a state
+	 */
+	const char PROFILER_KEY = 0;
+
+	/**
+	 * @brief Appends the name of the frame, without the separator ';' of the folded format
+	 */
+	void appendFrame (std::string &out, const lua_Debug &ar) {
+		size_t start = out.size();
+		if (strcmp(ar.what, "main") == 0) {
+			out += "main chunk (";
+			out += ar.short_src;
+			out += ")";
+		} else if (strcmp(ar.what, "C") == 0) {
+			out += "[C] ";
+			out += ar.name ? ar.name : "?";
+		} else {
+			out += ar.name ? ar.name : "?";
+			out += " (";
+			out += ar.short_src;
+			out += ":";
+			out += std::to_string(ar.linedefined);
+			out += ")";
+		}
+		std::replace(out.begin() + start, out.end(), ';', ':');
+	}
+}
+
+LuaSamplingProfiler::LuaSamplingProfiler (int sample_period_usec, int hook_instruction_count)
+	: sample_period_usec(std::max(sample_period_usec, (int) MIN_SAMPLE_PERIOD_USEC)),
+	hook_instruction_count(std::max(hook_instruction_count, 1)),
+	next_sample(), samples(), sample_count(0), overhead_nsec(0), stack_buffer() {
+}
+
+void LuaSamplingProfiler::Attach (lua_State *L) {
+	lua_pushlightuserdata(L, this);
+	lua_rawsetp(L, LUA_REGISTRYINDEX, &PROFILER_KEY);
+	next_sample = Clock::now();
+	lua_sethook(L, &LuaSamplingProfiler::hook, LUA_MASKCOUNT, hook_instruction_count);
+}
+
+void LuaSamplingProfiler::Detach (lua_State *L) {
+	if (lua_gethook(L) != &LuaSamplingProfiler::hook) {
+		return;
+	}
+	lua_sethook(L, nullptr, 0, 0);
+	lua_pushnil(L);
+	lua_rawsetp(L, LUA_REGISTRYINDEX, &PROFILER_KEY);
+}
+
+void LuaSamplingProfiler::hook (lua_State *L, lua_Debug *ar) {
+	lua_rawgetp(L, LUA_REGISTRYINDEX, &PROFILER_KEY);
+	LuaSamplingProfiler *profiler = (LuaSamplingProfiler *) lua_touserdata(L, -1);
+	lua_pop(L, 1);
+	if (profiler == nullptr) {
+		return;
+	}
+	Clock::time_point now = Clock::now();
+	if (now < profiler->next_sample) {
+		return;
+	}
+	profiler->sample(L);
+	Clock::time_point end = Clock::now();
+	profiler->overhead_nsec += std::chrono::duration_cast<std::chrono::nanoseconds>(end - now).count();
+	// Counted from the end of the sample, so a slow sample can't make the next one come sooner
+	profiler->next_sample = end + std::chrono::microseconds(profiler->sample_period_usec);
+}
+
+void LuaSamplingProfiler::sample (lua_State *L) {
+	lua_Debug frames[MAX_DEPTH];
+	int depth = 0;
+	while (depth < MAX_DEPTH && lua_getstack(L, depth, &frames[depth])) {
+		lua_getinfo(L, "Sn", &frames[depth]);
+		depth++;
+	}
+	if (depth == 0) {
+		return;
+	}
+	// Root first, as flame graph tools expect
+	stack_buffer.clear();
+	for (int level = depth - 1; level >= 0; level--) {
+		appendFrame(stack_buffer, frames[level]);
+		if (level > 0) {
+			stack_buffer += ';';
+		}
+	}
+	samples[stack_buffer]++;
+	sample_count++;
+}
+
+void LuaSamplingProfiler::Clear () {
+	samples.clear();
+	sample_count = 0;
+	overhead_nsec = 0;
+}
+
+std::string LuaSamplingProfiler::getFoldedStacks () const {
+	std::string folded;
+	for (const auto &stack : samples) {
+		folded += stack.first;
+		folded += ' ';
+		folded += std::to_string(stack.second);
+		folded += '\n';
+	}
+	return folded;
+}
+
+uint64_t LuaSamplingProfiler::getSampleCount () const {
+	return sample_count;
+}
+
+uint64_t LuaSamplingProfiler::getOverheadUsec () const {
+	return overhead_nsec / 1000;
+}
+
+int LuaSamplingProfiler::getSamplePeriodUsec () const {
+	return sample_period_usec;
+}
+
+int LuaSamplingProfiler::getHookInstructionCount () const {
+	return hook_instruction_count;
+}
+
+} /* namespace LuaCpp */
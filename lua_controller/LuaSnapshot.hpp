@@ -0,0 +1,166 @@
+/**
+ * @file LuaSnapshot.hpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Immutable value shared by threads, read without locks and replaced by copy (RCU)
+ * @date 2026-10-18
+ *
+ * @details
+ * Readers enter a read section with a LuaSnapshot::Reader, which costs two
+ * atomic increments on a counter of their own thread's slot, and read the
+ * current value without locking nor copying it. Readers are wait-free: they never
+ * retry nor wait for a writer.
+ *
+ * Writers publish a new value with Publish() or Update(), one at a time. The
+ * old value is deleted after a grace period: once every reader that could
+ * have seen it left its read section. Each reader increments the counter of
+ * the epoch it saw, and the writer waits for the counters of both epochs in
+ * turn, flipping the epoch before each wait, so the readers that arrive during
+ * the wait don't delay it.
+ *
+ * Writers wait for the readers, so a read section must not publish. This file
+ * doesn't depend on Godot.
+ */
+
+#ifndef LUACPP_LUASNAPSHOT_HPP
+#define LUACPP_LUASNAPSHOT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace LuaCpp {
+
+	/**
+	 * @brief Number of slots of reader counters. Threads are spread over them, so
+	 * readers on different threads rarely share a cache line
+	 */
+	const unsigned SNAPSHOT_SLOTS = 16;
+
+	/**
+	 * @brief Slot of the calling thread, given in turn to each thread on its first call
+	 */
+	inline unsigned snapshotSlot () {
+		static std::atomic<unsigned> next_slot(0);
+		thread_local unsigned slot = next_slot.fetch_add(1, std::memory_order_relaxed) % SNAPSHOT_SLOTS;
+		return slot;
+	}
+
+	template <typename T>
+	class LuaSnapshot {
+	private:
+		struct ReaderSlot {
+			/* Readers in a read section, by the parity of the epoch they saw */
+			std::atomic<int64_t> readers[2];
+			char padding[64 - 2 * sizeof(std::atomic<int64_t>)];
+		};
+
+		std::atomic<const T *> current;
+		std::atomic<unsigned> epoch;
+		ReaderSlot slots[SNAPSHOT_SLOTS];
+		std::mutex writer;
+
+		/**
+		 * @brief Returns once every read section that started before the call has ended
+		 */
+		void waitForReaders () {
+			for (int phase = 0; phase < 2; phase++) {
+				unsigned parity = epoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+				for (ReaderSlot &slot : slots) {
+					while (slot.readers[parity].load(std::memory_order_acquire) != 0) {
+						std::this_thread::yield();
+					}
+				}
+			}
+		}
+
+	public:
+		/**
+		 * @brief Read section over the value, which stays valid until the reader is destroyed
+		 */
+		class Reader {
+		private:
+			const LuaSnapshot &snapshot;
+			std::atomic<int64_t> &counter;
+			const T *value;
+
+		public:
+			explicit Reader (const LuaSnapshot &snapshot)
+				: snapshot(snapshot)
+				, counter(const_cast<LuaSnapshot &>(snapshot).slots[snapshotSlot()].readers[snapshot.epoch.load(std::memory_order_seq_cst) & 1])
+			{
+				// Counted before the value is loaded, so a writer that replaces it waits for this reader
+				counter.fetch_add(1, std::memory_order_seq_cst);
+				value = snapshot.current.load(std::memory_order_seq_cst);
+			}
+
+			~Reader () {
+				counter.fetch_sub(1, std::memory_order_release);
+			}
+
+			Reader (const Reader &) = delete;
+			Reader &operator= (const Reader &) = delete;
+
+			const T &operator* () const {
+				return *value;
+			}
+
+			const T *operator-> () const {
+				return value;
+			}
+		};
+
+		explicit LuaSnapshot (T value = T()) : current(new T(std::move(value))), epoch(0) {
+			for (ReaderSlot &slot : slots) {
+				slot.readers[0].store(0, std::memory_order_relaxed);
+				slot.readers[1].store(0, std::memory_order_relaxed);
+			}
+		}
+
+		/**
+		 * @brief Deletes the value. No reader may be left
+		 */
+		~LuaSnapshot () {
+			delete current.load(std::memory_order_relaxed);
+		}
+
+		LuaSnapshot (const LuaSnapshot &) = delete;
+		LuaSnapshot &operator= (const LuaSnapshot &) = delete;
+
+		/**
+		 * @brief Replaces the value, and deletes the old one after the grace period
+		 */
+		void Publish (T value) {
+			std::lock_guard<std::mutex> lock(writer);
+			const T *old = current.exchange(new T(std::move(value)), std::memory_order_seq_cst);
+			waitForReaders();
+			delete old;
+		}
+
+		/**
+		 * @brief Publishes a copy of the value changed by update, a function taking a `T &`
+		 *
+		 * The writers are serialized, so no change made by a concurrent Update() is lost.
+		 *
+		 * @return The value returned by update
+		 */
+		template <typename F>
+		auto Update (F &&update) -> decltype(update(std::declval<T &>())) {
+			std::lock_guard<std::mutex> lock(writer);
+			T *next = new T(*current.load(std::memory_order_relaxed));
+			struct Publisher {
+				LuaSnapshot &snapshot;
+				T *next;
+				~Publisher () {
+					const T *old = snapshot.current.exchange(next, std::memory_order_seq_cst);
+					snapshot.waitForReaders();
+					delete old;
+				}
+			} publisher{ *this, next };
+			return update(*next);
+		}
+	};
+}
+
+#endif // LUACPP_LUASNAPSHOT_HPP
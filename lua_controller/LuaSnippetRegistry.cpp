@@ -0,0 +1,128 @@
+/**
+ * @file LuaSnippetRegistry.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Thread-safe registry of compiled Lua snippets
+ * @date 2026-10-18
+ */
+
+#include <stdexcept>
+
+#include "LuaSnippetRegistry.hpp"
+
+namespace LuaCpp {
+
+namespace {
+	using StatePtr = std::unique_ptr<lua_State, decltype(&lua_close)>;
+
+	StatePtr newCompileState () {
+		StatePtr L(luaL_newstate(), &lua_close);
+		if (!L) {
+			throw std::runtime_error("Error: Not enough memory to create a LuaState");
+		}
+		return L;
+	}
+
+	int writeBytecode (lua_State *L, const void *p, size_t size, void *ud) {
+		static_cast<std::string *>(ud)->append(static_cast<const char *>(p), size);
+		return 0;
+	}
+
+	/**
+	 * @brief Dumps the chunk left by a successful load on top of L, or throws the error message
+	 */
+	std::shared_ptr<const LuaSnippet> dumpSnippet (lua_State *L, int load_result, const std::string &name) {
+		if (load_result != LUA_OK) {
+			throw std::logic_error(lua_tostring(L, -1));
+		}
+		std::string bytecode;
+		if (lua_dump(L, &writeBytecode, &bytecode, 0) != 0) {
+			throw std::logic_error("Error: Couldn't dump the compiled chunk of " + name);
+		}
+		return std::make_shared<const LuaSnippet>(name, std::move(bytecode));
+	}
+}
+
+int LuaSnippet::Load (lua_State *L) const {
+	return luaL_loadbufferx(L, bytecode.data(), bytecode.size(), name.c_str(), "b");
+}
+
+void LuaSnippet::UploadCode (lua_State *L) const {
+	if (Load(L) != LUA_OK) {
+		std::string message(lua_tostring(L, -1));
+		lua_pop(L, 1);
+		throw std::runtime_error(message);
+	}
+}
+
+std::shared_ptr<const LuaSnippet> LuaSnippetRegistry::CompileString (const std::string &name, const std::string &code) {
+	return CompileBuffer(name, code, code);
+}
+
+std::shared_ptr<const LuaSnippet> LuaSnippetRegistry::CompileBuffer (const std::string &name, const std::string &buffer, const std::string &chunkname) {
+	StatePtr L = newCompileState();
+	int res = luaL_loadbufferx(L.get(), buffer.data(), buffer.size(), chunkname.c_str(), nullptr);
+	return dumpSnippet(L.get(), res, name);
+}
+
+std::shared_ptr<const LuaSnippet> LuaSnippetRegistry::CompileFile (const std::string &name, const std::string &path) {
+	StatePtr L = newCompileState();
+	int res = luaL_loadfilex(L.get(), path.c_str(), nullptr);
+	return dumpSnippet(L.get(), res, name);
+}
+
+std::shared_ptr<const LuaSnippet> LuaSnippetRegistry::CompileReader (const std::string &name, lua_Reader reader, void *data, const std::string &chunkname) {
+	StatePtr L = newCompileState();
+	int res = lua_load(L.get(), reader, data, chunkname.c_str(), nullptr);
+	return dumpSnippet(L.get(), res, name);
+}
+
+void LuaSnippetRegistry::Add (std::shared_ptr<const LuaSnippet> snippet) {
+	snippets.Update([&snippet] (SnippetMap &map) {
+		map[snippet->name] = std::move(snippet);
+	});
+}
+
+bool LuaSnippetRegistry::Exists (const std::string &name) const {
+	LuaSnapshot<SnippetMap>::Reader map(snippets);
+	return map->count(name) > 0;
+}
+
+std::shared_ptr<const LuaSnippet> LuaSnippetRegistry::Get (const std::string &name) const {
+	LuaSnapshot<SnippetMap>::Reader map(snippets);
+	auto it = map->find(name);
+	return it != map->end() ? it->second : nullptr;
+}
+
+bool LuaSnippetRegistry::Upload (const std::string &name, lua_State *L) const {
+	LuaSnapshot<SnippetMap>::Reader map(snippets);
+	auto it = map->find(name);
+	if (it == map->end()) {
+		return false;
+	}
+	// The map, and the snippets in it, live until the reader is destroyed
+	it->second->UploadCode(L);
+	return true;
+}
+
+bool LuaSnippetRegistry::Remove (const std::string &name) {
+	return snippets.Update([&name] (SnippetMap &map) {
+		return map.erase(name) > 0;
+	});
+}
+
+size_t LuaSnippetRegistry::Size () const {
+	LuaSnapshot<SnippetMap>::Reader map(snippets);
+	return map->size();
+}
+
+std::vector<std::string> LuaSnippetRegistry::Names () const {
+	LuaSnapshot<SnippetMap>::Reader map(snippets);
+	std::vector<std::string> names;
+	names.reserve(map->size());
+	for (const auto &snippet : *map) {
+		names.push_back(snippet.first);
+	}
+	return names;
+}
+
+} /* namespace LuaCpp */
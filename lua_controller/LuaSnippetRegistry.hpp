@@ -0,0 +1,136 @@
+/**
+ * @file LuaSnippetRegistry.hpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Thread-safe registry of compiled Lua snippets
+ * @date 2026-10-18
+ *
+ * @details
+ * Replaces LuaCpp's Registry::LuaRegistry in LuaControllerContext. A snippet
+ * is immutable once compiled, and is shared through `std::shared_ptr`, so a
+ * snippet can be compiled on any thread, in its own state, and installed by
+ * publishing a new copy of the map (see LuaSnapshot). Lookups don't lock: any
+ * number of threads can read the registry while another one adds snippets. A
+ * run that already got the old snippet keeps it alive until it's done.
+ */
+
+#ifndef LUACPP_LUASNIPPETREGISTRY_HPP
+#define LUACPP_LUASNIPPETREGISTRY_HPP
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <LuaCpp.hpp>
+#include "LuaSnapshot.hpp"
+
+namespace LuaCpp {
+
+	/**
+	 * @brief Bytecode of a compiled chunk, as written by `lua_dump`
+	 */
+	struct LuaSnippet {
+		const std::string name;
+		const std::string bytecode;
+
+		LuaSnippet (const std::string &name, std::string &&bytecode) : name(name), bytecode(std::move(bytecode)) {}
+
+		/**
+		 * @brief Loads the chunk on top of the stack of L
+		 *
+		 * If the bytecode can't be loaded, the method will throw `std::runtime_error`
+		 */
+		void UploadCode (lua_State *L) const;
+
+		/**
+		 * @brief Same as UploadCode(), without exceptions
+		 *
+		 * @return The status of `lua_load`. On failure, the error message is on top of the stack instead of the chunk
+		 */
+		int Load (lua_State *L) const;
+	};
+
+	class LuaSnippetRegistry {
+	private:
+		using SnippetMap = std::map<std::string, std::shared_ptr<const LuaSnippet>>;
+
+		/* Copied on each write, read without locking */
+		LuaSnapshot<SnippetMap> snippets;
+
+	public:
+		/**
+		 * @brief Compiles code in a new state, without touching any registry. Safe to call from any thread
+		 *
+		 * The chunk is named after its code, like `luaL_loadstring` does. If the compilation
+		 * fails, the method will throw `std::logic_error` with the message from Lua
+		 */
+		static std::shared_ptr<const LuaSnippet> CompileString (const std::string &name, const std::string &code);
+
+		/**
+		 * @brief Compiles buffer in a new state, with the given chunk name. Safe to call from any thread
+		 *
+		 * buffer can be source code or the bytecode of another snippet: bytecode is checked
+		 * by loading it, which fails if it was dumped by an incompatible build of Lua. If it
+		 * fails, the method will throw `std::logic_error` with the message from Lua
+		 *
+		 * @param chunkname Name of the chunk in the error messages and in the debug information
+		 */
+		static std::shared_ptr<const LuaSnippet> CompileBuffer (const std::string &name, const std::string &buffer, const std::string &chunkname);
+
+		/**
+		 * @brief Compiles the file at path in a new state. Safe to call from any thread
+		 *
+		 * If the compilation fails, the method will throw `std::logic_error` with the message from Lua
+		 */
+		static std::shared_ptr<const LuaSnippet> CompileFile (const std::string &name, const std::string &path);
+
+		/**
+		 * @brief Compiles the chunk given by reader in a new state, with `lua_load`. Safe to call from any thread
+		 *
+		 * The source is only held a block at a time, as the reader gives it. If the compilation
+		 * fails, the method will throw `std::logic_error` with the message from Lua
+		 *
+		 * @param chunkname Name of the chunk in the error messages and in the debug information
+		 */
+		static std::shared_ptr<const LuaSnippet> CompileReader (const std::string &name, lua_Reader reader, void *data, const std::string &chunkname);
+
+		/**
+		 * @brief Adds the snippet, replacing the one with the same name
+		 *
+		 * The writers are serialized, and each one copies the map, so add the snippets
+		 * when they're compiled rather than on every run.
+		 */
+		void Add (std::shared_ptr<const LuaSnippet> snippet);
+
+		bool Exists (const std::string &name) const;
+
+		/**
+		 * @brief Returns the snippet, or nullptr if the name is not found
+		 */
+		std::shared_ptr<const LuaSnippet> Get (const std::string &name) const;
+
+		/**
+		 * @brief Loads the snippet on top of the stack of L, without copying its shared pointer
+		 *
+		 * If the bytecode can't be loaded, the method will throw `std::runtime_error`
+		 *
+		 * @return false if the name is not found, then nothing is pushed
+		 */
+		bool Upload (const std::string &name, lua_State *L) const;
+
+		/**
+		 * @brief Removes the snippet. Runs that already got it are not affected
+		 *
+		 * @return true if the name was found
+		 */
+		bool Remove (const std::string &name);
+
+		size_t Size () const;
+
+		/**
+		 * @brief Returns the names of the snippets, in alphabetical order
+		 */
+		std::vector<std::string> Names () const;
+	};
+}
+
+#endif // LUACPP_LUASNIPPETREGISTRY_HPP
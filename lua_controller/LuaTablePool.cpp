@@ -0,0 +1,201 @@
+/**
+ * @file LuaTablePool.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Free list of tables per Lua state, reused for the values marshalled into it
+ * @date 2026-10-18
+ */
+
+#include "LuaTablePool.hpp"
+
+namespace LuaCpp {
+
+const char *const TABLE_POOL_KEY = "LuaTablePool.pool";
+
+namespace {
+	/**
+	 * @brief Indices of the pool's fields: the free list, the tables lent to each owner, and the kept tables
+	 */
+	enum PoolField {
+		POOL_FREE = 1,
+		POOL_LENT,
+		POOL_KEPT
+	};
+
+	/**
+	 * @brief Pushes the pool of L, creating it on the first use
+	 */
+	void pushPool (lua_State *L) {
+		if (lua_getfield(L, LUA_REGISTRYINDEX, TABLE_POOL_KEY) == LUA_TTABLE)
+			return;
+		lua_pop(L, 1);
+		lua_createtable(L, 3, 0);
+		lua_newtable(L);
+		lua_rawseti(L, -2, POOL_FREE);
+		lua_newtable(L);
+		lua_rawseti(L, -2, POOL_LENT);
+		// Weak keys, so the kept tables are still collected
+		lua_newtable(L);
+		lua_createtable(L, 0, 1);
+		lua_pushliteral(L, "k");
+		lua_setfield(L, -2, "__mode");
+		lua_setmetatable(L, -2);
+		lua_rawseti(L, -2, POOL_KEPT);
+		lua_pushvalue(L, -1);
+		lua_setfield(L, LUA_REGISTRYINDEX, TABLE_POOL_KEY);
+	}
+
+	/**
+	 * @brief Removes every field of the table at idx, without resizing it, and its metatable
+	 */
+	void clearTable (lua_State *L, int idx) {
+		lua_pushnil(L);
+		while (lua_next(L, idx)) {
+			// Assigning nil to an existing field is allowed while traversing
+			lua_pop(L, 1);
+			lua_pushvalue(L, -1);
+			lua_pushnil(L);
+			lua_rawset(L, idx);
+		}
+		lua_pushnil(L);
+		lua_setmetatable(L, idx);
+	}
+
+	void keep (lua_State *L, int idx, int kept, int depth) {
+		if (depth >= LuaTablePool::MAX_NESTING || !lua_checkstack(L, 3))
+			return;
+		lua_pushvalue(L, idx);
+		// Already kept, which also stops at cycles
+		if (lua_rawget(L, kept) != LUA_TNIL) {
+			lua_pop(L, 1);
+			return;
+		}
+		lua_pop(L, 1);
+		lua_pushvalue(L, idx);
+		lua_pushboolean(L, 1);
+		lua_rawset(L, kept);
+
+		lua_pushnil(L);
+		while (lua_next(L, idx)) {
+			if (lua_type(L, -1) == LUA_TTABLE)
+				keep(L, lua_gettop(L), kept, depth + 1);
+			if (lua_type(L, -2) == LUA_TTABLE)
+				keep(L, lua_gettop(L) - 1, kept, depth + 1);
+			lua_pop(L, 1);
+		}
+	}
+
+	int tablesKeep (lua_State *L) {
+		luaL_checktype(L, 1, LUA_TTABLE);
+		LuaTablePool::Keep(L, 1);
+		lua_settop(L, 1);
+		return 1;
+	}
+}
+
+void LuaTablePool::Acquire (lua_State *L, const void *owner, int narr, int nrec) {
+	luaL_checkstack(L, 5, "LuaTablePool");
+	pushPool(L);
+	int pool = lua_gettop(L);
+
+	lua_rawgeti(L, pool, POOL_FREE);
+	lua_Integer free_count = (lua_Integer) lua_rawlen(L, -1);
+	if (free_count > 0) {
+		lua_rawgeti(L, -1, free_count);
+		lua_pushnil(L);
+		lua_rawseti(L, -3, free_count);
+	} else {
+		lua_createtable(L, narr, nrec);
+	}
+	lua_remove(L, -2);
+
+	// Appends the table to the list of its owner
+	lua_rawgeti(L, pool, POOL_LENT);
+	if (lua_rawgetp(L, -1, owner) != LUA_TTABLE) {
+		lua_pop(L, 1);
+		lua_newtable(L);
+		lua_pushvalue(L, -1);
+		lua_rawsetp(L, -3, owner);
+	}
+	lua_pushvalue(L, -3);
+	lua_rawseti(L, -2, (lua_Integer) lua_rawlen(L, -2) + 1);
+	lua_pop(L, 2);
+
+	lua_replace(L, pool);
+}
+
+void LuaTablePool::Release (lua_State *L, const void *owner) {
+	luaL_checkstack(L, 6, "LuaTablePool");
+	if (lua_getfield(L, LUA_REGISTRYINDEX, TABLE_POOL_KEY) != LUA_TTABLE) {
+		lua_pop(L, 1);
+		return;
+	}
+	int pool = lua_gettop(L);
+	lua_rawgeti(L, pool, POOL_LENT);
+	if (lua_rawgetp(L, -1, owner) != LUA_TTABLE) {
+		lua_pop(L, 3);
+		return;
+	}
+	int lent = lua_gettop(L);
+	lua_rawgeti(L, pool, POOL_FREE);
+	int free_list = lua_gettop(L);
+	lua_rawgeti(L, pool, POOL_KEPT);
+	int kept = lua_gettop(L);
+
+	lua_Integer free_count = (lua_Integer) lua_rawlen(L, free_list);
+	for (lua_Integer i = (lua_Integer) lua_rawlen(L, lent); i >= 1; i--) {
+		lua_rawgeti(L, lent, i);
+		lua_pushvalue(L, -1);
+		bool is_kept = lua_rawget(L, kept) != LUA_TNIL;
+		lua_pop(L, 1);
+		if (!is_kept && free_count < MAX_FREE) {
+			clearTable(L, lua_gettop(L));
+			lua_rawseti(L, free_list, ++free_count);
+		} else {
+			lua_pop(L, 1);
+		}
+		// The list keeps its size for the next tables lent to owner
+		lua_pushnil(L);
+		lua_rawseti(L, lent, i);
+	}
+	lua_settop(L, pool - 1);
+}
+
+void LuaTablePool::Forget (lua_State *L, const void *owner) {
+	Release(L, owner);
+	if (lua_getfield(L, LUA_REGISTRYINDEX, TABLE_POOL_KEY) != LUA_TTABLE) {
+		lua_pop(L, 1);
+		return;
+	}
+	lua_rawgeti(L, -1, POOL_LENT);
+	lua_pushnil(L);
+	lua_rawsetp(L, -2, owner);
+	lua_pop(L, 2);
+}
+
+void LuaTablePool::Keep (lua_State *L, int idx) {
+	idx = lua_absindex(L, idx);
+	luaL_checkstack(L, 4, "LuaTablePool");
+	pushPool(L);
+	lua_rawgeti(L, -1, POOL_KEPT);
+	keep(L, idx, lua_gettop(L), 0);
+	lua_pop(L, 2);
+}
+
+int LuaTablePool::FreeCount (lua_State *L) {
+	if (lua_getfield(L, LUA_REGISTRYINDEX, TABLE_POOL_KEY) != LUA_TTABLE) {
+		lua_pop(L, 1);
+		return 0;
+	}
+	lua_rawgeti(L, -1, POOL_FREE);
+	int count = (int) lua_rawlen(L, -1);
+	lua_pop(L, 2);
+	return count;
+}
+
+std::shared_ptr<Registry::LuaLibrary> newTablePoolLibrary () {
+	auto lib = std::make_shared<Registry::LuaLibrary>("tables");
+	lib->AddCFunction("keep", tablesKeep);
+	return lib;
+}
+
+} /* namespace LuaCpp */
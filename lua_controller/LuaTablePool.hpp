@@ -0,0 +1,86 @@
+/**
+ * @file LuaTablePool.hpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Free list of tables per Lua state, reused for the values marshalled into it
+ * @date 2026-10-18
+ *
+ * @details
+ * The tables built from Godot's Arrays and Dictionaries usually become garbage
+ * right after the call that received them. A pool lends them to an owner (a
+ * LuaCallable, for example) instead: when the owner releases them, they're
+ * cleared in place and go back to the free list, so their array and hash parts
+ * are reused as they are, and steady-state marshalling makes no garbage.
+ *
+ * A released table must not be used by the script anymore. A script that keeps
+ * one marks it with the "tables" library, and it's never reused:
+ *
+ *     local path = tables.keep(get_path())  -- also keeps the tables inside it
+ *
+ * Each state has its own pool, in its registry. This file doesn't depend on Godot.
+ */
+
+#ifndef LUACPP_LUATABLEPOOL_HPP
+#define LUACPP_LUATABLEPOOL_HPP
+
+#include <memory>
+#include <LuaCpp.hpp>
+
+namespace LuaCpp {
+
+	/**
+	 * @brief Registry field of each state holding its pool
+	 */
+	extern const char *const TABLE_POOL_KEY;
+
+	class LuaTablePool {
+	public:
+		/**
+		 * @brief Released tables beyond this number are left to the garbage collector
+		 */
+		static const int MAX_FREE = 256;
+
+		/**
+		 * @brief Tables nested deeper aren't marked by Keep()
+		 */
+		static const int MAX_NESTING = 32;
+
+		/**
+		 * @brief Pushes an empty table without metatable, lent to owner until Release(L, owner)
+		 *
+		 * The table is taken from the free list, or created with room for narr and nrec elements if it's empty.
+		 */
+		static void Acquire (lua_State *L, const void *owner, int narr = 0, int nrec = 0);
+
+		/**
+		 * @brief Clears the tables lent to owner and returns them to the free list, except the kept ones
+		 *
+		 * They're returned in reverse order, so the next Acquire() calls get them in the same order,
+		 * with the sizes they had.
+		 */
+		static void Release (lua_State *L, const void *owner);
+
+		/**
+		 * @brief Releases the tables lent to owner, and drops its list
+		 *
+		 * Call it before owner is destroyed, so another owner created at the same address doesn't get its tables.
+		 */
+		static void Forget (lua_State *L, const void *owner);
+
+		/**
+		 * @brief Marks the table at idx, and the tables in it, so they're never returned to the free list
+		 */
+		static void Keep (lua_State *L, int idx);
+
+		/**
+		 * @brief Number of tables in the free list of L
+		 */
+		static int FreeCount (lua_State *L);
+	};
+
+	/**
+	 * @brief Builds the "tables" library, with `tables.keep(t)`, which marks t with LuaTablePool::Keep() and returns it
+	 */
+	std::shared_ptr<Registry::LuaLibrary> newTablePoolLibrary ();
+}
+
+#endif // LUACPP_LUATABLEPOOL_HPP
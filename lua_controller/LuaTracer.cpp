@@ -0,0 +1,222 @@
+/**
+ * @file LuaTracer.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Optional timeline tracer, with output in Chrome's trace-event JSON format
+ * @date 2026-10-18
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "LuaTracer.hpp"
+
+namespace LuaCpp {
+
+namespace {
+	struct TraceEvent {
+		int64_t timestamp_usec;
+		char phase;
+		char name[LuaTracer::MAX_NAME_LENGTH + 1];
+	};
+
+	/**
+	 * @brief Events of one thread. Only that thread advances head, only the flush advances tail
+	 */
+	struct ThreadRing {
+		TraceEvent events[LuaTracer::RING_CAPACITY];
+		std::atomic<uint64_t> head { 0 };
+		std::atomic<uint64_t> tail { 0 };
+		std::atomic<uint64_t> dropped { 0 };
+		uint32_t thread_id = 0;
+		/** Set when the thread exits: once drained, the ring is removed from the registry */
+		std::atomic<bool> finished { false };
+		/** Only used by the owner thread: for each open Begin(), if it was recorded */
+		std::vector<bool> open_events;
+		/** Recorded Begin() events still waiting for their End() */
+		uint64_t open_recorded = 0;
+	};
+
+	/**
+	 * @brief Rings of every thread that recorded an event. They outlive their threads, so the
+	 * events of a finished thread can still be flushed, and are removed by the next flush or clear
+	 */
+	struct RingRegistry {
+		std::mutex mutex;
+		std::vector<std::shared_ptr<ThreadRing>> rings;
+		/** Thread ids of the removed rings, given to the next threads */
+		std::vector<uint32_t> free_thread_ids;
+		uint32_t next_thread_id = 1;
+
+		/**
+		 * @brief Removes the rings of the threads that exited, once their events were read.
+		 * The mutex must be held
+		 */
+		void removeFinished () {
+			for (size_t i = 0; i < rings.size();) {
+				ThreadRing &ring = *rings[i];
+				if (ring.finished.load(std::memory_order_acquire) &&
+						ring.tail.load(std::memory_order_relaxed) == ring.head.load(std::memory_order_acquire)) {
+					free_thread_ids.push_back(ring.thread_id);
+					rings[i] = std::move(rings.back());
+					rings.pop_back();
+				} else {
+					i++;
+				}
+			}
+		}
+	};
+
+	RingRegistry &registry () {
+		static RingRegistry instance;
+		return instance;
+	}
+
+	/**
+	 * @brief The ring of a thread, marked as finished when the thread exits
+	 */
+	struct LocalRing {
+		std::shared_ptr<ThreadRing> ring;
+
+		~LocalRing () {
+			if (ring) {
+				ring->finished.store(true, std::memory_order_release);
+			}
+		}
+	};
+
+	ThreadRing &localRing () {
+		thread_local LocalRing local;
+		if (!local.ring) {
+			local.ring = std::make_shared<ThreadRing>();
+			RingRegistry &reg = registry();
+			std::lock_guard<std::mutex> lock(reg.mutex);
+			if (reg.free_thread_ids.empty()) {
+				local.ring->thread_id = reg.next_thread_id++;
+			} else {
+				local.ring->thread_id = reg.free_thread_ids.back();
+				reg.free_thread_ids.pop_back();
+			}
+			reg.rings.push_back(local.ring);
+		}
+		return *local.ring;
+	}
+
+	void appendEscaped (std::string &out, const char *text) {
+		for (const char *c = text; *c; c++) {
+			if (*c == '"' || *c == '\\') {
+				out += '\\';
+				out += *c;
+			} else if ((unsigned char) *c < 0x20) {
+				out += ' ';
+			} else {
+				out += *c;
+			}
+		}
+	}
+
+	void record (ThreadRing &ring, const char *name, char phase) {
+		uint64_t head = ring.head.load(std::memory_order_relaxed);
+		TraceEvent &event = ring.events[head % LuaTracer::RING_CAPACITY];
+		event.timestamp_usec = LuaTracer::nowUsec();
+		event.phase = phase;
+		strncpy(event.name, name, LuaTracer::MAX_NAME_LENGTH);
+		event.name[LuaTracer::MAX_NAME_LENGTH] = '\0';
+		// Publishes the event to the flush
+		ring.head.store(head + 1, std::memory_order_release);
+	}
+}
+
+std::atomic<bool> LuaTracer::enabled(false);
+
+void LuaTracer::setEnabled (bool enabled) {
+	LuaTracer::enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void LuaTracer::Begin (const char *name) {
+	ThreadRing &ring = localRing();
+	uint64_t used = ring.head.load(std::memory_order_relaxed) - ring.tail.load(std::memory_order_acquire);
+	// Keeps a slot free for the End() of every recorded Begin(), so the timeline stays balanced
+	bool fits = used + ring.open_recorded + 2 <= RING_CAPACITY;
+	ring.open_events.push_back(fits);
+	if (!fits) {
+		ring.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	ring.open_recorded++;
+	record(ring, name, 'B');
+}
+
+void LuaTracer::End (const char *name) {
+	ThreadRing &ring = localRing();
+	if (ring.open_events.empty()) {
+		return;
+	}
+	bool recorded = ring.open_events.back();
+	ring.open_events.pop_back();
+	if (!recorded) {
+		ring.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	ring.open_recorded--;
+	record(ring, name, 'E');
+}
+
+std::string LuaTracer::FlushChromeJson (int64_t offset_usec) {
+	std::string json = "{\"traceEvents\":[";
+	bool first = true;
+	char fields[128];
+
+	RingRegistry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	for (const std::shared_ptr<ThreadRing> &ring : reg.rings) {
+		uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+		uint64_t head = ring->head.load(std::memory_order_acquire);
+		for (; tail != head; tail++) {
+			const TraceEvent &event = ring->events[tail % RING_CAPACITY];
+			json += first ? "\n" : ",\n";
+			first = false;
+			json += "{\"name\":\"";
+			appendEscaped(json, event.name);
+			snprintf(fields, sizeof(fields), "\",\"cat\":\"lua\",\"ph\":\"%c\",\"ts\":%lld,\"pid\":1,\"tid\":%u}",
+				event.phase, (long long) (event.timestamp_usec + offset_usec), ring->thread_id);
+			json += fields;
+		}
+		// Frees the slots for the writer
+		ring->tail.store(tail, std::memory_order_release);
+		ring->dropped.store(0, std::memory_order_relaxed);
+	}
+	reg.removeFinished();
+	json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return json;
+}
+
+void LuaTracer::Clear () {
+	RingRegistry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	for (const std::shared_ptr<ThreadRing> &ring : reg.rings) {
+		ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_release);
+		ring->dropped.store(0, std::memory_order_relaxed);
+	}
+	reg.removeFinished();
+}
+
+int64_t LuaTracer::nowUsec () {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t LuaTracer::getDroppedEvents () {
+	uint64_t dropped = 0;
+	RingRegistry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	for (const std::shared_ptr<ThreadRing> &ring : reg.rings) {
+		dropped += ring->dropped.load(std::memory_order_relaxed);
+	}
+	return dropped;
+}
+
+} /* namespace LuaCpp */
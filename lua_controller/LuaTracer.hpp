@@ -0,0 +1,123 @@
+/**
+ * @file LuaTracer.hpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Optional timeline tracer, with output in Chrome's trace-event JSON format
+ * @date 2026-10-18
+ *
+ * @details
+ * Begin and end events are written to a ring buffer owned by the thread that
+ * records them, without locks: each ring has a single writer (its thread) and
+ * a single reader (FlushChromeJson(), which holds the registry's mutex). When a
+ * ring is full, new events are dropped and counted, the reader never waits for
+ * the writers. A slot is kept for the end of every recorded begin, so a full
+ * ring never leaves an event open.
+ *
+ * A ring takes about 1 MiB. The ring of a thread that exited is freed by the
+ * first FlushChromeJson() or Clear() after the thread exits, and its thread id is reused.
+ *
+ * The module's instrumentation uses LUA_TRACE_SCOPE, which is compiled out
+ * unless LUA_TRACING is defined (see SCsub). When compiled in but disabled at
+ * runtime, a scope costs one relaxed atomic load.
+ *
+ * The JSON can be opened by chrome://tracing or https://ui.perfetto.dev
+ */
+
+#ifndef LUACPP_LUATRACER_HPP
+#define LUACPP_LUATRACER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace LuaCpp {
+
+	class LuaTracer {
+	public:
+		enum LIMITS {
+			RING_CAPACITY = 16384, //< Events per thread between flushes
+			MAX_NAME_LENGTH = 47   //< Longer names are truncated
+		};
+
+		/**
+		 * @brief Enables or disables the recording of events, for every thread
+		 */
+		static void setEnabled (bool enabled);
+
+		static bool isEnabled () {
+			return enabled.load(std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief Records the start of a duration event on the calling thread. The name is copied
+		 */
+		static void Begin (const char *name);
+
+		/**
+		 * @brief Records the end of the last duration event started on the calling thread
+		 */
+		static void End (const char *name);
+
+		/**
+		 * @brief Removes every recorded event and returns them as a Chrome trace-event JSON object
+		 *
+		 * @param offset_usec Added to every timestamp, to align them with another clock
+		 */
+		static std::string FlushChromeJson (int64_t offset_usec = 0);
+
+		/**
+		 * @brief Discards every recorded event
+		 */
+		static void Clear ();
+
+		/**
+		 * @brief Current time of the tracer's clock, in microseconds
+		 */
+		static int64_t nowUsec ();
+
+		/**
+		 * @brief Events dropped because a ring was full, since the last flush
+		 */
+		static uint64_t getDroppedEvents ();
+
+	private:
+		static std::atomic<bool> enabled;
+	};
+
+	/**
+	 * @brief Records a duration event for the lifetime of the object, if tracing is enabled
+	 */
+	class LuaTraceScope {
+		const char *name;
+		bool active;
+
+	public:
+		explicit LuaTraceScope (const char *name) : name(name), active(LuaTracer::isEnabled()) {
+			if (active) {
+				LuaTracer::Begin(name);
+			}
+		}
+
+		~LuaTraceScope () {
+			if (active) {
+				LuaTracer::End(name);
+			}
+		}
+
+		LuaTraceScope (const LuaTraceScope &) = delete;
+		LuaTraceScope &operator= (const LuaTraceScope &) = delete;
+	};
+}
+
+#define LUA_TRACE_CONCAT_IMPL(a, b) a##b
+#define LUA_TRACE_CONCAT(a, b) LUA_TRACE_CONCAT_IMPL(a, b)
+
+/**
+ * @brief Traces the rest of the enclosing scope as an event named `name`
+ */
+#ifdef LUA_TRACING
+#define LUA_TRACE_SCOPE(name) LuaCpp::LuaTraceScope LUA_TRACE_CONCAT(lua_trace_scope_, __LINE__)(name)
+#else
+#define LUA_TRACE_SCOPE(name)
+#endif
+
+#endif // LUACPP_LUATRACER_HPP
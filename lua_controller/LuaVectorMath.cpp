@@ -0,0 +1,1016 @@
+/**
+ * @file LuaVectorMath.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Native vector math library for the Lua scripts, registered as the global "vmath"
+ * @date 2026-10-18
+ */
+
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+#if defined(__SSE__) || defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "LuaVectorMath.hpp"
+
+namespace LuaCpp {
+
+namespace VectorMath {
+
+const char *const VEC2_METATABLE = "vmath.vec2";
+const char *const VEC3_METATABLE = "vmath.vec3";
+const char *const QUAT_METATABLE = "vmath.quat";
+const char *const TRANSFORM_METATABLE = "vmath.transform";
+const char *const ARRAY_METATABLE = "vmath.array";
+
+namespace {
+	/**
+	 * @brief Alignment, in floats, of each component block of an Array. Fits an AVX register
+	 */
+	const size_t ARRAY_ALIGNMENT = 8;
+
+	const char *const COMPONENT_NAMES = "xyz";
+
+	void createMetatable (lua_State *L, const char *name);
+
+	/**
+	 * @brief Pushes the metatable of name, creating it the first time it's used in L
+	 */
+	void pushMetatable (lua_State *L, const char *name) {
+		if (luaL_getmetatable(L, name) == LUA_TNIL) {
+			lua_pop(L, 1);
+			createMetatable(L, name);
+		}
+	}
+
+	template <typename T>
+	T *newUserdata (lua_State *L, const char *metatable) {
+		T *data = (T *) lua_newuserdata(L, sizeof(T));
+		pushMetatable(L, metatable);
+		lua_setmetatable(L, -2);
+		return data;
+	}
+
+	/**
+	 * @brief Returns the component index of a one letter key, or -1
+	 */
+	int componentIndex (lua_State *L, int idx, const char *components) {
+		size_t len;
+		const char *key = lua_tolstring(L, idx, &len);
+		if (len != 1) {
+			return -1;
+		}
+		const char *c = strchr(components, key[0]);
+		return c ? (int) (c - components) : -1;
+	}
+
+	/**
+	 * @brief __index of the types with named fields: components by name first, then methods from upvalue 1
+	 */
+	template <int N>
+	int vecIndex (lua_State *L);
+
+	int methodIndex (lua_State *L) {
+		lua_pushvalue(L, 2);
+		lua_rawget(L, lua_upvalueindex(1));
+		return 1;
+	}
+
+	//////////////////// vec2 and vec3 ////////////////////
+
+	template <int N>
+	const char *vecMetatable ();
+	template <>
+	const char *vecMetatable<2> () { return VEC2_METATABLE; }
+	template <>
+	const char *vecMetatable<3> () { return VEC3_METATABLE; }
+
+	template <int N>
+	Vec<N> *pushVec (lua_State *L) {
+		return newUserdata<Vec<N>>(L, vecMetatable<N>());
+	}
+
+	template <int N>
+	Vec<N> *checkVec (lua_State *L, int idx) {
+		return (Vec<N> *) luaL_checkudata(L, idx, vecMetatable<N>());
+	}
+
+	template <int N>
+	int vecNew (lua_State *L) {
+		Vec<N> *r = pushVec<N>(L);
+		for (int i = 0; i < N; i++) {
+			r->v[i] = luaL_optnumber(L, i + 1, 0);
+		}
+		return 1;
+	}
+
+	template <int N>
+	int vecAdd (lua_State *L) {
+		Vec<N> *a = checkVec<N>(L, 1), *b = checkVec<N>(L, 2);
+		Vec<N> *r = pushVec<N>(L);
+		for (int i = 0; i < N; i++) {
+			r->v[i] = a->v[i] + b->v[i];
+		}
+		return 1;
+	}
+
+	template <int N>
+	int vecSub (lua_State *L) {
+		Vec<N> *a = checkVec<N>(L, 1), *b = checkVec<N>(L, 2);
+		Vec<N> *r = pushVec<N>(L);
+		for (int i = 0; i < N; i++) {
+			r->v[i] = a->v[i] - b->v[i];
+		}
+		return 1;
+	}
+
+	/* v * v is component-wise, v * n and n * v scale */
+	template <int N>
+	int vecMul (lua_State *L) {
+		if (lua_type(L, 1) == LUA_TNUMBER) {
+			// Moves the vector below the number
+			lua_insert(L, 1);
+		}
+		Vec<N> *a = checkVec<N>(L, 1);
+		if (lua_type(L, 2) == LUA_TNUMBER) {
+			lua_Number s = lua_tonumber(L, 2);
+			Vec<N> *r = pushVec<N>(L);
+			for (int i = 0; i < N; i++) {
+				r->v[i] = a->v[i] * s;
+			}
+			return 1;
+		}
+		Vec<N> *b = checkVec<N>(L, 2);
+		Vec<N> *r = pushVec<N>(L);
+		for (int i = 0; i < N; i++) {
+			r->v[i] = a->v[i] * b->v[i];
+		}
+		return 1;
+	}
+
+	template <int N>
+	int vecDiv (lua_State *L) {
+		Vec<N> *a = checkVec<N>(L, 1);
+		if (lua_type(L, 2) == LUA_TNUMBER) {
+			lua_Number s = lua_tonumber(L, 2);
+			Vec<N> *r = pushVec<N>(L);
+			for (int i = 0; i < N; i++) {
+				r->v[i] = a->v[i] / s;
+			}
+			return 1;
+		}
+		Vec<N> *b = checkVec<N>(L, 2);
+		Vec<N> *r = pushVec<N>(L);
+		for (int i = 0; i < N; i++) {
+			r->v[i] = a->v[i] / b->v[i];
+		}
+		return 1;
+	}
+
+	template <int N>
+	int vecUnm (lua_State *L) {
+		Vec<N> *a = checkVec<N>(L, 1);
+		Vec<N> *r = pushVec<N>(L);
+		for (int i = 0; i < N; i++) {
+			r->v[i] = -a->v[i];
+		}
+		return 1;
+	}
+
+	/* __eq runs for any two userdata, so a value of another type is unequal instead of an error */
+	template <int N>
+	int vecEq (lua_State *L) {
+		Vec<N> *a = (Vec<N> *) luaL_testudata(L, 1, vecMetatable<N>());
+		Vec<N> *b = (Vec<N> *) luaL_testudata(L, 2, vecMetatable<N>());
+		bool eq = a != NULL && b != NULL;
+		for (int i = 0; eq && i < N; i++) {
+			eq = eq && a->v[i] == b->v[i];
+		}
+		lua_pushboolean(L, eq);
+		return 1;
+	}
+
+	template <int N>
+	lua_Number vecDot (const Vec<N> *a, const Vec<N> *b) {
+		lua_Number d = 0;
+		for (int i = 0; i < N; i++) {
+			d += a->v[i] * b->v[i];
+		}
+		return d;
+	}
+
+	template <int N>
+	int vecToString (lua_State *L) {
+		Vec<N> *a = checkVec<N>(L, 1);
+		if (N == 2) {
+			lua_pushfstring(L, "(%f, %f)", a->v[0], a->v[1]);
+		} else {
+			lua_pushfstring(L, "(%f, %f, %f)", a->v[0], a->v[1], a->v[N - 1]);
+		}
+		return 1;
+	}
+
+	template <int N>
+	int vecIndex (lua_State *L) {
+		Vec<N> *a = checkVec<N>(L, 1);
+		if (lua_type(L, 2) == LUA_TSTRING) {
+			int i = componentIndex(L, 2, N == 2 ? "xy" : COMPONENT_NAMES);
+			if (i >= 0) {
+				lua_pushnumber(L, a->v[i]);
+				return 1;
+			}
+		}
+		return methodIndex(L);
+	}
+
+	template <int N>
+	int vecNewIndex (lua_State *L) {
+		Vec<N> *a = checkVec<N>(L, 1);
+		int i = lua_type(L, 2) == LUA_TSTRING ? componentIndex(L, 2, N == 2 ? "xy" : COMPONENT_NAMES) : -1;
+		luaL_argcheck(L, i >= 0, 2, "invalid component");
+		a->v[i] = luaL_checknumber(L, 3);
+		return 0;
+	}
+
+	template <int N>
+	int vecLength (lua_State *L) {
+		Vec<N> *a = checkVec<N>(L, 1);
+		lua_pushnumber(L, std::sqrt(vecDot(a, a)));
+		return 1;
+	}
+
+	template <int N>
+	int vecLengthSquared (lua_State *L) {
+		Vec<N> *a = checkVec<N>(L, 1);
+		lua_pushnumber(L, vecDot(a, a));
+		return 1;
+	}
+
+	/* Like Godot, normalizing a zero vector returns a zero vector */
+	template <int N>
+	int vecNormalized (lua_State *L) {
+		Vec<N> *a = checkVec<N>(L, 1);
+		lua_Number len = std::sqrt(vecDot(a, a));
+		Vec<N> *r = pushVec<N>(L);
+		for (int i = 0; i < N; i++) {
+			r->v[i] = len == 0 ? 0 : a->v[i] / len;
+		}
+		return 1;
+	}
+
+	template <int N>
+	int vecDotMethod (lua_State *L) {
+		lua_pushnumber(L, vecDot(checkVec<N>(L, 1), checkVec<N>(L, 2)));
+		return 1;
+	}
+
+	template <int N>
+	int vecDistanceTo (lua_State *L) {
+		Vec<N> *a = checkVec<N>(L, 1), *b = checkVec<N>(L, 2);
+		lua_Number d = 0;
+		for (int i = 0; i < N; i++) {
+			d += (a->v[i] - b->v[i]) * (a->v[i] - b->v[i]);
+		}
+		lua_pushnumber(L, std::sqrt(d));
+		return 1;
+	}
+
+	template <int N>
+	int vecLerp (lua_State *L) {
+		Vec<N> *a = checkVec<N>(L, 1), *b = checkVec<N>(L, 2);
+		lua_Number t = luaL_checknumber(L, 3);
+		Vec<N> *r = pushVec<N>(L);
+		for (int i = 0; i < N; i++) {
+			r->v[i] = a->v[i] + (b->v[i] - a->v[i]) * t;
+		}
+		return 1;
+	}
+
+	template <int N>
+	int vecUnpack (lua_State *L) {
+		Vec<N> *a = checkVec<N>(L, 1);
+		for (int i = 0; i < N; i++) {
+			lua_pushnumber(L, a->v[i]);
+		}
+		return N;
+	}
+
+	void cross (const lua_Number a[3], const lua_Number b[3], lua_Number r[3]) {
+		lua_Number x = a[1] * b[2] - a[2] * b[1];
+		lua_Number y = a[2] * b[0] - a[0] * b[2];
+		lua_Number z = a[0] * b[1] - a[1] * b[0];
+		r[0] = x;
+		r[1] = y;
+		r[2] = z;
+	}
+
+	int vec3Cross (lua_State *L) {
+		Vec3 *a = checkVec<3>(L, 1), *b = checkVec<3>(L, 2);
+		Vec3 *r = pushVec<3>(L);
+		cross(a->v, b->v, r->v);
+		return 1;
+	}
+
+	template <int N>
+	void fillVecMetatable (lua_State *L) {
+		const luaL_Reg methods[] = {
+			{ "length", vecLength<N> },
+			{ "length_squared", vecLengthSquared<N> },
+			{ "normalized", vecNormalized<N> },
+			{ "dot", vecDotMethod<N> },
+			{ "distance_to", vecDistanceTo<N> },
+			{ "lerp", vecLerp<N> },
+			{ "unpack", vecUnpack<N> },
+			{ "cross", N == 3 ? vec3Cross : nullptr },
+			{ nullptr, nullptr }
+		};
+		const luaL_Reg metamethods[] = {
+			{ "__add", vecAdd<N> },
+			{ "__sub", vecSub<N> },
+			{ "__mul", vecMul<N> },
+			{ "__div", vecDiv<N> },
+			{ "__unm", vecUnm<N> },
+			{ "__eq", vecEq<N> },
+			{ "__tostring", vecToString<N> },
+			{ "__newindex", vecNewIndex<N> },
+			{ nullptr, nullptr }
+		};
+		luaL_setfuncs(L, metamethods, 0);
+		lua_newtable(L);
+		// luaL_setfuncs would stop at cross for vec2
+		for (const luaL_Reg *m = methods; m->name; m++) {
+			if (m->func) {
+				lua_pushcfunction(L, m->func);
+				lua_setfield(L, -2, m->name);
+			}
+		}
+		lua_pushcclosure(L, vecIndex<N>, 1);
+		lua_setfield(L, -2, "__index");
+	}
+
+	//////////////////// quat ////////////////////
+
+	Quat *checkQuat (lua_State *L, int idx) {
+		return (Quat *) luaL_checkudata(L, idx, QUAT_METATABLE);
+	}
+
+	Quat quatMul (const Quat &a, const Quat &b) {
+		return Quat {
+			a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+			a.w * b.y + a.y * b.w + a.z * b.x - a.x * b.z,
+			a.w * b.z + a.z * b.w + a.x * b.y - a.y * b.x,
+			a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z
+		};
+	}
+
+	void quatXform (const Quat &q, const lua_Number v[3], lua_Number r[3]) {
+		// v + w * t + cross(q.xyz, t), where t = 2 * cross(q.xyz, v)
+		const lua_Number u[3] = { q.x, q.y, q.z };
+		lua_Number t[3], c[3];
+		cross(u, v, t);
+		for (int i = 0; i < 3; i++) {
+			t[i] *= 2;
+		}
+		cross(u, t, c);
+		for (int i = 0; i < 3; i++) {
+			r[i] = v[i] + q.w * t[i] + c[i];
+		}
+	}
+
+	void quatToBasis (const Quat &q, lua_Number basis[3][3]) {
+		// Same as Godot's Basis::set_quat
+		lua_Number d = q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w;
+		lua_Number s = 2.0 / d;
+		lua_Number xs = q.x * s, ys = q.y * s, zs = q.z * s;
+		lua_Number wx = q.w * xs, wy = q.w * ys, wz = q.w * zs;
+		lua_Number xx = q.x * xs, xy = q.x * ys, xz = q.x * zs;
+		lua_Number yy = q.y * ys, yz = q.y * zs, zz = q.z * zs;
+		lua_Number b[3][3] = {
+			{ 1.0 - (yy + zz), xy - wz, xz + wy },
+			{ xy + wz, 1.0 - (xx + zz), yz - wx },
+			{ xz - wy, yz + wx, 1.0 - (xx + yy) }
+		};
+		memcpy(basis, b, sizeof(b));
+	}
+
+	int quatNew (lua_State *L) {
+		Vec3 *axis = toVec3(L, 1);
+		if (axis) {
+			// Axis and angle, the axis must be normalized
+			lua_Number half = luaL_checknumber(L, 2) * 0.5;
+			lua_Number s = std::sin(half);
+			pushQuat(L, axis->v[0] * s, axis->v[1] * s, axis->v[2] * s, std::cos(half));
+			return 1;
+		}
+		pushQuat(L, luaL_optnumber(L, 1, 0), luaL_optnumber(L, 2, 0), luaL_optnumber(L, 3, 0), luaL_optnumber(L, 4, 1));
+		return 1;
+	}
+
+	/* q * q composes the rotations, q * v rotates a vec3 */
+	int quatMulMeta (lua_State *L) {
+		Quat *a = checkQuat(L, 1);
+		Vec3 *v = toVec3(L, 2);
+		if (v) {
+			Vec3 *r = pushVec<3>(L);
+			quatXform(*a, v->v, r->v);
+			return 1;
+		}
+		Quat *b = checkQuat(L, 2);
+		*newUserdata<Quat>(L, QUAT_METATABLE) = quatMul(*a, *b);
+		return 1;
+	}
+
+	int quatEq (lua_State *L) {
+		Quat *a = (Quat *) luaL_testudata(L, 1, QUAT_METATABLE), *b = (Quat *) luaL_testudata(L, 2, QUAT_METATABLE);
+		lua_pushboolean(L, a != NULL && b != NULL && a->x == b->x && a->y == b->y && a->z == b->z && a->w == b->w);
+		return 1;
+	}
+
+	int quatToString (lua_State *L) {
+		Quat *q = checkQuat(L, 1);
+		lua_pushfstring(L, "(%f, %f, %f, %f)", q->x, q->y, q->z, q->w);
+		return 1;
+	}
+
+	int quatIndex (lua_State *L) {
+		Quat *q = checkQuat(L, 1);
+		if (lua_type(L, 2) == LUA_TSTRING) {
+			const lua_Number c[4] = { q->x, q->y, q->z, q->w };
+			int i = componentIndex(L, 2, "xyzw");
+			if (i >= 0) {
+				lua_pushnumber(L, c[i]);
+				return 1;
+			}
+		}
+		return methodIndex(L);
+	}
+
+	int quatNewIndex (lua_State *L) {
+		Quat *q = checkQuat(L, 1);
+		int i = lua_type(L, 2) == LUA_TSTRING ? componentIndex(L, 2, "xyzw") : -1;
+		luaL_argcheck(L, i >= 0, 2, "invalid component");
+		lua_Number *c[4] = { &q->x, &q->y, &q->z, &q->w };
+		*c[i] = luaL_checknumber(L, 3);
+		return 0;
+	}
+
+	lua_Number quatDot (const Quat &a, const Quat &b) {
+		return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+	}
+
+	int quatLength (lua_State *L) {
+		Quat *q = checkQuat(L, 1);
+		lua_pushnumber(L, std::sqrt(quatDot(*q, *q)));
+		return 1;
+	}
+
+	int quatNormalized (lua_State *L) {
+		Quat *q = checkQuat(L, 1);
+		lua_Number len = std::sqrt(quatDot(*q, *q));
+		luaL_argcheck(L, len > 0, 1, "zero length quat");
+		pushQuat(L, q->x / len, q->y / len, q->z / len, q->w / len);
+		return 1;
+	}
+
+	/* Of a normalized quat, like Godot's Quat::inverse */
+	int quatInverse (lua_State *L) {
+		Quat *q = checkQuat(L, 1);
+		pushQuat(L, -q->x, -q->y, -q->z, q->w);
+		return 1;
+	}
+
+	int quatDotMethod (lua_State *L) {
+		lua_pushnumber(L, quatDot(*checkQuat(L, 1), *checkQuat(L, 2)));
+		return 1;
+	}
+
+	/* Same algorithm as Godot's Quat::slerp */
+	int quatSlerp (lua_State *L) {
+		Quat *a = checkQuat(L, 1), *b = checkQuat(L, 2);
+		lua_Number t = luaL_checknumber(L, 3);
+		Quat to = *b;
+		lua_Number cosom = quatDot(*a, *b);
+		if (cosom < 0) {
+			cosom = -cosom;
+			to = Quat { -b->x, -b->y, -b->z, -b->w };
+		}
+		lua_Number scale0, scale1;
+		if (1.0 - cosom > 1e-6) {
+			lua_Number omega = std::acos(cosom);
+			lua_Number sinom = std::sin(omega);
+			scale0 = std::sin((1.0 - t) * omega) / sinom;
+			scale1 = std::sin(t * omega) / sinom;
+		} else {
+			// The quats are very close, a linear interpolation is enough
+			scale0 = 1.0 - t;
+			scale1 = t;
+		}
+		pushQuat(L, scale0 * a->x + scale1 * to.x, scale0 * a->y + scale1 * to.y,
+			scale0 * a->z + scale1 * to.z, scale0 * a->w + scale1 * to.w);
+		return 1;
+	}
+
+	int quatXformMethod (lua_State *L) {
+		Quat *q = checkQuat(L, 1);
+		Vec3 *v = checkVec<3>(L, 2);
+		Vec3 *r = pushVec<3>(L);
+		quatXform(*q, v->v, r->v);
+		return 1;
+	}
+
+	void fillQuatMetatable (lua_State *L) {
+		const luaL_Reg methods[] = {
+			{ "length", quatLength },
+			{ "normalized", quatNormalized },
+			{ "inverse", quatInverse },
+			{ "dot", quatDotMethod },
+			{ "slerp", quatSlerp },
+			{ "xform", quatXformMethod },
+			{ nullptr, nullptr }
+		};
+		const luaL_Reg metamethods[] = {
+			{ "__mul", quatMulMeta },
+			{ "__eq", quatEq },
+			{ "__tostring", quatToString },
+			{ "__newindex", quatNewIndex },
+			{ nullptr, nullptr }
+		};
+		luaL_setfuncs(L, metamethods, 0);
+		luaL_newlib(L, methods);
+		lua_pushcclosure(L, quatIndex, 1);
+		lua_setfield(L, -2, "__index");
+	}
+
+	//////////////////// transform ////////////////////
+
+	Transform *checkTransform (lua_State *L, int idx) {
+		return (Transform *) luaL_checkudata(L, idx, TRANSFORM_METATABLE);
+	}
+
+	void transformXform (const Transform &t, const lua_Number v[3], lua_Number r[3]) {
+		lua_Number x = t.basis[0][0] * v[0] + t.basis[0][1] * v[1] + t.basis[0][2] * v[2] + t.origin[0];
+		lua_Number y = t.basis[1][0] * v[0] + t.basis[1][1] * v[1] + t.basis[1][2] * v[2] + t.origin[1];
+		lua_Number z = t.basis[2][0] * v[0] + t.basis[2][1] * v[1] + t.basis[2][2] * v[2] + t.origin[2];
+		r[0] = x;
+		r[1] = y;
+		r[2] = z;
+	}
+
+	Transform transformMul (const Transform &a, const Transform &b) {
+		Transform r;
+		for (int i = 0; i < 3; i++) {
+			for (int j = 0; j < 3; j++) {
+				r.basis[i][j] = a.basis[i][0] * b.basis[0][j] + a.basis[i][1] * b.basis[1][j] + a.basis[i][2] * b.basis[2][j];
+			}
+		}
+		transformXform(a, b.origin, r.origin);
+		return r;
+	}
+
+	Transform identity () {
+		Transform t;
+		memset(&t, 0, sizeof(t));
+		t.basis[0][0] = t.basis[1][1] = t.basis[2][2] = 1;
+		return t;
+	}
+
+	/* transform(), transform(x_axis, y_axis, z_axis, origin) or transform(quat, origin) */
+	int transformNew (lua_State *L) {
+		Transform t = identity();
+		if (lua_gettop(L) == 0) {
+			pushTransform(L, t);
+			return 1;
+		}
+		Quat *q = toQuat(L, 1);
+		if (q) {
+			quatToBasis(*q, t.basis);
+			Vec3 *origin = checkVec<3>(L, 2);
+			memcpy(t.origin, origin->v, sizeof(t.origin));
+			pushTransform(L, t);
+			return 1;
+		}
+		// The axes are the columns of the basis
+		for (int column = 0; column < 3; column++) {
+			Vec3 *axis = checkVec<3>(L, column + 1);
+			for (int row = 0; row < 3; row++) {
+				t.basis[row][column] = axis->v[row];
+			}
+		}
+		Vec3 *origin = checkVec<3>(L, 4);
+		memcpy(t.origin, origin->v, sizeof(t.origin));
+		pushTransform(L, t);
+		return 1;
+	}
+
+	/* t * t composes, t * v transforms a vec3 */
+	int transformMulMeta (lua_State *L) {
+		Transform *a = checkTransform(L, 1);
+		Vec3 *v = toVec3(L, 2);
+		if (v) {
+			Vec3 *r = pushVec<3>(L);
+			transformXform(*a, v->v, r->v);
+			return 1;
+		}
+		pushTransform(L, transformMul(*a, *checkTransform(L, 2)));
+		return 1;
+	}
+
+	int transformEq (lua_State *L) {
+		Transform *a = (Transform *) luaL_testudata(L, 1, TRANSFORM_METATABLE);
+		Transform *b = (Transform *) luaL_testudata(L, 2, TRANSFORM_METATABLE);
+		lua_pushboolean(L, a != NULL && b != NULL && memcmp(a, b, sizeof(Transform)) == 0);
+		return 1;
+	}
+
+	int transformToString (lua_State *L) {
+		Transform *t = checkTransform(L, 1);
+		lua_pushfstring(L, "%f, %f, %f, %f, %f, %f, %f, %f, %f - %f, %f, %f",
+			t->basis[0][0], t->basis[0][1], t->basis[0][2],
+			t->basis[1][0], t->basis[1][1], t->basis[1][2],
+			t->basis[2][0], t->basis[2][1], t->basis[2][2],
+			t->origin[0], t->origin[1], t->origin[2]);
+		return 1;
+	}
+
+	int transformIndex (lua_State *L) {
+		Transform *t = checkTransform(L, 1);
+		if (lua_type(L, 2) == LUA_TSTRING && strcmp(lua_tostring(L, 2), "origin") == 0) {
+			pushVec3(L, t->origin[0], t->origin[1], t->origin[2]);
+			return 1;
+		}
+		return methodIndex(L);
+	}
+
+	int transformNewIndex (lua_State *L) {
+		Transform *t = checkTransform(L, 1);
+		luaL_argcheck(L, lua_type(L, 2) == LUA_TSTRING && strcmp(lua_tostring(L, 2), "origin") == 0, 2, "invalid field");
+		Vec3 *origin = checkVec<3>(L, 3);
+		memcpy(t->origin, origin->v, sizeof(t->origin));
+		return 0;
+	}
+
+	/* Same as Godot's Transform::affine_inverse */
+	int transformInverse (lua_State *L) {
+		Transform *t = checkTransform(L, 1);
+		const lua_Number (*b)[3] = t->basis;
+		lua_Number co[3] = {
+			b[1][1] * b[2][2] - b[1][2] * b[2][1],
+			b[1][2] * b[2][0] - b[1][0] * b[2][2],
+			b[1][0] * b[2][1] - b[1][1] * b[2][0]
+		};
+		lua_Number det = b[0][0] * co[0] + b[0][1] * co[1] + b[0][2] * co[2];
+		luaL_argcheck(L, det != 0, 1, "basis is not invertible");
+		lua_Number s = 1.0 / det;
+		Transform r;
+		lua_Number inv[3][3] = {
+			{ co[0] * s, (b[0][2] * b[2][1] - b[0][1] * b[2][2]) * s, (b[0][1] * b[1][2] - b[0][2] * b[1][1]) * s },
+			{ co[1] * s, (b[0][0] * b[2][2] - b[0][2] * b[2][0]) * s, (b[0][2] * b[1][0] - b[0][0] * b[1][2]) * s },
+			{ co[2] * s, (b[0][1] * b[2][0] - b[0][0] * b[2][1]) * s, (b[0][0] * b[1][1] - b[0][1] * b[1][0]) * s }
+		};
+		memcpy(r.basis, inv, sizeof(inv));
+		memset(r.origin, 0, sizeof(r.origin));
+		lua_Number origin[3];
+		transformXform(r, t->origin, origin);
+		for (int i = 0; i < 3; i++) {
+			r.origin[i] = -origin[i];
+		}
+		pushTransform(L, r);
+		return 1;
+	}
+
+	int transformXformMethod (lua_State *L) {
+		Transform *t = checkTransform(L, 1);
+		Vec3 *v = checkVec<3>(L, 2);
+		Vec3 *r = pushVec<3>(L);
+		transformXform(*t, v->v, r->v);
+		return 1;
+	}
+
+	int transformTranslated (lua_State *L) {
+		Transform r = *checkTransform(L, 1);
+		Vec3 *offset = checkVec<3>(L, 2);
+		for (int i = 0; i < 3; i++) {
+			r.origin[i] += offset->v[i];
+		}
+		pushTransform(L, r);
+		return 1;
+	}
+
+	void fillTransformMetatable (lua_State *L) {
+		const luaL_Reg methods[] = {
+			{ "inverse", transformInverse },
+			{ "xform", transformXformMethod },
+			{ "translated", transformTranslated },
+			{ nullptr, nullptr }
+		};
+		const luaL_Reg metamethods[] = {
+			{ "__mul", transformMulMeta },
+			{ "__eq", transformEq },
+			{ "__tostring", transformToString },
+			{ "__newindex", transformNewIndex },
+			{ nullptr, nullptr }
+		};
+		luaL_setfuncs(L, metamethods, 0);
+		luaL_newlib(L, methods);
+		lua_pushcclosure(L, transformIndex, 1);
+		lua_setfield(L, -2, "__index");
+	}
+
+	//////////////////// vec2_array and vec3_array ////////////////////
+
+	Array *checkArray (lua_State *L, int idx) {
+		return (Array *) luaL_checkudata(L, idx, ARRAY_METATABLE);
+	}
+
+	/* Converts the 1-based Lua index at idx to a 0-based index */
+	size_t checkArrayIndex (lua_State *L, const Array *a, int idx) {
+		lua_Integer i = luaL_checkinteger(L, idx);
+		luaL_argcheck(L, i >= 1 && (size_t) i <= a->size, idx, "index out of range");
+		return (size_t) (i - 1);
+	}
+
+	template <int N>
+	int arrayNew (lua_State *L) {
+		lua_Integer size = luaL_checkinteger(L, 1);
+		luaL_argcheck(L, size >= 0, 1, "negative size");
+		// Larger sizes would wrap the byte count computed by pushArray()
+		const size_t max_size = (SIZE_MAX - sizeof(Array)) / sizeof(float) / N - 2 * ARRAY_ALIGNMENT;
+		luaL_argcheck(L, (lua_Unsigned) size <= max_size, 1, "size too large");
+		pushArray(L, N, (size_t) size);
+		return 1;
+	}
+
+	int arrayLen (lua_State *L) {
+		lua_pushinteger(L, (lua_Integer) checkArray(L, 1)->size);
+		return 1;
+	}
+
+	int arrayIndex (lua_State *L) {
+		Array *a = checkArray(L, 1);
+		if (lua_type(L, 2) != LUA_TNUMBER) {
+			return methodIndex(L);
+		}
+		size_t i = checkArrayIndex(L, a, 2);
+		if (a->dims == 2) {
+			pushVec2(L, a->component[0][i], a->component[1][i]);
+		} else {
+			pushVec3(L, a->component[0][i], a->component[1][i], a->component[2][i]);
+		}
+		return 1;
+	}
+
+	int arrayNewIndex (lua_State *L) {
+		Array *a = checkArray(L, 1);
+		size_t i = checkArrayIndex(L, a, 2);
+		const lua_Number *v = a->dims == 2 ? checkVec<2>(L, 3)->v : checkVec<3>(L, 3)->v;
+		for (int c = 0; c < a->dims; c++) {
+			a->component[c][i] = (float) v[c];
+		}
+		return 0;
+	}
+
+	int arrayToString (lua_State *L) {
+		Array *a = checkArray(L, 1);
+		lua_pushfstring(L, "vec%d_array(%I)", a->dims, (lua_Integer) a->size);
+		return 1;
+	}
+
+	/* positions:integrate(velocities, dt) adds velocities * dt to positions */
+	int arrayIntegrate (lua_State *L) {
+		Array *p = checkArray(L, 1), *v = checkArray(L, 2);
+		float dt = (float) luaL_checknumber(L, 3);
+		luaL_argcheck(L, p->dims == v->dims && p->size == v->size, 2, "arrays of different types or sizes");
+		for (int c = 0; c < p->dims; c++) {
+			integrate(p->component[c], v->component[c], dt, p->size);
+		}
+		lua_settop(L, 1);
+		return 1;
+	}
+
+	int arrayTransform (lua_State *L) {
+		Array *a = checkArray(L, 1);
+		Transform *t = checkTransform(L, 2);
+		luaL_argcheck(L, a->dims == 3, 1, "only vec3_array can be transformed");
+		float m[12];
+		for (int row = 0; row < 3; row++) {
+			for (int column = 0; column < 3; column++) {
+				m[row * 4 + column] = (float) t->basis[row][column];
+			}
+			m[row * 4 + 3] = (float) t->origin[row];
+		}
+		transformPoints(a->component[0], a->component[1], a->component[2], m, a->size);
+		lua_settop(L, 1);
+		return 1;
+	}
+
+	int arrayFill (lua_State *L) {
+		Array *a = checkArray(L, 1);
+		const lua_Number *v = a->dims == 2 ? checkVec<2>(L, 2)->v : checkVec<3>(L, 2)->v;
+		for (int c = 0; c < a->dims; c++) {
+			float value = (float) v[c];
+			float *component = a->component[c];
+			for (size_t i = 0; i < a->size; i++) {
+				component[i] = value;
+			}
+		}
+		lua_settop(L, 1);
+		return 1;
+	}
+
+	void fillArrayMetatable (lua_State *L) {
+		const luaL_Reg methods[] = {
+			{ "integrate", arrayIntegrate },
+			{ "transform", arrayTransform },
+			{ "fill", arrayFill },
+			{ nullptr, nullptr }
+		};
+		const luaL_Reg metamethods[] = {
+			{ "__len", arrayLen },
+			{ "__tostring", arrayToString },
+			{ "__newindex", arrayNewIndex },
+			{ nullptr, nullptr }
+		};
+		luaL_setfuncs(L, metamethods, 0);
+		luaL_newlib(L, methods);
+		lua_pushcclosure(L, arrayIndex, 1);
+		lua_setfield(L, -2, "__index");
+	}
+
+	void createMetatable (lua_State *L, const char *name) {
+		luaL_newmetatable(L, name);
+		if (strcmp(name, VEC2_METATABLE) == 0) {
+			fillVecMetatable<2>(L);
+		} else if (strcmp(name, VEC3_METATABLE) == 0) {
+			fillVecMetatable<3>(L);
+		} else if (strcmp(name, QUAT_METATABLE) == 0) {
+			fillQuatMetatable(L);
+		} else if (strcmp(name, TRANSFORM_METATABLE) == 0) {
+			fillTransformMetatable(L);
+		} else {
+			fillArrayMetatable(L);
+		}
+	}
+
+	template <typename T>
+	T *testUserdata (lua_State *L, int idx, const char *metatable) {
+		return (T *) luaL_testudata(L, idx, metatable);
+	}
+}
+
+Vec2 *pushVec2 (lua_State *L, lua_Number x, lua_Number y) {
+	Vec2 *r = pushVec<2>(L);
+	r->v[0] = x;
+	r->v[1] = y;
+	return r;
+}
+
+Vec3 *pushVec3 (lua_State *L, lua_Number x, lua_Number y, lua_Number z) {
+	Vec3 *r = pushVec<3>(L);
+	r->v[0] = x;
+	r->v[1] = y;
+	r->v[2] = z;
+	return r;
+}
+
+Quat *pushQuat (lua_State *L, lua_Number x, lua_Number y, lua_Number z, lua_Number w) {
+	Quat *r = newUserdata<Quat>(L, QUAT_METATABLE);
+	*r = Quat { x, y, z, w };
+	return r;
+}
+
+Transform *pushTransform (lua_State *L, const Transform &t) {
+	Transform *r = newUserdata<Transform>(L, TRANSFORM_METATABLE);
+	*r = t;
+	return r;
+}
+
+Array *pushArray (lua_State *L, int dims, size_t size) {
+	size_t block = (size + ARRAY_ALIGNMENT - 1) / ARRAY_ALIGNMENT * ARRAY_ALIGNMENT;
+	// Room to align the first block
+	size_t bytes = sizeof(Array) + (dims * block + ARRAY_ALIGNMENT) * sizeof(float);
+	Array *a = (Array *) lua_newuserdata(L, bytes);
+	uintptr_t data = (uintptr_t) (a + 1);
+	const uintptr_t alignment = ARRAY_ALIGNMENT * sizeof(float);
+	data = (data + alignment - 1) / alignment * alignment;
+	a->dims = dims;
+	a->size = size;
+	for (int c = 0; c < 3; c++) {
+		a->component[c] = c < dims ? (float *) data + c * block : nullptr;
+	}
+	memset((void *) data, 0, dims * block * sizeof(float));
+	pushMetatable(L, ARRAY_METATABLE);
+	lua_setmetatable(L, -2);
+	return a;
+}
+
+Vec2 *toVec2 (lua_State *L, int idx) {
+	return testUserdata<Vec2>(L, idx, VEC2_METATABLE);
+}
+
+Vec3 *toVec3 (lua_State *L, int idx) {
+	return testUserdata<Vec3>(L, idx, VEC3_METATABLE);
+}
+
+Quat *toQuat (lua_State *L, int idx) {
+	return testUserdata<Quat>(L, idx, QUAT_METATABLE);
+}
+
+Transform *toTransform (lua_State *L, int idx) {
+	return testUserdata<Transform>(L, idx, TRANSFORM_METATABLE);
+}
+
+Array *toArray (lua_State *L, int idx) {
+	return testUserdata<Array>(L, idx, ARRAY_METATABLE);
+}
+
+void integrate (float *position, const float *velocity, float dt, size_t n) {
+	size_t i = 0;
+#if defined(__AVX__)
+	const __m256 dt8 = _mm256_set1_ps(dt);
+	for (; i + 8 <= n; i += 8) {
+		__m256 p = _mm256_loadu_ps(position + i);
+		__m256 v = _mm256_loadu_ps(velocity + i);
+		_mm256_storeu_ps(position + i, _mm256_add_ps(p, _mm256_mul_ps(v, dt8)));
+	}
+#endif
+#if defined(__SSE__)
+	const __m128 dt4 = _mm_set1_ps(dt);
+	for (; i + 4 <= n; i += 4) {
+		__m128 p = _mm_loadu_ps(position + i);
+		__m128 v = _mm_loadu_ps(velocity + i);
+		_mm_storeu_ps(position + i, _mm_add_ps(p, _mm_mul_ps(v, dt4)));
+	}
+#endif
+	for (; i < n; i++) {
+		position[i] += velocity[i] * dt;
+	}
+}
+
+void transformPoints (float *x, float *y, float *z, const float m[12], size_t n) {
+	size_t i = 0;
+#if defined(__AVX__)
+	__m256 m8[12];
+	for (int k = 0; k < 12; k++) {
+		m8[k] = _mm256_set1_ps(m[k]);
+	}
+	for (; i + 8 <= n; i += 8) {
+		__m256 px = _mm256_loadu_ps(x + i);
+		__m256 py = _mm256_loadu_ps(y + i);
+		__m256 pz = _mm256_loadu_ps(z + i);
+		__m256 r[3];
+		for (int row = 0; row < 3; row++) {
+			const __m256 *mr = m8 + row * 4;
+			r[row] = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(mr[0], px), _mm256_mul_ps(mr[1], py)),
+				_mm256_add_ps(_mm256_mul_ps(mr[2], pz), mr[3]));
+		}
+		_mm256_storeu_ps(x + i, r[0]);
+		_mm256_storeu_ps(y + i, r[1]);
+		_mm256_storeu_ps(z + i, r[2]);
+	}
+#endif
+#if defined(__SSE__)
+	__m128 m4[12];
+	for (int k = 0; k < 12; k++) {
+		m4[k] = _mm_set1_ps(m[k]);
+	}
+	for (; i + 4 <= n; i += 4) {
+		__m128 px = _mm_loadu_ps(x + i);
+		__m128 py = _mm_loadu_ps(y + i);
+		__m128 pz = _mm_loadu_ps(z + i);
+		__m128 r[3];
+		for (int row = 0; row < 3; row++) {
+			const __m128 *mr = m4 + row * 4;
+			r[row] = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(mr[0], px), _mm_mul_ps(mr[1], py)),
+				_mm_add_ps(_mm_mul_ps(mr[2], pz), mr[3]));
+		}
+		_mm_storeu_ps(x + i, r[0]);
+		_mm_storeu_ps(y + i, r[1]);
+		_mm_storeu_ps(z + i, r[2]);
+	}
+#endif
+	for (; i < n; i++) {
+		float px = x[i], py = y[i], pz = z[i];
+		x[i] = m[0] * px + m[1] * py + m[2] * pz + m[3];
+		y[i] = m[4] * px + m[5] * py + m[6] * pz + m[7];
+		z[i] = m[8] * px + m[9] * py + m[10] * pz + m[11];
+	}
+}
+
+}
+
+std::shared_ptr<Registry::LuaLibrary> newVectorMathLibrary () {
+	auto lib = std::make_shared<Registry::LuaLibrary>("vmath");
+	lib->AddCFunction("vec2", VectorMath::vecNew<2>);
+	lib->AddCFunction("vec3", VectorMath::vecNew<3>);
+	lib->AddCFunction("quat", VectorMath::quatNew);
+	lib->AddCFunction("transform", VectorMath::transformNew);
+	lib->AddCFunction("vec2_array", VectorMath::arrayNew<2>);
+	lib->AddCFunction("vec3_array", VectorMath::arrayNew<3>);
+	return lib;
+}
+
+}
@@ -0,0 +1,125 @@
+/**
+ * @file LuaVectorMath.hpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Native vector math library for the Lua scripts, registered as the global "vmath"
+ * @date 2026-10-18
+ *
+ * @details
+ * Provides vec2, vec3, quat and transform userdata with operator metamethods,
+ * mirroring Godot's Vector2, Vector3, Quat and Transform, and packed arrays of
+ * vectors (vec2_array, vec3_array) with bulk operations implemented by SIMD kernels.
+ *
+ * This file doesn't depend on Godot, so the library can be used by any LuaState.
+ */
+
+#ifndef LUACPP_LUAVECTORMATH_HPP
+#define LUACPP_LUAVECTORMATH_HPP
+
+#include <memory>
+#include <cstddef>
+#include <LuaCpp.hpp>
+
+namespace LuaCpp {
+
+	namespace VectorMath {
+
+		/**
+		 * @brief Names of the metatables, stored in the registry of each LuaState
+		 */
+		extern const char *const VEC2_METATABLE;
+		extern const char *const VEC3_METATABLE;
+		extern const char *const QUAT_METATABLE;
+		extern const char *const TRANSFORM_METATABLE;
+		extern const char *const ARRAY_METATABLE;
+
+		/**
+		 * @brief Userdata of vec2 and vec3. The components are lua_Number, so values don't lose precision when read back by Lua
+		 */
+		template <int N>
+		struct Vec {
+			lua_Number v[N];
+		};
+		using Vec2 = Vec<2>;
+		using Vec3 = Vec<3>;
+
+		/**
+		 * @brief Userdata of quat, with the same layout as Godot's Quat
+		 */
+		struct Quat {
+			lua_Number x, y, z, w;
+		};
+
+		/**
+		 * @brief Userdata of transform, with the same layout as Godot's Transform: the basis rows and the origin
+		 */
+		struct Transform {
+			lua_Number basis[3][3];
+			lua_Number origin[3];
+		};
+
+		/**
+		 * @brief Userdata of vec2_array and vec3_array
+		 *
+		 * @details
+		 * The components are stored as float, like Godot's Pool arrays, in separate
+		 * aligned blocks (structure of arrays): component[0] holds every x, component[1]
+		 * every y... The blocks are contiguous, so the whole array is `dims * size` floats
+		 * starting at component[0], and each block has a multiple of 8 floats.
+		 */
+		struct Array {
+			int dims;
+			size_t size;
+			float *component[3];
+		};
+
+		/**
+		 * @brief Pushes a new userdata onto the stack of L, returning its pointer
+		 */
+		Vec2 *pushVec2 (lua_State *L, lua_Number x, lua_Number y);
+		Vec3 *pushVec3 (lua_State *L, lua_Number x, lua_Number y, lua_Number z);
+		Quat *pushQuat (lua_State *L, lua_Number x, lua_Number y, lua_Number z, lua_Number w);
+		Transform *pushTransform (lua_State *L, const Transform &t);
+		Array *pushArray (lua_State *L, int dims, size_t size);
+
+		/**
+		 * @brief Returns the userdata at idx if it's of the asked type, or nullptr if it isn't
+		 */
+		Vec2 *toVec2 (lua_State *L, int idx);
+		Vec3 *toVec3 (lua_State *L, int idx);
+		Quat *toQuat (lua_State *L, int idx);
+		Transform *toTransform (lua_State *L, int idx);
+		Array *toArray (lua_State *L, int idx);
+
+		/**
+		 * @brief Adds velocity * dt to each position. Both arrays have n floats
+		 */
+		void integrate (float *position, const float *velocity, float dt, size_t n);
+
+		/**
+		 * @brief Transforms n points, in place, by the 3x4 matrix m (the basis rows, each followed by the origin's component)
+		 */
+		void transformPoints (float *x, float *y, float *z, const float m[12], size_t n);
+	}
+
+	/**
+	 * @brief Creates the "vmath" library, to be added to a context with LuaControllerContext::AddLibrary
+	 *
+	 * @details
+	 * Functions of the library:
+	 * - vec2(x, y), vec3(x, y, z): new vectors. Operators + - * / and unary - work with other vectors
+	 *   of the same type, and v * n, n * v and v / n scale. == is false for a value of another type.
+	 *   Fields x, y, z can be read and written.
+	 *   Methods: length, length_squared, normalized, dot, distance_to, lerp, unpack, and cross for vec3.
+	 * - quat(x, y, z, w) or quat(axis, angle): new quaternion. q * q composes, q * v rotates a vec3.
+	 *   Methods: length, normalized, inverse, dot, slerp, xform.
+	 * - transform() is the identity, transform(x_axis, y_axis, z_axis, origin) and transform(quat, origin)
+	 *   build one like Godot's constructors. t * t composes, t * v transforms a vec3.
+	 *   Field origin can be read and written. Methods: inverse (affine), xform, translated.
+	 * - vec2_array(n), vec3_array(n): packed arrays of n zeroed vectors, indexed from 1.
+	 *   #a is the size, a[i] reads a vector, a[i] = v writes it.
+	 *   Methods: integrate(velocities, dt), transform(t) (vec3_array only) and fill(v), all in place.
+	 */
+	std::shared_ptr<Registry::LuaLibrary> newVectorMathLibrary ();
+}
+
+#endif // LUACPP_LUAVECTORMATH_HPP
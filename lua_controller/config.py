@@ -6,6 +6,12 @@ def can_build (env, platform):
 def configure (env):
     pass
 
+def get_opts (platform):
+    from SCons.Variables import BoolVariable
+    return [
+        BoolVariable("lua_callable_profiling", "Count the calls and times of each method called by Lua (get_callable_stats())", False),
+    ]
+
 def get_doc_path ():
     return "doc_classes"
 
@@ -0,0 +1,185 @@
+/**
+ * @file lua_blackboard.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @date 2026-10-18
+ *
+ */
+#include "lua_blackboard.h"
+
+#define FAIL_INVALID_SLOT(slot) ERR_FAIL_COND_MSG(!data->isValid(slot), "Invalid blackboard slot: " + itos(slot))
+#define FAIL_INVALID_SLOT_V(slot, ret) ERR_FAIL_COND_V_MSG(!data->isValid(slot), ret, "Invalid blackboard slot: " + itos(slot))
+
+void LuaBlackboard::_bind_methods () {
+    ClassDB::bind_method(D_METHOD("get_slot", "name"), &LuaBlackboard::get_slot);
+    ClassDB::bind_method(D_METHOD("find_slot", "name"), &LuaBlackboard::find_slot);
+    ClassDB::bind_method(D_METHOD("get_slot_name", "slot"), &LuaBlackboard::get_slot_name);
+    ClassDB::bind_method(D_METHOD("get_slot_count"), &LuaBlackboard::get_slot_count);
+    ClassDB::bind_method(D_METHOD("set_bool", "slot", "value"), &LuaBlackboard::set_bool);
+    ClassDB::bind_method(D_METHOD("get_bool", "slot"), &LuaBlackboard::get_bool);
+    ClassDB::bind_method(D_METHOD("set_int", "slot", "value"), &LuaBlackboard::set_int);
+    ClassDB::bind_method(D_METHOD("get_int", "slot"), &LuaBlackboard::get_int);
+    ClassDB::bind_method(D_METHOD("set_float", "slot", "value"), &LuaBlackboard::set_float);
+    ClassDB::bind_method(D_METHOD("get_float", "slot"), &LuaBlackboard::get_float);
+    ClassDB::bind_method(D_METHOD("set_vector2", "slot", "value"), &LuaBlackboard::set_vector2);
+    ClassDB::bind_method(D_METHOD("get_vector2", "slot"), &LuaBlackboard::get_vector2);
+    ClassDB::bind_method(D_METHOD("set_vector3", "slot", "value"), &LuaBlackboard::set_vector3);
+    ClassDB::bind_method(D_METHOD("get_vector3", "slot"), &LuaBlackboard::get_vector3);
+    ClassDB::bind_method(D_METHOD("set_string", "slot", "value"), &LuaBlackboard::set_string);
+    ClassDB::bind_method(D_METHOD("get_string", "slot"), &LuaBlackboard::get_string);
+    ClassDB::bind_method(D_METHOD("set_value", "name", "value"), &LuaBlackboard::set_value);
+    ClassDB::bind_method(D_METHOD("get_value", "name"), &LuaBlackboard::get_value);
+    ClassDB::bind_method(D_METHOD("clear"), &LuaBlackboard::clear);
+}
+
+int LuaBlackboard::get_slot (const String &name) {
+    return data->Intern(name.utf8().get_data());
+}
+
+int LuaBlackboard::find_slot (const String &name) const {
+    return data->Find(name.utf8().get_data());
+}
+
+String LuaBlackboard::get_slot_name (int slot) const {
+    return String::utf8(data->getName(slot).c_str());
+}
+
+int LuaBlackboard::get_slot_count () const {
+    return (int)data->Size();
+}
+
+void LuaBlackboard::set_bool (int slot, bool value) {
+    FAIL_INVALID_SLOT(slot);
+    data->SetBool(slot, value);
+}
+
+bool LuaBlackboard::get_bool (int slot) const {
+    FAIL_INVALID_SLOT_V(slot, false);
+    return data->getBool(slot);
+}
+
+void LuaBlackboard::set_int (int slot, int64_t value) {
+    FAIL_INVALID_SLOT(slot);
+    data->SetInt(slot, value);
+}
+
+int64_t LuaBlackboard::get_int (int slot) const {
+    FAIL_INVALID_SLOT_V(slot, 0);
+    return data->getInt(slot);
+}
+
+void LuaBlackboard::set_float (int slot, double value) {
+    FAIL_INVALID_SLOT(slot);
+    data->SetFloat(slot, value);
+}
+
+double LuaBlackboard::get_float (int slot) const {
+    FAIL_INVALID_SLOT_V(slot, 0);
+    return data->getFloat(slot);
+}
+
+void LuaBlackboard::set_vector2 (int slot, const Vector2 &value) {
+    FAIL_INVALID_SLOT(slot);
+    data->SetVec2(slot, value.x, value.y);
+}
+
+Vector2 LuaBlackboard::get_vector2 (int slot) const {
+    FAIL_INVALID_SLOT_V(slot, Vector2());
+    const LuaCpp::LuaBlackboard::Slot &s = data->getSlot(slot);
+    if (s.type != LuaCpp::LuaBlackboard::SLOT_VEC2 && s.type != LuaCpp::LuaBlackboard::SLOT_VEC3)
+        return Vector2();
+    return Vector2(s.vec[0], s.vec[1]);
+}
+
+void LuaBlackboard::set_vector3 (int slot, const Vector3 &value) {
+    FAIL_INVALID_SLOT(slot);
+    data->SetVec3(slot, value.x, value.y, value.z);
+}
+
+Vector3 LuaBlackboard::get_vector3 (int slot) const {
+    FAIL_INVALID_SLOT_V(slot, Vector3());
+    const LuaCpp::LuaBlackboard::Slot &s = data->getSlot(slot);
+    if (s.type != LuaCpp::LuaBlackboard::SLOT_VEC2 && s.type != LuaCpp::LuaBlackboard::SLOT_VEC3)
+        return Vector3();
+    return Vector3(s.vec[0], s.vec[1], s.vec[2]);
+}
+
+void LuaBlackboard::set_string (int slot, const String &value) {
+    FAIL_INVALID_SLOT(slot);
+    data->SetString(slot, value.utf8().get_data());
+}
+
+String LuaBlackboard::get_string (int slot) const {
+    FAIL_INVALID_SLOT_V(slot, String());
+    return String::utf8(data->getString(slot).c_str());
+}
+
+void LuaBlackboard::set_value (const String &name, const Variant &value) {
+    int slot = get_slot(name);
+    switch (value.get_type()) {
+        case Variant::NIL:
+            data->SetNil(slot);
+            break;
+        case Variant::BOOL:
+            data->SetBool(slot, value);
+            break;
+        case Variant::INT:
+            data->SetInt(slot, (int64_t)value);
+            break;
+        case Variant::REAL:
+            data->SetFloat(slot, (double)value);
+            break;
+        case Variant::VECTOR2:
+            set_vector2(slot, value);
+            break;
+        case Variant::VECTOR3:
+            set_vector3(slot, value);
+            break;
+        case Variant::STRING:
+            set_string(slot, value);
+            break;
+        default:
+            ERR_FAIL_MSG("A blackboard can't store a " + Variant::get_type_name(value.get_type()));
+    }
+}
+
+Variant LuaBlackboard::get_value (const String &name) const {
+    int slot = find_slot(name);
+    if (slot < 0)
+        return Variant();
+    const LuaCpp::LuaBlackboard::Slot &s = data->getSlot(slot);
+    switch (s.type) {
+        case LuaCpp::LuaBlackboard::SLOT_BOOL:
+            return s.boolean;
+        case LuaCpp::LuaBlackboard::SLOT_INT:
+            return (int64_t)s.integer;
+        case LuaCpp::LuaBlackboard::SLOT_FLOAT:
+            return s.number;
+        case LuaCpp::LuaBlackboard::SLOT_VEC2:
+            return get_vector2(slot);
+        case LuaCpp::LuaBlackboard::SLOT_VEC3:
+            return get_vector3(slot);
+        case LuaCpp::LuaBlackboard::SLOT_STRING:
+            return get_string(slot);
+        default:
+            return Variant();
+    }
+}
+
+void LuaBlackboard::clear () {
+    data->Clear();
+}
+
+const std::shared_ptr<LuaCpp::LuaBlackboard> &LuaBlackboard::get_data () const {
+    return data;
+}
+
+LuaBlackboard::LuaBlackboard () {
+    data = std::make_shared<LuaCpp::LuaBlackboard>();
+}
+
+void LuaBlackboardGlobal::PushValue (LuaCpp::Engine::LuaState &L) {
+    LuaCpp::pushBlackboard(L, data);
+}
+
+void LuaBlackboardGlobal::PopValue (LuaCpp::Engine::LuaState &L, int idx) {
+}
@@ -0,0 +1,105 @@
+/**
+ * @file lua_blackboard.h
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief LuaBlackboard exposes a LuaCpp::LuaBlackboard to GDScript, and to the Lua scripts of LuaControllers
+ * @date 2026-10-18
+ * 
+ * @details
+ * Values are read and written directly in the blackboard's typed slots, so
+ * polling state from Lua costs an index into an array, instead of a LuaCallable
+ * crossing with Variant conversions. GDScript gets a handle once with get_slot(),
+ * then uses the typed accessors. Several controllers can share one blackboard.
+ */
+#ifndef LUA_BLACKBOARD_H
+#define LUA_BLACKBOARD_H
+
+#include "core/reference.h"
+
+#include <memory>
+
+#include <LuaCpp.hpp>
+#include "LuaBlackboard.hpp"
+
+class LuaBlackboard : public Reference {
+    GDCLASS(LuaBlackboard, Reference);
+
+    std::shared_ptr<LuaCpp::LuaBlackboard> data;
+
+protected:
+    /**
+     * @brief Binds a selection of methods and members on Godot's Class Database (ClassDB)
+     */
+    static void _bind_methods ();
+
+public:
+    /**
+     * @brief Returns the handle of name, creating a nil slot the first time. Lua's `blackboard(name)` returns the same handle
+     */
+    int get_slot (const String &name);
+
+    /**
+     * @brief Returns the handle of name, or -1 if it was never used
+     */
+    int find_slot (const String &name) const;
+
+    String get_slot_name (int slot) const;
+    int get_slot_count () const;
+
+    /**
+     * @brief Typed accessors by handle. The getters convert like LuaCpp::LuaBlackboard's
+     */
+    void set_bool (int slot, bool value);
+    bool get_bool (int slot) const;
+    void set_int (int slot, int64_t value);
+    int64_t get_int (int slot) const;
+    void set_float (int slot, double value);
+    double get_float (int slot) const;
+    void set_vector2 (int slot, const Vector2 &value);
+    Vector2 get_vector2 (int slot) const;
+    void set_vector3 (int slot, const Vector3 &value);
+    Vector3 get_vector3 (int slot) const;
+    void set_string (int slot, const String &value);
+    String get_string (int slot) const;
+
+    /**
+     * @brief Sets the slot of name to a null, bool, int, float, Vector2, Vector3 or String
+     */
+    void set_value (const String &name, const Variant &value);
+
+    /**
+     * @brief Returns the value of the slot of name as a Variant, null if it was never used
+     */
+    Variant get_value (const String &name) const;
+
+    /**
+     * @brief Sets every slot to null. The handles stay valid
+     */
+    void clear ();
+
+    /**
+     * @brief The blackboard pushed into the Lua states
+     */
+    const std::shared_ptr<LuaCpp::LuaBlackboard> &get_data () const;
+
+    LuaBlackboard ();
+};
+
+/**
+ * @brief Global variable of a LuaControllerContext that is a blackboard in Lua
+ */
+class LuaBlackboardGlobal : public LuaCpp::LuaMetaObject {
+    std::shared_ptr<LuaCpp::LuaBlackboard> data;
+public:
+    explicit LuaBlackboardGlobal (const std::shared_ptr<LuaCpp::LuaBlackboard> &blackboard) : data(blackboard) {}
+
+    /**
+     * @brief Pushes the blackboard's userdata instead of a LuaMetaObject
+     */
+    void PushValue (LuaCpp::Engine::LuaState &L);
+    /**
+     * @brief Scripts can't replace the blackboard, only its values
+     */
+    void PopValue (LuaCpp::Engine::LuaState &L, int idx);
+};
+
+#endif
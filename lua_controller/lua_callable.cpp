@@ -5,9 +5,22 @@
  * 
  */
 #include "lua_callable.h"
+#include "lua_variant.h"
+#include "LuaTracer.hpp"
+#include "LuaTablePool.hpp"
 #include "core/error_macros.h"
 
+#ifdef LUA_CALLABLE_PROFILING
+#include <chrono>
+#include <algorithm>
+#endif
+
 int LuaCallable::Execute (LuaCpp::Engine::LuaState &L) {
+    LUA_TRACE_SCOPE(trace_name.c_str());
+#ifdef LUA_CALLABLE_PROFILING
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point marshal_start = Clock::now();
+#endif
     Object *obj = ObjectDB::get_instance(object_id);
 
     // This should never be true, because obj should be the owner of this here object
@@ -29,25 +42,8 @@ int LuaCallable::Execute (LuaCpp::Engine::LuaState &L) {
 
     // Instances a Variant for each argument on the stack
     std::vector<Variant> args{};
-    for (int i=2; i<=expected_args_amount+1; i++) {
-        int t = lua_type(L, i);
-        switch (t) {
-        case LUA_TSTRING:
-            args.push_back(lua_tostring(L,i));
-            break;
-        case LUA_TNUMBER:
-            args.push_back(lua_tonumber(L,i));
-            break;
-        case LUA_TBOOLEAN:
-            args.push_back((bool)lua_toboolean(L,i));
-            break;
-        case LUA_TNIL:
-        case LUA_TTABLE: // Ignores table. But they could probably be translated to a Dictionary.
-        default:
-            args.push_back(Variant()); //< Nil value
-            break;
-        }
-    }
+    for (int i=2; i<=expected_args_amount+1; i++)
+        args.push_back(lua_to_variant(L, i));
 
     // Stores the pointer to each argument.
     std::vector<Variant*> p_args;
@@ -55,33 +51,36 @@ int LuaCallable::Execute (LuaCpp::Engine::LuaState &L) {
         p_args.push_back(&arg);
 
     Variant::CallError r_error;
+#ifdef LUA_CALLABLE_PROFILING
+    Clock::time_point call_start = Clock::now();
+#endif
     // The cast (const Variant**) is needed by the overload resolution to find the correct method.
     Variant result = obj->call(info.name, (const Variant**)p_args.data(), p_args.size(), r_error);
+#ifdef LUA_CALLABLE_PROFILING
+    Clock::time_point call_end = Clock::now();
+#endif
     if (r_error.error != Variant::CallError::CALL_OK) {
         String msg = Variant::get_call_error_text(obj, info.name, (const Variant**)p_args.data(), p_args.size(), r_error);
         handler(r_error.error, msg);
     }
 
-    switch (result.get_type())
-    {
-    case Variant::STRING :
-        lua_pushstring(L,((String)result).ascii().get_data());
-        break;
-    case Variant::INT :
-    case Variant::REAL :
-        lua_pushnumber(L, (lua_Number)result);
-        break;
-    case Variant::BOOL :
-        lua_pushboolean(L, result ? 1 : 0);
-        break;
-    case Variant::DICTIONARY : // Could be converted to table, not implemented
-	case Variant::ARRAY :      // Could be converted to table, not implemented
-    case Variant::NIL :        // Same as default behaviour
-    default:
-        lua_pushnil(L);
-        break;
+    if (reuse_tables) {
+        // The arguments are converted already, they may have been the tables of the last result
+        LuaCpp::LuaTablePool::Release(L, this);
+        lua_push_variant_pooled(L, result, this);
+    } else {
+        lua_push_variant(L, result);
     }
 
+#ifdef LUA_CALLABLE_PROFILING
+    uint64_t call_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(call_end - call_start).count();
+    stats.calls++;
+    stats.total_call_nsec += call_nsec;
+    stats.max_call_nsec = std::max(stats.max_call_nsec, call_nsec);
+    stats.total_marshal_nsec += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            (call_start - marshal_start) + (Clock::now() - call_end)).count();
+#endif
+
     // Allways returns a value, even if it is Nil
     return 1;
 }
@@ -90,10 +89,27 @@ String LuaCallable::get_method_name () const {
     return info.name;
 }
 
+const LuaCallableStats &LuaCallable::get_stats () const {
+    return stats;
+}
+
+void LuaCallable::reset_stats () {
+    stats = LuaCallableStats();
+}
+
+void LuaCallable::set_reuse_tables (bool reuse) {
+    reuse_tables = reuse;
+}
+
+bool LuaCallable::get_reuse_tables () const {
+    return reuse_tables;
+}
+
 LuaCallable::LuaCallable(ObjectID id, MethodInfo method, ErrorHandler f)
 : object_id(id)
 , info(method)
 , handler(f)
+, trace_name(std::string("call ") + String(method.name).utf8().get_data())
 {
 }
 
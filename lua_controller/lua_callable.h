@@ -14,6 +14,24 @@
 #include "core/object.h"
 
 #include <functional>
+#include <string>
+#include <cstdint>
+
+/**
+ * @brief Counters of the calls made through a LuaCallable
+ *
+ * Only updated when the module is compiled with LUA_CALLABLE_PROFILING defined, by passing
+ * `lua_callable_profiling=yes` to scons (see SCsub).
+ * Without it, Execute() has no instrumentation at all and the counters stay at zero.
+ */
+struct LuaCallableStats {
+    uint64_t calls = 0;
+    /** Time spent inside the Godot method */
+    uint64_t total_call_nsec = 0;
+    uint64_t max_call_nsec = 0;
+    /** Time spent converting the arguments and the result between Lua and Variant */
+    uint64_t total_marshal_nsec = 0;
+};
 
 class LuaCallable : public LuaCpp::LuaMetaObject {
 private:
@@ -22,6 +40,11 @@ private:
     MethodInfo info;
     using ErrorHandler = std::function<void(Variant::CallError::Error, String)>;
     ErrorHandler handler;
+    LuaCallableStats stats;
+    /** Name of the events of Execute() in LuaTracer's timeline */
+    std::string trace_name;
+    /** Returns Arrays and Dictionaries in tables lent by the state's LuaCpp::LuaTablePool */
+    bool reuse_tables = false;
 public:
     /**
      * @brief Calls the method `info` of the Object represented by `object_id`
@@ -32,6 +55,23 @@ public:
      */
     String get_method_name () const;
 
+    /**
+     * @brief Returns the counters of the calls made through this callable
+     */
+    const LuaCallableStats &get_stats () const;
+    /**
+     * @brief Sets every counter back to zero
+     */
+    void reset_stats ();
+
+    /**
+     * @brief If reuse is true, the tables of the Arrays and Dictionaries returned by the method are reused by its next call
+     *
+     * The script must not use them after calling the method again, unless it passes them to `tables.keep()`.
+     */
+    void set_reuse_tables (bool reuse);
+    bool get_reuse_tables () const;
+
     /**
      * @brief Construct a new Meta Callable object
      * 
@@ -1,37 +1,139 @@
 #include "lua_controller.h"
+#include "LuaVectorMath.hpp"
+#include "LuaChannel.hpp"
+#include "LuaTablePool.hpp"
+#include "lua_module_loader.h"
+#include "lua_file_reader.h"
+#include "lua_variant.h"
+#include "LuaTracer.hpp"
+
+#include "core/message_queue.h"
+#include "core/os/file_access.h"
+#include "core/os/os.h"
+
+#include <cstring>
 
 void LuaController::_bind_methods () {
     ClassDB::bind_method(D_METHOD("set_lua_code", "code"), &LuaController::set_lua_code, DEFVAL(""));
+    ClassDB::bind_method(D_METHOD("set_lua_script", "script"), &LuaController::set_lua_script);
+    ClassDB::bind_method(D_METHOD("get_lua_script"), &LuaController::get_lua_script);
     ClassDB::bind_method(D_METHOD("compile"), &LuaController::compile);
+    ClassDB::bind_method(D_METHOD("compile_file", "path", "name"), &LuaController::compile_file, DEFVAL("default"));
+    ClassDB::bind_method(D_METHOD("compile_async"), &LuaController::compile_async);
+    ClassDB::bind_method(D_METHOD("is_compiling"), &LuaController::is_compiling);
+    ClassDB::bind_method(D_METHOD("_finish_compile_async"), &LuaController::_finish_compile_async);
     ClassDB::bind_method(D_METHOD("prepare_callables"), &LuaController::prepare_callables);
     ClassDB::bind_method(D_METHOD("run"), &LuaController::run);
+    ClassDB::bind_method(D_METHOD("run_with_result"), &LuaController::run_with_result);
+    ClassDB::bind_method(D_METHOD("run_batch", "envs"), &LuaController::run_batch);
+    ClassDB::bind_method(D_METHOD("checkpoint"), &LuaController::checkpoint);
+    ClassDB::bind_method(D_METHOD("restore", "checkpoint"), &LuaController::restore);
+    ClassDB::bind_method(D_METHOD("set_snippet", "name", "code"), &LuaController::set_snippet);
+    ClassDB::bind_method(D_METHOD("run_snippet", "name"), &LuaController::run_snippet);
+    ClassDB::bind_method(D_METHOD("has_snippet", "name"), &LuaController::has_snippet);
+    ClassDB::bind_method(D_METHOD("remove_snippet", "name"), &LuaController::remove_snippet);
+    ClassDB::bind_method(D_METHOD("get_snippet_names"), &LuaController::get_snippet_names);
+    ClassDB::bind_method(D_METHOD("compile_all", "sources"), &LuaController::compile_all);
+    ClassDB::bind_method(D_METHOD("set_blackboard", "blackboard"), &LuaController::set_blackboard);
+    ClassDB::bind_method(D_METHOD("get_blackboard"), &LuaController::get_blackboard);
     ClassDB::bind_method(D_METHOD("clear_error_message"), &LuaController::clear_error_message);
     ClassDB::bind_method(D_METHOD("get_error_message"), &LuaController::get_error_message);
+    ClassDB::bind_method(D_METHOD("set_error_details", "details"), &LuaController::set_error_details);
+    ClassDB::bind_method(D_METHOD("get_error_details"), &LuaController::get_error_details);
+    ClassDB::bind_method(D_METHOD("get_error_source"), &LuaController::get_error_source);
+    ClassDB::bind_method(D_METHOD("get_error_line"), &LuaController::get_error_line);
     ClassDB::bind_method(D_METHOD("set_methods_to_register"), &LuaController::set_methods_to_register);
     ClassDB::bind_method(D_METHOD("get_methods_to_register"), &LuaController::get_methods_to_register);
     ClassDB::bind_method(D_METHOD("set_lua_core_libs", "flags"), &LuaController::set_lua_core_libs);
     ClassDB::bind_method(D_METHOD("get_lua_core_libs"), &LuaController::get_lua_core_libs);
+    ClassDB::bind_method(D_METHOD("set_lua_core_lazy", "lazy"), &LuaController::set_lua_core_lazy);
+    ClassDB::bind_method(D_METHOD("get_lua_core_lazy"), &LuaController::get_lua_core_lazy);
+    ClassDB::bind_method(D_METHOD("set_keep_lua_state", "keep"), &LuaController::set_keep_lua_state);
+    ClassDB::bind_method(D_METHOD("get_keep_lua_state"), &LuaController::get_keep_lua_state);
+    ClassDB::bind_method(D_METHOD("set_reuse_tables", "reuse"), &LuaController::set_reuse_tables);
+    ClassDB::bind_method(D_METHOD("get_reuse_tables"), &LuaController::get_reuse_tables);
+    ClassDB::bind_method(D_METHOD("set_gc_automatic", "automatic"), &LuaController::set_gc_automatic);
+    ClassDB::bind_method(D_METHOD("get_gc_automatic"), &LuaController::get_gc_automatic);
+    ClassDB::bind_method(D_METHOD("set_gc_pause", "pause"), &LuaController::set_gc_pause);
+    ClassDB::bind_method(D_METHOD("get_gc_pause"), &LuaController::get_gc_pause);
+    ClassDB::bind_method(D_METHOD("set_gc_step_multiplier", "multiplier"), &LuaController::set_gc_step_multiplier);
+    ClassDB::bind_method(D_METHOD("get_gc_step_multiplier"), &LuaController::get_gc_step_multiplier);
+    ClassDB::bind_method(D_METHOD("gc_step", "budget_usec"), &LuaController::gc_step);
+    ClassDB::bind_method(D_METHOD("get_lua_stats"), &LuaController::get_lua_stats);
+    ClassDB::bind_method(D_METHOD("get_global_lua_stats"), &LuaController::get_global_lua_stats);
+    ClassDB::bind_method(D_METHOD("clear_module_cache"), &LuaController::clear_module_cache);
+    ClassDB::bind_method(D_METHOD("get_callable_stats"), &LuaController::get_callable_stats);
+    ClassDB::bind_method(D_METHOD("reset_callable_stats"), &LuaController::reset_callable_stats);
+    ClassDB::bind_method(D_METHOD("start_profiling", "sample_period_usec", "hook_instruction_count"), &LuaController::start_profiling, DEFVAL(1000), DEFVAL(1000));
+    ClassDB::bind_method(D_METHOD("stop_profiling"), &LuaController::stop_profiling);
+    ClassDB::bind_method(D_METHOD("is_profiling"), &LuaController::is_profiling);
+    ClassDB::bind_method(D_METHOD("get_profile"), &LuaController::get_profile);
+    ClassDB::bind_method(D_METHOD("save_profile", "path"), &LuaController::save_profile);
+    ClassDB::bind_method(D_METHOD("set_tracing", "enabled"), &LuaController::set_tracing);
+    ClassDB::bind_method(D_METHOD("is_tracing"), &LuaController::is_tracing);
+    ClassDB::bind_method(D_METHOD("get_trace"), &LuaController::get_trace);
+    ClassDB::bind_method(D_METHOD("save_trace", "path"), &LuaController::save_trace);
     
     ClassDB::add_virtual_method(get_class_static(),
         MethodInfo("lua_error_handler",
             PropertyInfo(Variant::INT,"call_error_code",PROPERTY_HINT_ENUM,"CALL_OK,CALL_ERROR_INVALID_METHOD,CALL_ERROR_INVALID_ARGUMENT,CALL_ERROR_TOO_MANY_ARGUMENTS,CALL_ERROR_TOO_FEW_ARGUMENTS,CALL_ERROR_INSTANCE_IS_NULL"),
             PropertyInfo(Variant::STRING, "message")));
+
+    ADD_SIGNAL(MethodInfo("compiled", PropertyInfo(Variant::INT, "error")));
 	
     ADD_PROPERTY(PropertyInfo(Variant::DICTIONARY, "methods_to_register", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_STORAGE),
                 "set_methods_to_register", "get_methods_to_register");
+    ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "lua_script", PROPERTY_HINT_RESOURCE_TYPE, "LuaScript"), "set_lua_script", "get_lua_script");
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "keep_lua_state"), "set_keep_lua_state", "get_keep_lua_state");
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "reuse_tables"), "set_reuse_tables", "get_reuse_tables");
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "error_details"), "set_error_details", "get_error_details");
             
     // Inspired by how Control's size flags are displayed
     ADD_GROUP("Core Libs", "lua_core_");
     ADD_PROPERTY(PropertyInfo(Variant::INT, "lua_core_libraries", PROPERTY_HINT_FLAGS, "base,coroutine,table,io,os,string,utf8,math,debug,package"), "set_lua_core_libs", "get_lua_core_libs");
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "lua_core_lazy"), "set_lua_core_lazy", "get_lua_core_lazy");
+
+    ADD_GROUP("Garbage Collector", "gc_");
+    ADD_PROPERTY(PropertyInfo(Variant::BOOL, "gc_automatic"), "set_gc_automatic", "get_gc_automatic");
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "gc_pause", PROPERTY_HINT_RANGE, "50,1000,1"), "set_gc_pause", "get_gc_pause");
+    ADD_PROPERTY(PropertyInfo(Variant::INT, "gc_step_multiplier", PROPERTY_HINT_RANGE, "40,1000,1"), "set_gc_step_multiplier", "get_gc_step_multiplier");
 }
 
 
 void LuaController::set_lua_code (String code) {
     lua_code = code;
+    lua_code_version++;
+    compilation_succeded = false;
+}
+
+void LuaController::set_lua_script (const Ref<LuaScript> &script) {
+    lua_script = script;
+    // Like a change of lua_code, a compile_async() in progress isn't installed
+    lua_code_version++;
     compilation_succeded = false;
 }
 
+Ref<LuaScript> LuaController::get_lua_script () const {
+    return lua_script;
+}
+
 Error LuaController::compile () { 
+    LUA_TRACE_SCOPE("compile");
+    if (compiling) {
+        error_message = "[LOGIC ERROR] : compile_async() didn't finish";
+        return ERR_BUSY;
+    }
+    if (lua_script.is_valid()) {
+        std::shared_ptr<const LuaCpp::LuaSnippet> snippet = lua_script->get_snippet();
+        if (!snippet) {
+            compilation_succeded = false;
+            error_message = String("[LOGIC ERROR] : ") + lua_script->get_error_message();
+            return ERR_COMPILATION_FAILED;
+        }
+        lua.AddSnippet(snippet);
+        compilation_succeded = true;
+        return OK;
+    }
     /* Attempts compilation of lua_code */
     try {
 	    /* Gets (const char*) from Godot's String type, and forces a recompilation */
@@ -47,11 +149,132 @@ Error LuaController::compile () {
     return OK;
 }
 
+Error LuaController::compile_file (const String &path, const String &name) {
+    LUA_TRACE_SCOPE("compile_file");
+    std::string snippet_name(name.utf8().get_data());
+    if (compiling && snippet_name == "default") {
+        error_message = "[LOGIC ERROR] : compile_async() didn't finish";
+        return ERR_BUSY;
+    }
+    Error err;
+    FileAccessRef file = FileAccess::open(path, FileAccess::READ, &err);
+    if (!file) {
+        error_message = "[LOGIC ERROR] : Can't open " + path;
+        return ERR_FILE_CANT_OPEN;
+    }
+
+    std::unique_ptr<LuaFileReader> reader(new LuaFileReader(file.f));
+    try {
+        lua.CompileReader(snippet_name, lua_file_reader, reader.get(), std::string("@") + path.utf8().get_data());
+    }
+    catch (const std::logic_error& e) {
+        if (snippet_name == "default")
+            compilation_succeded = false;
+        error_message = String("[LOGIC ERROR] : ")+String(e.what());
+        return ERR_COMPILATION_FAILED;
+    }
+    if (snippet_name == "default")
+        compilation_succeded = true;
+    return OK;
+}
+
+Error LuaController::compile_async () {
+    if (compiling)
+        return ERR_BUSY;
+    // The thread of the last compilation already finished, but may not be joined yet
+    if (compile_thread.joinable())
+        compile_thread.join();
+
+    compiling = true;
+    async_code_version = lua_code_version;
+    async_snippet.reset();
+    async_error.clear();
+    ObjectID id = get_instance_id();
+    if (lua_script.is_valid()) {
+        // Loading bytecode doesn't parse, there's nothing to do on a thread
+        async_snippet = lua_script->get_loaded_snippet();
+        if (async_snippet || lua_script->get_source_code().empty()) {
+            if (!async_snippet)
+                async_snippet = lua_script->get_snippet();
+            async_error = lua_script->get_error_message().utf8().get_data();
+            MessageQueue::get_singleton()->push_call(id, "_finish_compile_async");
+            return OK;
+        }
+        // Only has source code, which is parsed on the thread and installed into the script
+        async_script = lua_script;
+        CharString source = lua_script->get_source_code().utf8();
+        std::string code(source.get_data(), source.length());
+        std::string chunk = lua_script->get_chunk_name();
+        LuaScript *script = async_script.ptr();
+        compile_thread = std::thread([this, id, code, chunk, script]() {
+            LUA_TRACE_SCOPE("compile_async");
+            try {
+                async_snippet = script->install_snippet(LuaCpp::LuaSnippetRegistry::CompileBuffer(LuaScript::SNIPPET_NAME, code, chunk));
+            }
+            catch (const std::exception &e) {
+                async_error = e.what();
+            }
+            // The destructor joins this thread, so the object is alive until here
+            MessageQueue::get_singleton()->push_call(id, "_finish_compile_async");
+        });
+        return OK;
+    }
+    std::string code(lua_code.ascii().get_data());
+    compile_thread = std::thread([this, id, code]() {
+        LUA_TRACE_SCOPE("compile_async");
+        try {
+            async_snippet = LuaCpp::LuaSnippetRegistry::CompileString("default", code);
+        }
+        catch (const std::exception &e) {
+            async_error = e.what();
+        }
+        // The destructor joins this thread, so the object is alive until here
+        MessageQueue::get_singleton()->push_call(id, "_finish_compile_async");
+    });
+    return OK;
+}
+
+bool LuaController::is_compiling () const {
+    return compiling;
+}
+
+void LuaController::_finish_compile_async () {
+    ERR_FAIL_COND(!compiling);
+    if (compile_thread.joinable())
+        compile_thread.join();
+    compiling = false;
+
+    Error err = OK;
+    if (async_code_version != lua_code_version) {
+        err = ERR_INVALID_DATA;
+        error_message = "[LOGIC ERROR] : lua_code changed during the compilation";
+    } else if (!async_snippet) {
+        err = ERR_COMPILATION_FAILED;
+        compilation_succeded = false;
+        error_message = String("[LOGIC ERROR] : ") + String(async_error.c_str());
+    } else {
+        lua.AddSnippet(async_snippet);
+        compilation_succeded = true;
+    }
+    async_snippet.reset();
+    async_script.unref();
+    emit_signal("compiled", err);
+}
+
 
 void LuaController::prepare_callables() {
     List<MethodInfo> method_list; 
 	get_method_list(&method_list);
 
+    // Removes the callables registered by the last call from the context
+    for (const std::string &name : registered_lua_names) {
+        lua.RemoveGlobalVariable(name);
+    }
+    registered_lua_names.clear();
+    // A new callable may reuse the address of an old one, and with it the tables lent to it
+    for (const auto &callable : callables) {
+        lua.ReleaseTables(callable.get());
+    }
     callables.clear();
 
     // If there are no methods to register, then the work is done
@@ -74,32 +297,248 @@ void LuaController::prepare_callables() {
                 )
             );
  	}
+
+    // Adds every LuaCallable in the context as a variable named after it's value in methods_to_register
+    for (auto &callable : callables) {
+        callable->set_reuse_tables(reuse_tables);
+        const Variant &key = callable->get_method_name();
+        std::string name_in_lua(((String)methods_to_register.get_valid(key)).ascii().get_data());
+        lua.AddGlobalVariable(name_in_lua, callable);
+        registered_lua_names.push_back(name_in_lua);
+    }
 }
 
 Error LuaController::run () {
+    if (compiling) {
+        error_message = "[RUNTIME ERROR] : compile_async() didn't finish";
+        return ERR_BUSY;
+    }
     if (!compilation_succeded) {
         error_message = "[RUNTIME ERROR] : No valid compiled code to execute";
         return ERR_INVALID_DATA;
     }
-    
-    // Adds every LuaCallable from callables in the context as a variable named after name_in_lua
-    for (auto &callable : callables) {
-        const Variant &key = callable->get_method_name();
-        const char *name_in_lua = ((String)methods_to_register.get_valid(key)).ascii().get_data();
-        lua.AddGlobalVariable(name_in_lua , callable);
+
+    return report_run_status(lua.RunChecked("default"));
+}
+
+Error LuaController::report_run_status (LuaCpp::RunStatus status) {
+    if (status == LuaCpp::RUN_OK)
+        return OK;
+
+    error_message = describe_run_error();
+    return status == LuaCpp::RUN_ERROR_MEMORY ? ERR_OUT_OF_MEMORY : ERR_SCRIPT_FAILED;
+}
+
+String LuaController::describe_run_error () const {
+    const LuaCpp::LuaRunError &error = lua.getLastError();
+    // The traceback starts with the message
+    const std::string &description = error.traceback.empty() ? error.message : error.traceback;
+    return String("[RUNTIME ERROR] : ")+String(description.c_str());
+}
+
+Array LuaController::run_with_result () {
+    Array results;
+    error_message = "";
+    if (compiling) {
+        error_message = "[RUNTIME ERROR] : compile_async() didn't finish";
+        return results;
+    }
+    if (!compilation_succeded) {
+        error_message = "[RUNTIME ERROR] : No valid compiled code to execute";
+        return results;
     }
 
+    LuaCpp::RunStatus status = lua.RunWithResultsChecked("default", [&results](lua_State *L, int nresults) {
+        results.resize(nresults);
+        int first = lua_gettop(L) - nresults + 1;
+        for (int i = 0; i < nresults; i++)
+            results[i] = lua_to_variant(L, first + i);
+    });
+    if (status != LuaCpp::RUN_OK) {
+        // Same description as run(), with the traceback if error_details is true
+        error_message = describe_run_error();
+        results.clear();
+    }
+
+    return results;
+}
+
+Array LuaController::run_batch (const Array &envs) {
+    Array results;
+    error_message = "";
+    if (compiling) {
+        error_message = "[RUNTIME ERROR] : compile_async() didn't finish";
+        return results;
+    }
+    if (!compilation_succeded) {
+        error_message = "[RUNTIME ERROR] : No valid compiled code to execute";
+        return results;
+    }
+
+    results.resize(envs.size());
+    LuaCpp::RunStatus status = lua.RunBatch("default", envs.size(),
+        [&envs](lua_State *L, size_t index) {
+            if (envs[index].get_type() != Variant::DICTIONARY)
+                return;
+            Dictionary env = envs[index];
+            for (const Variant *key = env.next(); key; key = env.next(key)) {
+                if (key->get_type() != Variant::STRING)
+                    continue;
+                lua_pushstring(L, String(*key).utf8().get_data());
+                lua_push_variant(L, env[*key]);
+                lua_rawset(L, -3);
+            }
+        },
+        [this, &envs, &results](lua_State *L, size_t index, LuaCpp::RunStatus run_status, int env_idx, int nresults) {
+            Dictionary entry;
+            Array values;
+            if (run_status != LuaCpp::RUN_OK) {
+                entry["error"] = describe_run_error();
+                entry["results"] = values;
+                results[index] = entry;
+                return;
+            }
+            values.resize(nresults);
+            int first = lua_gettop(L) - nresults + 1;
+            for (int i = 0; i < nresults; i++)
+                values[i] = lua_to_variant(L, first + i);
+            entry["error"] = "";
+            entry["results"] = values;
+            results[index] = entry;
+
+            if (envs[index].get_type() != Variant::DICTIONARY)
+                return;
+            // Raw, so a variable set to nil isn't looked up in the globals
+            Dictionary env = envs[index];
+            for (const Variant *key = env.next(); key; key = env.next(key)) {
+                if (key->get_type() != Variant::STRING)
+                    continue;
+                lua_pushstring(L, String(*key).utf8().get_data());
+                lua_rawget(L, env_idx);
+                env[*key] = lua_to_variant(L, -1);
+                lua_pop(L, 1);
+            }
+        });
+
+    if (status != LuaCpp::RUN_OK) {
+        error_message = describe_run_error();
+        results.clear();
+    }
+    return results;
+}
+
+PoolByteArray LuaController::checkpoint () {
+    PoolByteArray result;
+    error_message = "";
+    std::string checkpoint;
     try {
-	    lua.Run("default");
-	}
+        checkpoint = lua.Checkpoint();
+    }
     catch (std::runtime_error& e) {
         error_message = String("[RUNTIME ERROR] : ")+String(e.what());
-        return ERR_SCRIPT_FAILED;
+        return result;
     }
 
+    result.resize(checkpoint.size());
+    PoolByteArray::Write w = result.write();
+    memcpy(w.ptr(), checkpoint.data(), checkpoint.size());
+    return result;
+}
+
+Error LuaController::restore (const PoolByteArray &checkpoint) {
+    error_message = "";
+    std::string blob;
+    if (checkpoint.size() > 0) {
+        PoolByteArray::Read r = checkpoint.read();
+        blob.assign((const char *)r.ptr(), checkpoint.size());
+    }
+    try {
+        lua.Restore(blob);
+    }
+    catch (std::runtime_error& e) {
+        error_message = String("[RUNTIME ERROR] : ")+String(e.what());
+        return ERR_INVALID_DATA;
+    }
     return OK;
 }
 
+Error LuaController::set_snippet (const String &name, const String &code) {
+    std::string snippet_name(name.utf8().get_data());
+    try {
+        lua.CompileString(snippet_name, code.ascii().get_data(), true);
+    }
+    catch (const std::logic_error& e) {
+        if (snippet_name == "default")
+            compilation_succeded = false;
+        error_message = String("[LOGIC ERROR] : ")+String(e.what());
+        return ERR_COMPILATION_FAILED;
+    }
+    if (snippet_name == "default")
+        compilation_succeded = true;
+    return OK;
+}
+
+Error LuaController::run_snippet (const String &name) {
+    std::string snippet_name(name.utf8().get_data());
+    if (!lua.getSnippet(snippet_name)) {
+        error_message = "[RUNTIME ERROR] : No snippet named " + name;
+        return ERR_DOES_NOT_EXIST;
+    }
+
+    return report_run_status(lua.RunChecked(snippet_name));
+}
+
+bool LuaController::has_snippet (const String &name) const {
+    return lua.getSnippet(name.utf8().get_data()) != nullptr;
+}
+
+void LuaController::remove_snippet (const String &name) {
+    std::string snippet_name(name.utf8().get_data());
+    lua.RemoveSnippet(snippet_name);
+    if (snippet_name == "default")
+        compilation_succeded = false;
+}
+
+PoolStringArray LuaController::get_snippet_names () const {
+    PoolStringArray names;
+    for (const std::string &name : lua.getSnippetNames())
+        names.push_back(String::utf8(name.c_str()));
+    return names;
+}
+
+Dictionary LuaController::compile_all (const Dictionary &sources) {
+    std::vector<std::pair<std::string, std::string>> batch;
+    batch.reserve(sources.size());
+    Array keys = sources.keys();
+    for (int i = 0; i < keys.size(); i++) {
+        String name = keys[i];
+        String code = sources[keys[i]];
+        batch.emplace_back(name.utf8().get_data(), code.ascii().get_data());
+    }
+
+    std::map<std::string, std::string> failures = lua.CompileAll(batch);
+
+    Dictionary errors;
+    for (const auto &failure : failures)
+        errors[String::utf8(failure.first.c_str())] = String("[LOGIC ERROR] : ") + String(failure.second.c_str());
+    if (sources.has("default"))
+        compilation_succeded = !errors.has("default");
+    return errors;
+}
+
+void LuaController::set_blackboard (const Ref<LuaBlackboard> &p_blackboard) {
+    blackboard = p_blackboard;
+    if (blackboard.is_null()) {
+        lua.RemoveGlobalVariable("blackboard");
+        return;
+    }
+    lua.AddGlobalVariable("blackboard", std::make_shared<LuaBlackboardGlobal>(blackboard->get_data()));
+}
+
+Ref<LuaBlackboard> LuaController::get_blackboard () const {
+    return blackboard;
+}
+
 void LuaController::clear_error_message () {
     error_message = "";
 }
@@ -108,6 +547,22 @@ String LuaController::get_error_message () {
     return error_message;
 }
 
+void LuaController::set_error_details (bool details) {
+    lua.setErrorDetails(details);
+}
+
+bool LuaController::get_error_details () const {
+    return lua.getErrorDetails();
+}
+
+String LuaController::get_error_source () const {
+    return String(lua.getLastError().source);
+}
+
+int LuaController::get_error_line () const {
+    return lua.getLastError().line;
+}
+
 void LuaController::set_methods_to_register (const Dictionary& methods) {
     Array keys = methods.keys();
     // Checks if every key and value is of type STRING
@@ -138,18 +593,204 @@ int LuaController::get_lua_core_libs () const {
     return lua_core_libraries;
 }
 
+void LuaController::set_lua_core_lazy (bool lazy) {
+    lua_core_lazy = lazy;
+    lua.setLazyCoreLibraries(lua_core_lazy);
+}
+
+bool LuaController::get_lua_core_lazy () const {
+    return lua_core_lazy;
+}
+
+void LuaController::set_keep_lua_state (bool keep) {
+    keep_lua_state = keep;
+    lua.setKeepState(keep_lua_state);
+}
+
+bool LuaController::get_keep_lua_state () const {
+    return keep_lua_state;
+}
+
+void LuaController::set_reuse_tables (bool reuse) {
+    reuse_tables = reuse;
+    for (auto &callable : callables)
+        callable->set_reuse_tables(reuse_tables);
+}
+
+bool LuaController::get_reuse_tables () const {
+    return reuse_tables;
+}
+
+void LuaController::set_gc_automatic (bool automatic) {
+    gc_automatic = automatic;
+    lua.setGCAutomatic(gc_automatic);
+}
+
+bool LuaController::get_gc_automatic () const {
+    return gc_automatic;
+}
+
+void LuaController::set_gc_pause (int pause) {
+    gc_pause = pause;
+    lua.setGCPause(gc_pause);
+}
+
+int LuaController::get_gc_pause () const {
+    return gc_pause;
+}
+
+void LuaController::set_gc_step_multiplier (int multiplier) {
+    gc_step_multiplier = multiplier;
+    lua.setGCStepMultiplier(gc_step_multiplier);
+}
+
+int LuaController::get_gc_step_multiplier () const {
+    return gc_step_multiplier;
+}
+
+bool LuaController::gc_step (int budget_usec) {
+    ERR_FAIL_COND_V(budget_usec < 0, false);
+    return lua.StepGC(budget_usec);
+}
+
+Dictionary LuaController::get_lua_stats () {
+    const LuaCpp::LuaMemoryStats &stats = lua.getMemoryStats();
+    Dictionary dict;
+    dict["current_bytes"] = stats.current_bytes;
+    dict["peak_bytes"] = stats.peak_bytes;
+    dict["allocations"] = stats.allocations;
+    dict["run_allocations"] = stats.run_allocations;
+    dict["run_bytes_allocated"] = stats.run_bytes_allocated;
+    dict["gc_cycles"] = stats.gc_cycles;
+    dict["gc_time_usec"] = stats.gc_time_usec;
+    dict["lua_state_bytes"] = lua.getRunStateBytes();
+    return dict;
+}
+
+Dictionary LuaController::get_global_lua_stats () const {
+    const LuaCpp::LuaGlobalMemoryStats &stats = LuaCpp::getGlobalMemoryStats();
+    Dictionary dict;
+    dict["current_bytes"] = stats.current_bytes.load();
+    dict["peak_bytes"] = stats.peak_bytes.load();
+    dict["allocations"] = stats.allocations.load();
+    dict["gc_cycles"] = stats.gc_cycles.load();
+    dict["gc_time_usec"] = stats.gc_time_usec.load();
+    dict["controllers"] = stats.contexts.load();
+    return dict;
+}
+
+void LuaController::clear_module_cache () {
+    lua_clear_module_cache();
+}
+
+Dictionary LuaController::get_callable_stats () const {
+    Dictionary dict;
+#ifdef LUA_CALLABLE_PROFILING
+    for (const auto &callable : callables) {
+        const LuaCallableStats &stats = callable->get_stats();
+        Dictionary method;
+        method["calls"] = stats.calls;
+        method["total_usec"] = stats.total_call_nsec / 1000.0;
+        method["max_usec"] = stats.max_call_nsec / 1000.0;
+        method["marshal_usec"] = stats.total_marshal_nsec / 1000.0;
+        dict[callable->get_method_name()] = method;
+    }
+#endif
+    return dict;
+}
+
+void LuaController::reset_callable_stats () {
+    for (auto &callable : callables)
+        callable->reset_stats();
+}
+
+void LuaController::start_profiling (int sample_period_usec, int hook_instruction_count) {
+    ERR_FAIL_COND(sample_period_usec <= 0);
+    ERR_FAIL_COND(hook_instruction_count <= 0);
+    lua.StartProfiler(sample_period_usec, hook_instruction_count);
+}
+
+void LuaController::stop_profiling () {
+    lua.StopProfiler();
+}
+
+bool LuaController::is_profiling () const {
+    return lua.isProfiling();
+}
+
+String LuaController::get_profile () const {
+    const LuaCpp::LuaSamplingProfiler *profiler = lua.getProfiler();
+    if (!profiler)
+        return "";
+    return String::utf8(profiler->getFoldedStacks().c_str());
+}
+
+Error LuaController::save_profile (const String &path) const {
+    Error err;
+    FileAccessRef file = FileAccess::open(path, FileAccess::WRITE, &err);
+    ERR_FAIL_COND_V_MSG(!file, err, "Can't open the file to save the profile: " + path);
+    file->store_string(get_profile());
+    file->close();
+    return OK;
+}
+
+void LuaController::set_tracing (bool enabled) {
+    LuaCpp::LuaTracer::setEnabled(enabled);
+}
+
+bool LuaController::is_tracing () const {
+    return LuaCpp::LuaTracer::isEnabled();
+}
+
+String LuaController::get_trace () const {
+    int64_t offset_usec = (int64_t) OS::get_singleton()->get_ticks_usec() - LuaCpp::LuaTracer::nowUsec();
+    return String::utf8(LuaCpp::LuaTracer::FlushChromeJson(offset_usec).c_str());
+}
+
+Error LuaController::save_trace (const String &path) const {
+    Error err;
+    FileAccessRef file = FileAccess::open(path, FileAccess::WRITE, &err);
+    ERR_FAIL_COND_V_MSG(!file, err, "Can't open the file to save the trace: " + path);
+    file->store_string(get_trace());
+    file->close();
+    return OK;
+}
+
 LuaController::LuaController () {
     // This follows Godot's code convention, which didn't use initializer list
     lua_code = "";
-    lua = LuaCpp::LuaControllerContext();
+    // lua is default constructed: the context owns a LuaState, so it can't be copy-assigned
     compilation_succeded = false;
     error_message = "";
+    reuse_tables = false;
     prepare_callables();
     methods_to_register = Dictionary();
     lua_core_libraries = LuaCpp::LIB_ALL;
+    lua_core_lazy = false;
+    keep_lua_state = false;
+    gc_automatic = true;
+    gc_pause = LuaCpp::GC_DEFAULT_PAUSE;
+    gc_step_multiplier = LuaCpp::GC_DEFAULT_STEP_MULTIPLIER;
+    compiling = false;
+    lua_code_version = 0;
+    async_code_version = 0;
+
+    // Every script can use the native vector math library
+    std::shared_ptr<LuaCpp::Registry::LuaLibrary> vmath = LuaCpp::newVectorMathLibrary();
+    lua.AddLibrary(vmath);
+    // Controllers exchange messages through the channels opened by name
+    std::shared_ptr<LuaCpp::Registry::LuaLibrary> channels = LuaCpp::newChannelLibrary();
+    lua.AddLibrary(channels);
+    // tables.keep() marks the tables a script keeps, when reuse_tables is on
+    std::shared_ptr<LuaCpp::Registry::LuaLibrary> tables = LuaCpp::newTablePoolLibrary();
+    lua.AddLibrary(tables);
+    // require() finds modules in res://, through package.respath
+    lua.AddPackageSearcher(lua_res_searcher);
     
     connect("script_changed", this, "prepare_callables");
 }
 
 LuaController::~LuaController() {
+    if (compile_thread.joinable())
+        compile_thread.join();
 }
\ No newline at end of file
@@ -19,11 +19,15 @@
 #include "core/ustring.h" /* To use Godot's String class */
 
 #include <memory>
+#include <string>
+#include <thread>
 #include <vector>
 
 #include <LuaCpp.hpp>
 #include "LuaControllerContext.hpp"
 #include "lua_callable.h"
+#include "lua_blackboard.h"
+#include "lua_script.h"
 
 class LuaController : public Node {
 	GDCLASS(LuaController, Node);
@@ -40,6 +44,11 @@ class LuaController : public Node {
      */
     LuaCpp::LuaControllerContext lua;
 
+    /**
+     * @brief If not null, compile() installs its snippet instead of compiling lua_code
+     */
+    Ref<LuaScript> lua_script;
+
     /**
      * @brief run() checks if this flag is true before trying to execute code
      */
@@ -53,16 +62,21 @@ class LuaController : public Node {
     /**
      * @brief Vector of objects invokable inside Lua
      * 
-     * run() adds each of these LuaCallables in the LuaState before execution.
+     * prepare_callables() registers each of these LuaCallables as a global variable of the context.
      * When invoked by the Lua script execution, a LuaCallable calls it's respective method from a Godot Object.
      */
     std::vector<std::shared_ptr<LuaCallable>> callables; 
 
+    /**
+     * @brief Names under which prepare_callables() registered the callables in the LuaControllerContext
+     */
+    std::vector<std::string> registered_lua_names;
+
     /**
      * @brief Dictionary of pairs {"method to register" : "name to register as"}
      * 
      * Each `key` from methods_to_register is the name of a method from this Object.
-     * run() uses each value from methods_to_register to name the variable that represents the method `key` in the LuaControllerContext
+     * prepare_callables() uses each value from methods_to_register to name the variable that represents the method `key` in the LuaControllerContext
      */
     Dictionary methods_to_register;
 
@@ -71,6 +85,80 @@ class LuaController : public Node {
      */
     int lua_core_libraries;
 
+    /**
+     * @brief If true, the core Lua libraries are only opened when a script first uses them
+     */
+    bool lua_core_lazy;
+
+    /**
+     * @brief If true, variables written by the Lua code are kept between calls of run()
+     */
+    bool keep_lua_state;
+
+    /**
+     * @brief If true, the tables returned by the registered methods are reused by their next calls
+     */
+    bool reuse_tables;
+
+    /**
+     * @brief If false, the garbage collector only works when gc_step() is called
+     */
+    bool gc_automatic;
+
+    /**
+     * @brief The garbage collector's pause, forwarded to the LuaControllerContext
+     */
+    int gc_pause;
+
+    /**
+     * @brief The garbage collector's step multiplier, forwarded to the LuaControllerContext
+     */
+    int gc_step_multiplier;
+
+    /**
+     * @brief Blackboard registered as the global variable "blackboard" of the context, if not null
+     */
+    Ref<LuaBlackboard> blackboard;
+
+    /**
+     * @brief Worker thread of compile_async(). Joined by _finish_compile_async() or by the destructor
+     */
+    std::thread compile_thread;
+
+    /**
+     * @brief True from compile_async() until its result is installed by _finish_compile_async()
+     */
+    bool compiling;
+
+    /**
+     * @brief Incremented by set_lua_code(), so a compilation of an older lua_code isn't installed
+     */
+    uint64_t lua_code_version;
+
+    /**
+     * @brief Results of the worker thread, only read after joining it
+     */
+    uint64_t async_code_version;
+    std::shared_ptr<const LuaCpp::LuaSnippet> async_snippet;
+    std::string async_error;
+    /**
+     * @brief lua_script whose source is compiled by the worker thread. Kept alive, and released
+     * on the main thread, by _finish_compile_async()
+     */
+    Ref<LuaScript> async_script;
+
+    /**
+     * @brief Fills error_message from the context's last error, if status is a failure
+     * 
+     * @return OK, ERR_OUT_OF_MEMORY, or ERR_SCRIPT_FAILED for any other failure
+     */
+    Error report_run_status (LuaCpp::RunStatus status);
+
+    /**
+     * @brief Returns the context's last error, prefixed with "[RUNTIME ERROR] : ", with its traceback if there's one
+     */
+    String describe_run_error () const;
+
 protected:
     
     /**
@@ -88,7 +176,17 @@ public:
     void set_lua_code (String code);
 
     /**
-     * @brief Compiles the stored String as Lua code.
+     * @brief Set the lua_script member. A null script returns to lua_code
+     * 
+     * Every controller that uses the same LuaScript shares its compiled snippet, so
+     * compile() only installs it, without parsing anything, once the script was
+     * compiled or imported. compile() must be called again, like after set_lua_code().
+     */
+    void set_lua_script (const Ref<LuaScript> &script);
+    Ref<LuaScript> get_lua_script () const;
+
+    /**
+     * @brief Compiles the stored String as Lua code, or installs the snippet of lua_script if it's set
      * 
      * As a side-effect, compiles the code into the lua member. Any previous compiled code is lost.
      * 
@@ -106,10 +204,51 @@ public:
      */
     Error compile ();
 
+    /**
+     * @brief Compiles the Lua file at path and registers it as the snippet `name`
+     * 
+     * The file is streamed from FileAccess into the parser a block at a time, so the
+     * extra memory doesn't depend on the size of the file. Error messages name the
+     * chunk "@path". Compiling into "default" replaces the code run by run().
+     * 
+     * @return OK if successfully compiled;
+     * @return ERR_FILE_CANT_OPEN if the file couldn't be opened;
+     * @return ERR_COMPILATION_FAILED if compilation failed, with the reason in error_message, prefixed with "[LOGIC ERROR] : "
+     */
+    Error compile_file (const String &path, const String &name = "default");
+
+    /**
+     * @brief Compiles the stored String on a worker thread, and emits `compiled(error)` when done
+     * 
+     * The code is parsed in a separate state, so the context can keep running the previous
+     * snippet until then. The new snippet is installed, and the signal emitted, on the main
+     * thread, when the MessageQueue is flushed. The error has the same meaning as compile()'s,
+     * or is ERR_INVALID_DATA if lua_code changed before the compilation finished.
+     * 
+     * A lua_script whose snippet is built, or whose bytecode loads, is installed without a
+     * thread. Otherwise its source code is compiled on the worker thread, and the snippet
+     * is installed into the script too, so the other controllers using it don't parse it.
+     * 
+     * @return OK if the compilation started;
+     * @return ERR_BUSY if a compilation is already in progress
+     */
+    Error compile_async ();
+
+    /**
+     * @brief Returns true while a compilation started by compile_async() isn't installed
+     */
+    bool is_compiling () const;
+
+    /**
+     * @brief Installs the result of compile_async(). Called through the MessageQueue
+     */
+    void _finish_compile_async ();
+
     /**
      * @brief Prepares a LuaCallable for each method from methods_to_register
      * 
-     * For each method in methods_to_register, instances a LuaCallable and stores it in member callables. 
+     * For each method in methods_to_register, instances a LuaCallable, stores it in member callables
+     * and registers it as a global variable of the LuaControllerContext.
      * prepare_callables is connected to this object's "script_changed" signal.
      * prepare_callables needs to be called by the user if the object's methods have been changed.
      */
@@ -119,22 +258,135 @@ public:
      * 
      * @brief Executes the compiled Lua code
      * 
-     * Every element from member callables is placed in the LuaControllerContext.
+     * The elements from member callables were already placed in the LuaControllerContext by prepare_callables().
      * 
      * @return OK if the script ran successfully;
      * @return ERR_SCRIPT_FAILED if a runtime_error occured during the execution;
+     * @return ERR_OUT_OF_MEMORY if Lua ran out of memory
      * @return \todo [TODO] ERR_TIMEOUT if the execution took to long to conclude
      * @return ERR_INVALID_DATA if `compilation_succeded` is false
+     * @return ERR_BUSY if compile_async() didn't finish, the code isn't run
      * 
      * @post 
-     * If ERR_INVALID_DATA was returned, error_message contains the description 
+     * If ERR_INVALID_DATA or ERR_BUSY was returned, error_message contains the description 
      * of the error, prefixed with the string "[RUNTIME ERROR] : "
      * @post 
-     * If ERR_SCRIPT_FAILED was returned, error_message contains the description 
-     * of the error, prefixed with the string "[RUNTIME ERROR] : "
+     * If ERR_SCRIPT_FAILED or ERR_OUT_OF_MEMORY was returned, error_message contains the description 
+     * of the error, prefixed with the string "[RUNTIME ERROR] : ", and followed by the
+     * traceback if error_details is true
      */
     Error run ();
 
+    /**
+     * @brief Executes the compiled Lua code, like run(), and returns the values returned by its chunk
+     * 
+     * The values are converted straight off the Lua stack with lua_to_variant(), so a script
+     * can `return` its results instead of calling a registered setter for each of them.
+     * Tables become Arrays or Dictionaries.
+     * 
+     * @return The returned values, in order. Empty if the script returned nothing, or failed:
+     * error_message is cleared first, so it tells both cases apart. A failure is described
+     * like in run(), and sets get_error_source() and get_error_line() if error_details is true.
+     */
+    Array run_with_result ();
+
+    /**
+     * @brief Executes the compiled Lua code once per entry of envs, each with its own variables
+     * 
+     * Each entry is a Dictionary whose String keys become variables of that run only, on
+     * top of the registered methods and the libraries. The code is loaded once and run in
+     * the same state, so each entity costs about one protected call. After a successful run,
+     * the values of the entry's keys are read back into it, so the Dictionary is updated
+     * in place. keep_lua_state doesn't apply: the runs don't see each other's variables.
+     * 
+     * @return An Array with a Dictionary per entry: "results", the values returned by the
+     * code, like run_with_result(), and "error", "" or the error of that run prefixed with
+     * "[RUNTIME ERROR] : ". The Array is empty if the code couldn't run at all, with the
+     * reason in error_message, which is cleared first.
+     */
+    Array run_batch (const Array &envs);
+
+    /**
+     * @brief Saves the variables kept between runs, to restore them later with restore()
+     * 
+     * The variables, and the tables and functions reached from them, are saved to a
+     * compact binary form that keeps shared references, cycles and the upvalues of the
+     * closures. The registered methods and the libraries are saved by name. Needs
+     * keep_lua_state.
+     * 
+     * @return The checkpoint, empty if it failed, with the reason in error_message,
+     * prefixed with "[RUNTIME ERROR] : ". error_message is cleared first
+     */
+    PoolByteArray checkpoint ();
+
+    /**
+     * @brief Replaces the variables kept between runs with the ones saved by checkpoint()
+     * 
+     * No Lua code is run, so it's a quick way to reset a level or roll back a simulation
+     * to the state left by its setup code. The checkpoint can come from another controller
+     * that registers the same methods. Needs keep_lua_state.
+     *
+     * Only restore checkpoints made by checkpoint(), from a trusted place: the closures are
+     * saved as Lua bytecode, which Lua loads without verifying it, so a crafted checkpoint can
+     * crash the game or run arbitrary code. A checksum rejects the truncated or corrupted ones.
+     * 
+     * @return ERR_INVALID_DATA if the checkpoint can't be restored, the variables are unchanged
+     * and error_message has the reason, prefixed with "[RUNTIME ERROR] : "
+     */
+    Error restore (const PoolByteArray &checkpoint);
+
+    /**
+     * @brief Compiles code and registers it as the snippet `name`, replacing the previous one
+     * 
+     * The snippet "default" is the one compiled from lua_code, and run by run().
+     * 
+     * @return OK if successfully compiled;
+     * @return ERR_COMPILATION_FAILED if it failed, error_message has the reason, prefixed with "[LOGIC ERROR] : "
+     */
+    Error set_snippet (const String &name, const String &code);
+
+    /**
+     * @brief Executes the snippet `name`, in the same context and with the same callables as run()
+     * 
+     * @return OK if the script ran successfully;
+     * @return ERR_DOES_NOT_EXIST if there is no snippet with that name;
+     * @return ERR_SCRIPT_FAILED if a runtime_error occured during the execution;
+     * 
+     * @post 
+     * If an error was returned, error_message contains the description
+     * of the error, prefixed with the string "[RUNTIME ERROR] : "
+     */
+    Error run_snippet (const String &name);
+
+    bool has_snippet (const String &name) const;
+
+    /**
+     * @brief Removes the snippet `name`. Removing "default" makes run() fail until the next compile()
+     */
+    void remove_snippet (const String &name);
+
+    /**
+     * @brief Returns the names of the registered snippets, in alphabetical order
+     */
+    PoolStringArray get_snippet_names () const;
+
+    /**
+     * @brief Compiles the pairs {name : code} of sources in parallel, on every core, and registers the snippets that compiled
+     * 
+     * Blocks until all of them are done. Meant for loading time, when there are hundreds of snippets.
+     * 
+     * @return Dictionary {name : error message} of the snippets that failed, empty if all of them compiled
+     */
+    Dictionary compile_all (const Dictionary &sources);
+
+    /**
+     * @brief Sets the blackboard seen by the Lua code as the global "blackboard". Null removes it
+     * 
+     * The same blackboard can be given to many controllers, and written by GDScript between runs.
+     */
+    void set_blackboard (const Ref<LuaBlackboard> &p_blackboard);
+    Ref<LuaBlackboard> get_blackboard () const;
+
     /**
      * @brief Clears error_message.
      * 
@@ -146,6 +398,26 @@ public:
      */
     String get_error_message ();
 
+    /**
+     * @brief If true, the failed runs also capture the source, line and traceback of the error
+     * 
+     * Off by default: the stack is only walked, and the traceback built, when they're wanted.
+     */
+    void set_error_details (bool details);
+    bool get_error_details () const;
+
+    /**
+     * @brief Location of the error of the last failed run, if error_details was true
+     * 
+     * @return The chunk of the innermost Lua function, or "" if there's no location
+     */
+    String get_error_source () const;
+
+    /**
+     * @return The line of the error in get_error_source(), or -1 if there's no location
+     */
+    int get_error_line () const;
+
     /**
      * @brief Getter and Setter methods for methods_to_register
      */
@@ -158,6 +430,131 @@ public:
     void set_lua_core_libs (int flags);
     int get_lua_core_libs () const;
 
+    /**
+     * @brief Getter and Setter methods for lua_core_lazy
+     */
+    void set_lua_core_lazy (bool lazy);
+    bool get_lua_core_lazy () const;
+
+    /**
+     * @brief Getter and Setter methods for keep_lua_state
+     */
+    void set_keep_lua_state (bool keep);
+    bool get_keep_lua_state () const;
+
+    /**
+     * @brief Getter and Setter methods for reuse_tables
+     *
+     * When true, an Array or Dictionary returned by a registered method is converted into
+     * tables of the state's LuaCpp::LuaTablePool, which are cleared and reused when the same
+     * method is called again, so calling it every frame makes no garbage. A script that keeps
+     * the result longer passes it to `tables.keep()`.
+     */
+    void set_reuse_tables (bool reuse);
+    bool get_reuse_tables () const;
+
+    /**
+     * @brief Getter and Setter methods for the garbage collector's tuning
+     */
+    void set_gc_automatic (bool automatic);
+    bool get_gc_automatic () const;
+    void set_gc_pause (int pause);
+    int get_gc_pause () const;
+    void set_gc_step_multiplier (int multiplier);
+    int get_gc_step_multiplier () const;
+
+    /**
+     * @brief Does incremental garbage collection work within a time budget
+     * 
+     * Meant to be called at a point of the frame that has time to spare, usually
+     * with gc_automatic set to false. Only has effect if run() was called at least once.
+     * 
+     * @param budget_usec Time budget, in microseconds
+     * @return true if a collection cycle was finished
+     */
+    bool gc_step (int budget_usec);
+
+    /**
+     * @brief Returns the memory and garbage collector statistics of this controller's Lua states
+     * 
+     * @return Dictionary with the keys "current_bytes", "peak_bytes", "allocations", "run_allocations",
+     * "run_bytes_allocated", "gc_cycles", "gc_time_usec" and "lua_state_bytes".
+     * "lua_state_bytes" is Lua's own count (`lua_gc(LUA_GCCOUNT)`) for the state used by run(), or 0 before the first run.
+     */
+    Dictionary get_lua_stats ();
+
+    /**
+     * @brief Returns the statistics summed over every LuaController
+     * 
+     * @return Dictionary with the keys "current_bytes", "peak_bytes", "allocations",
+     * "gc_cycles", "gc_time_usec" and "controllers".
+     */
+    Dictionary get_global_lua_stats () const;
+
+    /**
+     * @brief Clears the bytecode cache of the modules loaded by `require` from res:// paths
+     * 
+     * The cache is shared by every LuaController. The next `require` of each module reads its file again.
+     */
+    void clear_module_cache ();
+
+    /**
+     * @brief Returns the counters of each registered method called by the Lua code
+     * 
+     * @return Dictionary with the name of each method as key, and as value a Dictionary with the keys
+     * "calls", "total_usec", "max_usec" and "marshal_usec" ("marshal_usec" is the time converting
+     * arguments and results). The counters restart when the callables are prepared again.
+     * Empty unless the module was compiled with `lua_callable_profiling=yes`, which defines LUA_CALLABLE_PROFILING.
+     */
+    Dictionary get_callable_stats () const;
+
+    /**
+     * @brief Sets the counters of every callable back to zero
+     */
+    void reset_callable_stats ();
+
+    /**
+     * @brief Starts sampling the Lua call stacks of run(), discarding the previous samples
+     * 
+     * A hook checks the clock every `hook_instruction_count` Lua instructions, and samples the stack
+     * if `sample_period_usec` passed since the last sample. With the defaults, the overhead is about
+     * 1 to 2% of the script's time, see LuaSamplingProfiler for details.
+     */
+    void start_profiling (int sample_period_usec = 1000, int hook_instruction_count = 1000);
+    void stop_profiling ();
+    bool is_profiling () const;
+
+    /**
+     * @brief Returns the samples as folded stacks, the input of flame graph tools like flamegraph.pl
+     */
+    String get_profile () const;
+
+    /**
+     * @brief Writes get_profile() to the file at path
+     */
+    Error save_profile (const String &path) const;
+
+    /**
+     * @brief Starts or stops recording the timeline of compile(), state creation, runs, callables
+     * and GC steps, of every LuaController and on every thread (the tracer is shared)
+     *
+     * Has no effect if the module was compiled without LUA_TRACING.
+     */
+    void set_tracing (bool enabled);
+    bool is_tracing () const;
+
+    /**
+     * @brief Returns the events recorded since the last call as Chrome trace-event JSON, and discards them
+     *
+     * The timestamps are in the clock of OS.get_ticks_usec(), so they line up with the frame timing.
+     */
+    String get_trace () const;
+
+    /**
+     * @brief Writes get_trace() to the file at path
+     */
+    Error save_trace (const String &path) const;
+
     /**
      * @brief Construct a new LuaController object
      */
@@ -0,0 +1,163 @@
+/**
+ * @file lua_controller_benchmark.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @date 2026-10-18
+ * 
+ */
+#include "lua_controller_benchmark.h"
+
+#include "core/io/json.h"
+#include "core/os/file_access.h"
+#include "core/os/os.h"
+
+#include <vector>
+
+#include <LuaCpp.hpp>
+#include "LuaBenchmark.hpp"
+#include "LuaControllerContext.hpp"
+#include "lua_callable.h"
+
+using LuaCpp::Benchmark::Result;
+using LuaCpp::Benchmark::Measure;
+
+void LuaControllerBenchmark::_bind_methods () {
+    ClassDB::bind_method(D_METHOD("_args0"), &LuaControllerBenchmark::_args0);
+    ClassDB::bind_method(D_METHOD("_args1"), &LuaControllerBenchmark::_args1);
+    ClassDB::bind_method(D_METHOD("_args2"), &LuaControllerBenchmark::_args2);
+    ClassDB::bind_method(D_METHOD("_args3"), &LuaControllerBenchmark::_args3);
+    ClassDB::bind_method(D_METHOD("_args4"), &LuaControllerBenchmark::_args4);
+    ClassDB::bind_method(D_METHOD("_args5"), &LuaControllerBenchmark::_args5);
+    ClassDB::bind_method(D_METHOD("run_benchmarks", "iterations"), &LuaControllerBenchmark::run_benchmarks, DEFVAL(1000));
+    ClassDB::bind_method(D_METHOD("get_results"), &LuaControllerBenchmark::get_results);
+    ClassDB::bind_method(D_METHOD("save_results", "path"), &LuaControllerBenchmark::save_results);
+}
+
+Variant LuaControllerBenchmark::_args0 () { return Variant(); }
+Variant LuaControllerBenchmark::_args1 (Variant a) { return Variant(); }
+Variant LuaControllerBenchmark::_args2 (Variant a, Variant b) { return Variant(); }
+Variant LuaControllerBenchmark::_args3 (Variant a, Variant b, Variant c) { return Variant(); }
+Variant LuaControllerBenchmark::_args4 (Variant a, Variant b, Variant c, Variant d) { return Variant(); }
+Variant LuaControllerBenchmark::_args5 (Variant a, Variant b, Variant c, Variant d, Variant e) { return Variant(); }
+
+namespace {
+    Dictionary build_info (int iterations) {
+        Dictionary build;
+#ifdef DEBUG_ENABLED
+        build["debug"] = true;
+#else
+        build["debug"] = false;
+#endif
+#ifdef TOOLS_ENABLED
+        build["tools"] = true;
+#else
+        build["tools"] = false;
+#endif
+#ifdef LUA_CALLABLE_PROFILING
+        build["callable_profiling"] = true;
+#else
+        build["callable_profiling"] = false;
+#endif
+#if defined(__AVX__)
+        build["simd"] = "avx";
+#elif defined(__SSE__)
+        build["simd"] = "sse";
+#else
+        build["simd"] = "scalar";
+#endif
+        build["iterations"] = iterations;
+        build["unix_time"] = OS::get_singleton()->get_unix_time();
+        return build;
+    }
+}
+
+Dictionary LuaControllerBenchmark::run_benchmarks (int iterations) {
+    ERR_FAIL_COND_V(iterations <= 0, Dictionary());
+    std::vector<Result> measured;
+
+    // Creating and closing states, with different core libraries
+    struct StateCase {
+        const char *name;
+        int flags;
+        bool lazy;
+    };
+    const StateCase state_cases[] = {
+        { "new_state/none", LuaCpp::LIB_NONE, false },
+        { "new_state/base", LuaCpp::LIB_BASE, false },
+        { "new_state/base_string_table_math", LuaCpp::LIB_BASE | LuaCpp::LIB_STRING | LuaCpp::LIB_TABLE | LuaCpp::LIB_MATH, false },
+        { "new_state/all", LuaCpp::LIB_ALL, false },
+        { "new_state/all_lazy", LuaCpp::LIB_ALL, true },
+    };
+    for (const StateCase &state_case : state_cases) {
+        LuaCpp::LuaControllerContext ctx;
+        ctx.setLuaCoreLibraries(state_case.flags);
+        ctx.setLazyCoreLibraries(state_case.lazy);
+        measured.push_back(Measure(state_case.name, iterations, [&]() { ctx.newState(); }));
+    }
+
+    // Compilation of scripts of different sizes
+    for (int lines : { 10, 100, 1000 }) {
+        LuaCpp::LuaControllerContext ctx;
+        std::string script = LuaCpp::Benchmark::GenerateScript(lines);
+        measured.push_back(Measure("compile_string/" + std::to_string(lines) + "_lines", iterations,
+                [&]() { ctx.CompileString("benchmark", script, true); }));
+    }
+
+    // Running a trivial chunk on the kept run state
+    {
+        LuaCpp::LuaControllerContext ctx;
+        ctx.CompileString("default", "local x = 1");
+        measured.push_back(Measure("run/trivial", iterations, [&]() { ctx.Run("default"); }));
+    }
+
+    // Crossing from Lua to Godot with 0 to 5 arguments
+    List<MethodInfo> method_list;
+    get_method_list(&method_list);
+    for (int args = 0; args <= 5; args++) {
+        String method_name = "_args" + itos(args);
+        MethodInfo info;
+        for (List<MethodInfo>::Element *E = method_list.front(); E; E = E->next()) {
+            if (E->get().name == method_name)
+                info = E->get();
+        }
+        LuaCallable callable(get_instance_id(), info, [](Variant::CallError::Error err, String msg){});
+        LuaCpp::Engine::LuaState L;
+        measured.push_back(Measure("callable_execute/" + std::to_string(args) + "_args", iterations, [&]() {
+            lua_settop(L, 0);
+            // Execute() ignores the first value, the callable itself when called by Lua
+            lua_pushnil(L);
+            for (int i = 0; i < args; i++)
+                lua_pushnumber(L, i);
+            callable.Execute(L);
+        }));
+    }
+
+    Dictionary result_dict;
+    for (const Result &result : measured) {
+        Dictionary entry;
+        entry["iterations"] = (int64_t)result.iterations;
+        entry["median_usec"] = result.median_usec;
+        entry["p99_usec"] = result.p99_usec;
+        entry["ops_per_sec"] = result.ops_per_sec;
+        result_dict[String(result.name.c_str())] = entry;
+    }
+    results = Dictionary();
+    results["build"] = build_info(iterations);
+    results["results"] = result_dict;
+    return results;
+}
+
+Dictionary LuaControllerBenchmark::get_results () const {
+    return results;
+}
+
+Error LuaControllerBenchmark::save_results (const String &path) const {
+    Error err;
+    FileAccessRef file = FileAccess::open(path, FileAccess::WRITE, &err);
+    ERR_FAIL_COND_V_MSG(!file, err, "Can't open the file to save the benchmark results: " + path);
+    file->store_string(JSON::print(results, "\t", true));
+    file->close();
+    return OK;
+}
+
+LuaControllerBenchmark::LuaControllerBenchmark () {}
+LuaControllerBenchmark::~LuaControllerBenchmark () {}
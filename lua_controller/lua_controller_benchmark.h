@@ -0,0 +1,67 @@
+/**
+ * @file lua_controller_benchmark.h
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief LuaControllerBenchmark times the hot paths of the LuaController module
+ * @date 2026-10-18
+ * 
+ */
+#ifndef LUA_CONTROLLER_BENCHMARK_H
+#define LUA_CONTROLLER_BENCHMARK_H
+
+#include "scene/main/node.h"
+#include "core/class_db.h"
+
+class LuaControllerBenchmark : public Node {
+    GDCLASS(LuaControllerBenchmark, Node);
+
+    /**
+     * @brief Results of the last call of run_benchmarks()
+     */
+    Dictionary results;
+
+    /**
+     * _args0() to _args5() do nothing, they are the targets of the
+     * benchmarks of LuaCallable::Execute() with 0 to 5 arguments.
+     */
+    Variant _args0 ();
+    Variant _args1 (Variant a);
+    Variant _args2 (Variant a, Variant b);
+    Variant _args3 (Variant a, Variant b, Variant c);
+    Variant _args4 (Variant a, Variant b, Variant c, Variant d);
+    Variant _args5 (Variant a, Variant b, Variant c, Variant d, Variant e);
+
+protected:
+    /**
+     * @brief Binds a selection of methods and members on Godot's Class Database (ClassDB)
+     */
+    static void _bind_methods ();
+
+public:
+    /**
+     * @brief Times each operation `iterations` times
+     * 
+     * The operations are: LuaControllerContext::newState() with different core libraries,
+     * CompileString() of scripts with 10, 100 and 1000 lines, Run() of a trivial chunk, and
+     * LuaCallable::Execute() with 0 to 5 arguments.
+     * 
+     * @return Dictionary with the keys "build", describing how the module was compiled, and
+     * "results". Each key of "results" is an operation, and each value is a Dictionary with
+     * the keys "iterations", "median_usec", "p99_usec" and "ops_per_sec".
+     */
+    Dictionary run_benchmarks (int iterations = 1000);
+
+    /**
+     * @brief Returns the results of the last call of run_benchmarks()
+     */
+    Dictionary get_results () const;
+
+    /**
+     * @brief Saves the results of the last call of run_benchmarks() as JSON
+     */
+    Error save_results (const String &path) const;
+
+    LuaControllerBenchmark ();
+    ~LuaControllerBenchmark ();
+};
+
+#endif
@@ -4,11 +4,22 @@
 #include <stdexcept>
 
 #include "core/array.h"
+#include "core/os/dir_access.h"
+#include "core/os/file_access.h"
+#include "core/project_settings.h"
 
 #include <LuaCpp.hpp>
 #include "lua_callable.h"
 #include "LuaControllerContext.hpp"
+#include "LuaVectorMath.hpp"
 #include "lua_controller.h"
+#include "lua_variant.h"
+#include "lua_pool_view.h"
+#include "lua_module_loader.h"
+#include "lua_blackboard.h"
+#include "lua_script.h"
+#include "LuaChannel.hpp"
+#include "LuaTablePool.hpp"
 
 /**
  * @brief A Suite collects the error messages, stores the name of the suite, and counts the tests
@@ -304,6 +315,112 @@ Array LuaControllerUnitTester::_lua_callable () {
         UNIT_ASSERT( !was_corresponding_error, "ErrorHandler received from Execute() incorrect CALL_ERROR" );
     }
 
+    {
+        NEW_TEST("Test the call counters of Execute()");
+        LuaCallable o(get_instance_id(), methods["_not"],
+            [=](Variant::CallError::Error err, String msg){});
+        LuaCpp::Engine::LuaState L;
+        for (int i = 0; i < 2; i++) {
+            lua_pushstring(L, "Trash string");
+            lua_pushboolean(L, 0);
+            o.Execute(L);
+            lua_settop(L, 0);
+        }
+#ifdef LUA_CALLABLE_PROFILING
+        UNIT_ASSERT( o.get_stats().calls != 2, "The calls weren't counted" );
+        UNIT_ASSERT( o.get_stats().max_call_nsec > o.get_stats().total_call_nsec, "The longest call took more than all calls" );
+#else
+        UNIT_ASSERT( o.get_stats().calls != 0, "The calls were counted with the instrumentation compiled out" );
+#endif
+        o.reset_stats();
+        UNIT_ASSERT( o.get_stats().calls != 0 || o.get_stats().total_call_nsec != 0, "reset_stats() didn't reset the counters" );
+    }
+    {
+        NEW_TEST("Test lua_to_variant() and lua_push_variant() with vmath types");
+        LuaCpp::Engine::LuaState L;
+        Vector3 v3(1, 2, 3);
+        lua_push_variant(L, v3);
+        UNIT_ASSERT( LuaCpp::VectorMath::toVec3(L, -1) == nullptr, "A Vector3 wasn't pushed as a vec3" );
+        UNIT_ASSERT( lua_to_variant(L, -1) != Variant(v3), "A vec3 wasn't converted back to the same Vector3" );
+        Transform t(Basis(Vector3(0, 1, 0), 0.5), Vector3(4, 5, 6));
+        lua_push_variant(L, t);
+        UNIT_ASSERT( !lua_to_variant(L, -1).operator Transform().is_equal_approx(t), "A Transform wasn't converted back to the same Transform" );
+        lua_push_variant(L, Vector2(7, 8));
+        UNIT_ASSERT( lua_to_variant(L, -1) != Variant(Vector2(7, 8)), "A Vector2 wasn't converted back to the same Vector2" );
+        lua_pop(L, 3);
+    }
+    {
+        NEW_TEST("Test the conversion of cycles and shared tables");
+        LuaCpp::Engine::LuaState L;
+        luaL_dostring(L, "local t = {} t[1] = t t[2] = t return t");
+        Variant cycle = lua_to_variant(L, -1);
+        UNIT_ASSERT( cycle.get_type() != Variant::ARRAY || Array(cycle).size() != 2, "A table holding itself wasn't converted" );
+        UNIT_ASSERT( Array(cycle)[0].get_type() != Variant::NIL, "A cycle wasn't converted to nil" );
+        lua_pop(L, 1);
+        // Each level holds the next one twice: 2^40 tables if they were all converted
+        luaL_dostring(L, "local t = {} for i = 1, 40 do t = { t, t } end return t");
+        UNIT_ASSERT( lua_to_variant(L, -1).get_type() != Variant::ARRAY, "The shared tables weren't converted" );
+        lua_pop(L, 1);
+        Dictionary self;
+        self["self"] = self;
+        lua_push_variant(L, self);
+        lua_getfield(L, -1, "self");
+        UNIT_ASSERT( !lua_isnil(L, -1), "A Dictionary holding itself wasn't pushed as nil inside" );
+        lua_pop(L, 2);
+        self.clear();
+    }
+    {
+        NEW_TEST("Test lua_push_variant_pooled() reusing the tables");
+        LuaCpp::Engine::LuaState L;
+        int owner = 0;
+        Dictionary dict;
+        dict["a"] = 1;
+        dict["list"] = Array();
+        lua_push_variant_pooled(L, dict, &owner);
+        const void *first = lua_topointer(L, -1);
+        lua_pop(L, 1);
+        LuaCpp::LuaTablePool::Release(L, &owner);
+        UNIT_ASSERT( LuaCpp::LuaTablePool::FreeCount(L) != 2, "The two tables weren't returned to the free list" );
+
+        Dictionary other;
+        other["b"] = 2;
+        lua_push_variant_pooled(L, other, &owner);
+        UNIT_ASSERT( lua_topointer(L, -1) != first, "The outer table wasn't reused first" );
+        Dictionary reused = lua_to_variant(L, -1);
+        UNIT_ASSERT( reused.size() != 1 || !reused.has("b") || reused.has("a") || reused.has("list"), "The reused table wasn't cleared" );
+        LuaCpp::LuaTablePool::Keep(L, -1);
+        lua_pop(L, 1);
+        LuaCpp::LuaTablePool::Release(L, &owner);
+        UNIT_ASSERT( LuaCpp::LuaTablePool::FreeCount(L) != 1, "A kept table was returned to the free list" );
+    }
+    {
+        NEW_TEST("Test views over Pool arrays");
+        LuaCpp::Engine::LuaState L;
+        LuaCpp::openLibs(L, LuaCpp::LIB_BASE);
+        PoolRealArray reals;
+        for (int i = 1; i <= 4; i++)
+            reals.push_back(i);
+        luaL_loadstring(L,
+            "local v = ... "
+            "assert(#v == 4 and v[2] == 2 and v:type() == 'PoolRealArray') "
+            "local s = v:slice(2, 3) "
+            "assert(#s == 2 and s[1] == 2 and s[2] == 3) "
+            "s[1] = 20 "
+            "assert(v[2] == 20) "
+            "assert(not pcall(function () return v[5] end)) "
+            "return v, s");
+        lua_push_variant(L, reals);
+        bool ran = lua_pcall(L, 1, 2, 0) == LUA_OK;
+        UNIT_ASSERT( !ran, String("The script using the view failed: ") + lua_tostring(L, -1) );
+        if (ran) {
+            PoolRealArray written = lua_to_variant(L, -2);
+            PoolRealArray slice = lua_to_variant(L, -1);
+            UNIT_ASSERT( written.size() != 4 || written[1] != 20, "The write through the view wasn't returned to Godot" );
+            UNIT_ASSERT( slice.size() != 2 || slice[0] != 20, "The slice didn't return only its elements" );
+            UNIT_ASSERT( reals[1] != 2, "The write through the view changed the caller's array instead of copying it" );
+        }
+        lua_settop(L, 0);
+    }
     END_SUITE;
 
 }
@@ -361,7 +478,219 @@ Array LuaControllerUnitTester::_lua_controller_context () {
         UNIT_ASSERT(lua_isnil(L3, -1), "openLibs, when called with LIB_ALL flag, didn't open base library");
         lua_pop(L3, 1);
     }
+    {
+        NEW_TEST("Test LuaCpp::openLibs() with lazy loading");
+        Engine::LuaState L;
+        openLibs(L, LIB_ALL, true);
+        lua_pushglobaltable(L);
+        lua_getfield(L, -1, "print");
+        UNIT_ASSERT( lua_isnil(L, -1), "The base library wasn't opened eagerly" );
+        lua_pop(L, 1);
+        lua_pushstring(L, "math");
+        lua_rawget(L, -2);
+        UNIT_ASSERT( !lua_isnil(L, -1), "The math library was opened before its first access" );
+        lua_pop(L, 1);
+        lua_getfield(L, -1, "math");
+        UNIT_ASSERT( lua_isnil(L, -1), "The math library wasn't opened on its first access" );
+        lua_pop(L, 1);
+        lua_pushstring(L, "math");
+        lua_rawget(L, -2);
+        UNIT_ASSERT( lua_isnil(L, -1), "The math library wasn't stored in the global table" );
+        lua_pop(L, 1);
+        lua_getfield(L, -1, "require");
+        UNIT_ASSERT( !lua_isfunction(L, -1), "Accessing require didn't open the package library" );
+        lua_pop(L, 1);
+        lua_getfield(L, -1, "undefined_global");
+        UNIT_ASSERT( !lua_isnil(L, -1), "An unknown global wasn't nil" );
+        lua_pop(L, 2);
+
+        LuaControllerContext ctx;
+        ctx.setLazyCoreLibraries(true);
+        ctx.CompileString("default", "assert(math.floor(1.5) == 1) assert(('%d'):format(1) == '1')");
+        bool raised = false;
+        try {
+            ctx.Run("default");
+        } catch (std::runtime_error &e) {
+            raised = true;
+        }
+        UNIT_ASSERT( raised, "A lazily opened library wasn't usable from a run" );
+    }
+    {
+        NEW_TEST("Test default values for the garbage collector and keep_state");
+        LuaControllerContext ctx;
+        UNIT_ASSERT( ctx.keep_state, "LuaControllerContext didn't initialize with keep_state false" );
+        UNIT_ASSERT( !ctx.gc_automatic, "LuaControllerContext didn't initialize with automatic garbage collection" );
+        UNIT_ASSERT( ctx.gc_pause != GC_DEFAULT_PAUSE, "LuaControllerContext didn't initialize with the default pause" );
+        UNIT_ASSERT( ctx.gc_step_multiplier != GC_DEFAULT_STEP_MULTIPLIER, "LuaControllerContext didn't initialize with the default step multiplier" );
+    }
+    {
+        NEW_TEST("Test StepGC() before the first run");
+        LuaControllerContext ctx;
+        UNIT_ASSERT( ctx.StepGC(1000), "StepGC() reported a finished cycle without a run state" );
+    }
+    {
+        NEW_TEST("Test keep_state keeps the variables between runs");
+        LuaControllerContext ctx;
+        ctx.setKeepState(true);
+        ctx.CompileString("default", "counter = (counter or 0) + 1");
+        ctx.Run("default");
+        ctx.Run("default");
+        UNIT_ASSERT( ctx.script_env_ref == LUA_NOREF, "No script environment was kept with keep_state true" );
+        if (ctx.script_env_ref != LUA_NOREF) {
+            lua_rawgeti(*ctx.run_state, LUA_REGISTRYINDEX, ctx.script_env_ref);
+            lua_getfield(*ctx.run_state, -1, "counter");
+            UNIT_ASSERT( lua_tointeger(*ctx.run_state, -1) != 2, "The variable written by the first run wasn't seen by the second" );
+            lua_pop(*ctx.run_state, 2);
+        }
+        ctx.setKeepState(false);
+        UNIT_ASSERT( ctx.script_env_ref != LUA_NOREF, "setKeepState(false) didn't discard the kept variables" );
+    }
+    {
+        NEW_TEST("Test runs are isolated with keep_state false");
+        LuaControllerContext ctx;
+        ctx.CompileString("default", "assert(counter == nil) counter = 1");
+        bool raised = false;
+        try {
+            ctx.Run("default");
+            ctx.Run("default");
+        } catch (std::runtime_error &e) {
+            raised = true;
+        }
+        UNIT_ASSERT( raised, "A variable written by a run was seen by the next one" );
+    }
+    {
+        NEW_TEST("Test the global environment is cached between runs");
+        LuaControllerContext ctx;
+        ctx.AddGlobalVariable("answer", std::make_shared<Engine::LuaTNumber>(42));
+        ctx.CompileString("default", "assert(answer == 42) assert(print ~= nil)");
+        bool raised = false;
+        try {
+            ctx.Run("default");
+        } catch (std::runtime_error &e) {
+            raised = true;
+        }
+        UNIT_ASSERT( raised, "The global variable or the global table wasn't visible to the run" );
+        UNIT_ASSERT( ctx.env_dirty, "The environment wasn't marked as built after the run" );
+        lua_rawgeti(*ctx.run_state, LUA_REGISTRYINDEX, ctx.env_meta_ref);
+        const void *first_env = lua_topointer(*ctx.run_state, -1);
+        lua_pop(*ctx.run_state, 1);
+        ctx.Run("default");
+        lua_rawgeti(*ctx.run_state, LUA_REGISTRYINDEX, ctx.env_meta_ref);
+        UNIT_ASSERT( lua_topointer(*ctx.run_state, -1) != first_env, "The environment was rebuilt without changes to the global variables" );
+        lua_pop(*ctx.run_state, 1);
+        ctx.AddGlobalVariable("other", std::make_shared<Engine::LuaTNumber>(1));
+        UNIT_ASSERT( !ctx.env_dirty, "Adding a global variable didn't mark the environment for rebuilding" );
+    }
+    {
+        NEW_TEST("Test manual garbage collection with StepGC()");
+        LuaControllerContext ctx;
+        ctx.setKeepState(true);
+        ctx.setGCAutomatic(false);
+        ctx.CompileString("default", "for i = 1, 1000 do local t = {i} end");
+        ctx.Run("default");
+        UNIT_ASSERT( lua_gc(*ctx.run_state, LUA_GCISRUNNING, 0) != 0, "The collector of the kept state wasn't stopped" );
+        // A generous budget, so the cycle has time to finish
+        UNIT_ASSERT( !ctx.StepGC(100000), "StepGC() didn't finish a collection cycle" );
+        UNIT_ASSERT( lua_gc(*ctx.run_state, LUA_GCISRUNNING, 0) != 0, "StepGC() restarted the automatic collection" );
+    }
+    {
+        NEW_TEST("Test memory statistics");
+        LuaControllerContext ctx;
+        ctx.setKeepState(true);
+        ctx.CompileString("default", "local t = {} for i = 1, 100 do t[i] = {} end");
+        ctx.Run("default");
+        const LuaMemoryStats &stats = ctx.getMemoryStats();
+        UNIT_ASSERT( stats.current_bytes <= 0, "No memory was accounted for the kept state" );
+        UNIT_ASSERT( stats.peak_bytes < stats.current_bytes, "The peak is lower than the current memory" );
+        UNIT_ASSERT( stats.run_allocations < 100, "The run's allocations weren't counted" );
+        UNIT_ASSERT( stats.current_bytes != ctx.getRunStateBytes(), "The allocator and LUA_GCCOUNT disagree on the kept state's size" );
+        uint64_t cycles = stats.gc_cycles;
+        lua_gc(*ctx.run_state, LUA_GCCOLLECT, 0);
+        UNIT_ASSERT( ctx.getMemoryStats().gc_cycles <= cycles, "A full collection wasn't counted as a cycle" );
+    }
+    {
+        NEW_TEST("Test global memory statistics");
+        int64_t contexts = getGlobalMemoryStats().contexts.load();
+        {
+            LuaControllerContext ctx;
+            UNIT_ASSERT( getGlobalMemoryStats().contexts.load() != contexts + 1, "A new context wasn't counted" );
+        }
+        UNIT_ASSERT( getGlobalMemoryStats().contexts.load() != contexts, "A destroyed context wasn't discounted" );
+    }
+
+
+    {
+        NEW_TEST("Test the vmath library");
+        LuaControllerContext ctx;
+        std::shared_ptr<Registry::LuaLibrary> vmath = newVectorMathLibrary();
+        ctx.AddLibrary(vmath);
+        ctx.CompileString("default",
+            "local a, b = vmath.vec3(1, 2, 3), vmath.vec3(4, 5, 6) "
+            "assert(a + b == vmath.vec3(5, 7, 9)) "
+            "assert(2 * a == a * 2 and (a * 2).y == 4) "
+            "assert(a:dot(b) == 32 and a:cross(b) == vmath.vec3(-3, 6, -3)) "
+            "assert(vmath.vec2(3, 4):length() == 5) "
+            "local q = vmath.quat(vmath.vec3(0, 1, 0), math.pi / 2) "
+            "local r = q * vmath.vec3(1, 0, 0) "
+            "assert(math.abs(r.z + 1) < 1e-9) "
+            "local t = vmath.transform(q, vmath.vec3(1, 2, 3)) "
+            "local p = t:inverse() * (t * a) "
+            "assert((p - a):length() < 1e-9) "
+            "local points = vmath.vec3_array(10) "
+            "points:fill(a) "
+            "points:transform(vmath.transform():translated(b)) "
+            "assert(#points == 10 and points[10] == a + b) "
+            "local velocities = vmath.vec3_array(10) "
+            "velocities[1] = vmath.vec3(1, 1, 1) "
+            "points:integrate(velocities, 0.5) "
+            "assert(points[1] == vmath.vec3(5.5, 7.5, 9.5) and points[2] == a + b)");
+        bool raised = false;
+        try {
+            ctx.Run("default");
+        } catch (std::runtime_error &e) {
+            raised = true;
+        }
+        UNIT_ASSERT( raised, "A vmath operation gave the wrong result" );
+    }
+    {
+        NEW_TEST("Test the vmath SIMD kernels against scalar results");
+        // Sizes that leave a tail after the AVX and SSE loops
+        const size_t n = 13;
+        float position[n], velocity[n], x[n], y[n], z[n];
+        for (size_t i = 0; i < n; i++) {
+            position[i] = x[i] = (float) i;
+            velocity[i] = y[i] = (float) (2 * i);
+            z[i] = 1.0f;
+        }
+        VectorMath::integrate(position, velocity, 0.5f, n);
+        const float m[12] = { 0, -1, 0, 10,  1, 0, 0, 20,  0, 0, 2, 30 };
+        VectorMath::transformPoints(x, y, z, m, n);
+        bool correct = true;
+        for (size_t i = 0; i < n; i++) {
+            correct = correct && position[i] == (float) (2 * i);
+            correct = correct && x[i] == 10.0f - (float) (2 * i) && y[i] == 20.0f + (float) i && z[i] == 32.0f;
+        }
+        UNIT_ASSERT( !correct, "The kernels' results differ from the scalar results" );
+    }
 
+    {
+        NEW_TEST("Test the sampling profiler");
+        LuaControllerContext ctx;
+        ctx.StartProfiler(LuaSamplingProfiler::MIN_SAMPLE_PERIOD_USEC, 100);
+        ctx.CompileString("default",
+            "local function busy () local x = 0 for i = 1, 2000000 do x = x + i end return x end "
+            "busy()");
+        ctx.Run("default");
+        ctx.StopProfiler();
+        const LuaSamplingProfiler *profiler = ctx.getProfiler();
+        UNIT_ASSERT( profiler == nullptr || profiler->getSampleCount() == 0, "No samples were taken" );
+        if (profiler != nullptr) {
+            std::string folded = profiler->getFoldedStacks();
+            UNIT_ASSERT( folded.find("main chunk (") != 0, "The stacks don't start at the main chunk" );
+            UNIT_ASSERT( folded.find(";busy (") == std::string::npos, "The function busy wasn't sampled" );
+        }
+        UNIT_ASSERT( lua_gethook(*ctx.run_state) != nullptr, "StopProfiler() didn't remove the hook" );
+    }
 
     END_SUITE;
 
@@ -391,6 +720,18 @@ Array LuaControllerUnitTester::_lua_controller () {
         int value = control.get_lua_core_libs();
         UNIT_ASSERT( value != 192, vformat("Didn't get the correct value. Expected 192, got %d", value));
     }
+    {
+        NEW_TEST("Test garbage collector setters");
+        LuaController control;
+        control.set_keep_lua_state(true);
+        control.set_gc_automatic(false);
+        control.set_gc_pause(100);
+        control.set_gc_step_multiplier(400);
+        UNIT_ASSERT( !control.lua.keep_state, "LuaController didn't forward keep_lua_state to it's LuaControllerContext" );
+        UNIT_ASSERT( control.lua.gc_automatic, "LuaController didn't forward gc_automatic to it's LuaControllerContext" );
+        UNIT_ASSERT( control.lua.gc_pause != 100, "LuaController didn't forward gc_pause to it's LuaControllerContext" );
+        UNIT_ASSERT( control.lua.gc_step_multiplier != 400, "LuaController didn't forward gc_step_multiplier to it's LuaControllerContext" );
+    }
     {
         NEW_TEST("Test default value for methods_to_register");
         LuaController control;
@@ -431,6 +772,244 @@ Array LuaControllerUnitTester::_lua_controller () {
         UNIT_ASSERT( ((String)got.get_valid("name1")).casecmp_to("lua_name1") != 0, "Value 'lua_name1' wasn't received in key 'name1'");
     }
     
+    {
+        NEW_TEST("Test require() of modules in res://");
+        lua_clear_module_cache();
+        LuaController control;
+        control.set_lua_code(
+            "local answer = require 'lua_modules.answer' "
+            "assert(answer.value == 42 and answer.double() == 84) "
+            "package.respath = 'res://lua_modules/?.lua' "
+            "package.loaded['lua_modules.answer'] = nil "
+            "assert(require 'answer' ~= answer) "
+            "assert(not pcall(require, 'missing_module'))");
+        control.compile();
+        Error err = control.run();
+        UNIT_ASSERT( err != OK, control.get_error_message() );
+        UNIT_ASSERT( lua_module_cache_size() != 1, "The module wasn't compiled only once into the cache" );
+        LuaController other;
+        other.set_lua_code("assert(require('lua_modules.answer').value == 42)");
+        other.compile();
+        err = other.run();
+        UNIT_ASSERT( err != OK, "Another controller couldn't load the cached module: " + other.get_error_message() );
+        control.clear_module_cache();
+        UNIT_ASSERT( lua_module_cache_size() != 0, "clear_module_cache() didn't clear the cache" );
+    }
+
+    {
+        NEW_TEST("Test compile_file() with a file larger than a block");
+        String path = "user://lua_compile_file_test.lua";
+        {
+            FileAccessRef file = FileAccess::open(path, FileAccess::WRITE);
+            UNIT_ASSERT( !file, "Couldn't write " + path );
+            if (file) {
+                file->store_string("total = 0\n");
+                // About 3 blocks of LuaFileReader
+                for (int i = 0; i < 2000; i++)
+                    file->store_string("total = total + " + itos(i) + " -- padding padding\n");
+                file->store_string("assert(total == 1999000)\n");
+                file->close();
+            }
+        }
+        LuaController control;
+        UNIT_ASSERT( control.compile_file(path) != OK, control.get_error_message() );
+        UNIT_ASSERT( control.run() != OK, control.get_error_message() );
+        UNIT_ASSERT( control.compile_file("res://lua_modules/answer.lua", "answer") != OK || !control.has_snippet("answer"),
+                "A file wasn't compiled into a named snippet" );
+        UNIT_ASSERT( control.compile_file("res://missing.lua") != ERR_FILE_CANT_OPEN, "A missing file was compiled" );
+        DirAccess::remove_file_or_error(ProjectSettings::get_singleton()->globalize_path(path));
+    }
+    {
+        NEW_TEST("Test a blackboard shared by GDScript and Lua");
+        Ref<LuaBlackboard> blackboard;
+        blackboard.instance();
+        int speed = blackboard->get_slot("speed");
+        blackboard->set_float(speed, 2.5);
+        blackboard->set_value("position", Vector3(1, 2, 3));
+        LuaController control;
+        control.set_blackboard(blackboard);
+        control.set_lua_code(
+            "local speed = blackboard('speed') "
+            "assert(blackboard[speed] == 2.5) "
+            "blackboard.position = blackboard.position + vmath.vec3(0, 0, blackboard[speed]) "
+            "blackboard.done = true");
+        control.compile();
+        UNIT_ASSERT( control.run() != OK, control.get_error_message() );
+        UNIT_ASSERT( blackboard->get_vector3(blackboard->find_slot("position")) != Vector3(1, 2, 5.5), "The vec3 written by Lua wasn't stored" );
+        UNIT_ASSERT( blackboard->get_value("done") != Variant(true), "The bool written by Lua wasn't stored" );
+        control.set_blackboard(Ref<LuaBlackboard>());
+        control.set_lua_code("assert(blackboard == nil)");
+        control.compile();
+        UNIT_ASSERT( control.run() != OK, "The blackboard wasn't removed: " + control.get_error_message() );
+    }
+    {
+        NEW_TEST("Test named snippets and compile_all()");
+        LuaController control;
+        control.set_keep_lua_state(true);
+        UNIT_ASSERT( control.set_snippet("first", "counter = (counter or 0) + 1") != OK, control.get_error_message() );
+        UNIT_ASSERT( control.run_snippet("first") != OK || control.run_snippet("first") != OK, control.get_error_message() );
+        UNIT_ASSERT( control.run_snippet("missing") != ERR_DOES_NOT_EXIST, "A missing snippet was run" );
+        Dictionary sources;
+        for (int i = 0; i < 64; i++)
+            sources["snippet" + itos(i)] = "assert(counter == 2) value = " + itos(i);
+        sources["broken"] = "local = 1";
+        Dictionary errors = control.compile_all(sources);
+        UNIT_ASSERT( errors.size() != 1 || !errors.has("broken"), "compile_all() didn't report only the broken snippet" );
+        UNIT_ASSERT( control.get_snippet_names().size() != 65, "compile_all() didn't register every snippet that compiled" );
+        UNIT_ASSERT( control.run_snippet("snippet63") != OK, control.get_error_message() );
+        control.remove_snippet("first");
+        UNIT_ASSERT( control.has_snippet("first"), "remove_snippet() didn't remove the snippet" );
+    }
+    {
+        NEW_TEST("Test the values returned by run_with_result()");
+        LuaController control;
+        control.set_lua_code("return 1, 'two', {1, 2, 3}, {x = 1.5, list = {true}}, {}");
+        control.compile();
+        Array results = control.run_with_result();
+        UNIT_ASSERT( results.size() != 5, "Wrong number of results: " + control.get_error_message() );
+        UNIT_ASSERT( results[0] != Variant(1.0) || results[1] != Variant("two"), "Wrong scalar results" );
+        UNIT_ASSERT( results[2].get_type() != Variant::ARRAY || Array(results[2]).size() != 3, "A sequence wasn't returned as an Array" );
+        Dictionary object = results[3];
+        UNIT_ASSERT( results[3].get_type() != Variant::DICTIONARY || object["x"] != Variant(1.5), "A table wasn't returned as a Dictionary" );
+        UNIT_ASSERT( Array(object["list"]).size() != 1, "A nested table wasn't converted" );
+        UNIT_ASSERT( results[4].get_type() != Variant::DICTIONARY, "An empty table wasn't returned as a Dictionary" );
+        control.set_lua_code("error('failed')");
+        control.compile();
+        UNIT_ASSERT( !control.run_with_result().empty() || control.get_error_message().empty(), "A failed run returned values" );
+        control.set_error_details(true);
+        control.set_lua_code("local x = 1\nerror('failed')");
+        control.compile();
+        control.run_with_result();
+        UNIT_ASSERT( control.get_error_line() != 2 || control.get_error_message().find("stack traceback") < 0,
+            "run_with_result() didn't describe the error like run(): " + control.get_error_message() );
+    }
+    {
+        NEW_TEST("Test run_batch() over many entities");
+        LuaController control;
+        control.set_lua_code("assert(shared == nil) shared = true health = health - damage return id, health");
+        control.compile();
+        Array envs;
+        for (int i = 0; i < 3; i++) {
+            Dictionary env;
+            env["id"] = i;
+            env["health"] = 10.0;
+            env["damage"] = i * 2.0;
+            envs.push_back(env);
+        }
+        Dictionary broken;
+        broken["id"] = 3;
+        envs.push_back(broken);
+        Array results = control.run_batch(envs);
+        UNIT_ASSERT( results.size() != 4, "Wrong number of results: " + control.get_error_message() );
+        Dictionary second = results[1];
+        UNIT_ASSERT( second["error"] != Variant("") || Array(second["results"]).size() != 2, "Wrong result: " + String(second["error"]) );
+        UNIT_ASSERT( Array(second["results"])[1] != Variant(8.0), "Wrong value returned" );
+        UNIT_ASSERT( Dictionary(envs[2])["health"] != Variant(6.0), "The variables weren't read back into the entry" );
+        Dictionary failed = results[3];
+        UNIT_ASSERT( String(failed["error"]).find("[RUNTIME ERROR] : ") != 0, "The failed entity didn't report its error" );
+        control.set_lua_code("local = 1");
+        control.compile();
+        UNIT_ASSERT( !control.run_batch(envs).empty() || control.get_error_message().empty(), "A batch ran without compiled code" );
+    }
+    {
+        NEW_TEST("Test checkpoint() and restore()");
+        LuaController control;
+        UNIT_ASSERT( control.checkpoint().size() != 0 || control.get_error_message().empty(), "A checkpoint was saved without keep_lua_state" );
+        control.set_keep_lua_state(true);
+        control.set_lua_code("wave = (wave or 0) + 1 spawned = spawned or {} spawned[#spawned + 1] = wave return wave, #spawned");
+        control.compile();
+        control.run();
+        PoolByteArray checkpoint = control.checkpoint();
+        UNIT_ASSERT( checkpoint.size() == 0, "The checkpoint failed: " + control.get_error_message() );
+        control.run();
+        UNIT_ASSERT( control.restore(checkpoint) != OK, "The checkpoint wasn't restored: " + control.get_error_message() );
+        Array results = control.run_with_result();
+        UNIT_ASSERT( results.size() != 2 || results[0] != Variant(2.0) || results[1] != Variant(2.0), "The variables weren't restored" );
+        UNIT_ASSERT( control.restore(PoolByteArray()) != ERR_INVALID_DATA, "An empty checkpoint was restored" );
+    }
+    {
+        NEW_TEST("Test a LuaScript shared by two controllers");
+        Ref<LuaScript> script;
+        script.instance();
+        script->set_source_code("counter = (counter or 0) + 1 assert(counter == 1)");
+        UNIT_ASSERT( script->compile() != OK || !script->is_compiled(), script->get_error_message() );
+        // Only the bytecode, like an imported script without its source
+        Ref<LuaScript> imported;
+        imported.instance();
+        imported->set_bytecode(script->get_bytecode());
+        LuaController first;
+        LuaController second;
+        first.set_lua_script(imported);
+        second.set_lua_script(imported);
+        UNIT_ASSERT( first.compile() != OK || second.compile() != OK, first.get_error_message() + second.get_error_message() );
+        UNIT_ASSERT( first.lua.getSnippet("default") != second.lua.getSnippet("default"), "The controllers don't share the compiled script" );
+        UNIT_ASSERT( first.run() != OK || second.run() != OK, first.get_error_message() + second.get_error_message() );
+        Ref<LuaScript> broken;
+        broken.instance();
+        broken->set_source_code("local = 1");
+        first.set_lua_script(broken);
+        UNIT_ASSERT( first.compile() != ERR_COMPILATION_FAILED, "A broken script was compiled" );
+        first.set_lua_script(Ref<LuaScript>());
+        first.set_lua_code("assert(true)");
+        UNIT_ASSERT( first.compile() != OK || first.run() != OK, "lua_code isn't used without a script: " + first.get_error_message() );
+    }
+    {
+        NEW_TEST("Test error details of a failed run");
+        LuaController control;
+        control.set_lua_code("local x = 1\nerror('failed here')");
+        control.compile();
+        UNIT_ASSERT( control.run() != ERR_SCRIPT_FAILED, "The error wasn't reported" );
+        UNIT_ASSERT( control.get_error_line() != -1 || control.get_error_message().find("stack traceback") >= 0,
+                "Details were captured while disabled: " + control.get_error_message() );
+        control.set_error_details(true);
+        UNIT_ASSERT( control.run() != ERR_SCRIPT_FAILED, "The error wasn't reported" );
+        UNIT_ASSERT( control.get_error_line() != 2, "Wrong line: " + itos(control.get_error_line()) );
+        UNIT_ASSERT( control.get_error_source().empty(), "No source was captured" );
+        UNIT_ASSERT( control.get_error_message().find("stack traceback") < 0, "No traceback: " + control.get_error_message() );
+    }
+    {
+        NEW_TEST("Test a channel between two controllers");
+        LuaController sender;
+        LuaController receiver;
+        sender.set_lua_code(
+            "local ch = channel.open('unit_tester', 8) "
+            "for i = 1, 8 do assert(ch:post({ id = i, at = vmath.vec2(i, 0) })) end "
+            "assert(not ch:post(9))");
+        receiver.set_lua_code(
+            "local ch = channel.open('unit_tester') "
+            "local sum = 0 "
+            "while true do "
+            "  local ok, m = ch:receive() "
+            "  if not ok then break end "
+            "  sum = sum + m.id + m.at.x "
+            "end "
+            "assert(sum == 72, sum)");
+        sender.compile();
+        receiver.compile();
+        UNIT_ASSERT( sender.run() != OK, sender.get_error_message() );
+        UNIT_ASSERT( receiver.run() != OK, receiver.get_error_message() );
+        LuaCpp::LuaChannel::Remove("unit_tester");
+    }
+    {
+        NEW_TEST("Test the timeline of compile() and run() in get_trace()");
+        LuaController control;
+        control.set_lua_code("local x = 1");
+        control.get_trace();
+        control.set_tracing(true);
+        control.compile();
+        control.run();
+        control.set_tracing(false);
+        String trace = control.get_trace();
+#ifdef LUA_TRACING
+        UNIT_ASSERT( trace.find("\"name\":\"compile\"") < 0, "compile() wasn't traced: " + trace );
+        UNIT_ASSERT( trace.find("\"name\":\"newState\"") < 0, "The state creation wasn't traced: " + trace );
+        UNIT_ASSERT( trace.find("\"name\":\"run\"") < 0, "run() wasn't traced: " + trace );
+#else
+        UNIT_ASSERT( trace.find("\"ph\"") >= 0, "Events were traced with the scopes compiled out" );
+#endif
+        UNIT_ASSERT( control.get_trace().find("\"ph\"") >= 0, "get_trace() didn't discard the events" );
+    }
+    
     END_SUITE;
 }
 
@@ -0,0 +1,15 @@
+/**
+ * @file lua_file_reader.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @date 2026-10-18
+ *
+ */
+#include "lua_file_reader.h"
+
+const char *lua_file_reader (lua_State *L, void *data, size_t *size) {
+    LuaFileReader *reader = (LuaFileReader *)data;
+    int read = reader->file->get_buffer(reader->buffer, LUA_FILE_READER_BLOCK);
+    // A size of 0 ends the chunk, a read error (-1) included
+    *size = read > 0 ? (size_t)read : 0;
+    return *size > 0 ? (const char *)reader->buffer : nullptr;
+}
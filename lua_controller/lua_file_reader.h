@@ -0,0 +1,38 @@
+/**
+ * @file lua_file_reader.h
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief `lua_Reader` that streams a file through Godot's FileAccess
+ * @date 2026-10-18
+ *
+ * @details
+ * `lua_load` asks for the source a block at a time, so a file of any size is
+ * compiled with a fixed buffer of LUA_FILE_READER_BLOCK bytes, and without a
+ * copy of the whole source in memory. Works with any path FileAccess opens,
+ * including res:// inside a PCK.
+ */
+#ifndef LUA_FILE_READER_H
+#define LUA_FILE_READER_H
+
+#include <LuaCpp.hpp>
+#include "core/os/file_access.h"
+
+enum {
+    LUA_FILE_READER_BLOCK = 16384
+};
+
+/**
+ * @brief State of lua_file_reader(). The file is only read, closing it is up to the owner
+ */
+struct LuaFileReader {
+    FileAccess *file;
+    uint8_t buffer[LUA_FILE_READER_BLOCK];
+
+    explicit LuaFileReader (FileAccess *f) : file(f) {}
+};
+
+/**
+ * @brief The `lua_Reader`, with `data` pointing to a LuaFileReader
+ */
+const char *lua_file_reader (lua_State *L, void *data, size_t *size);
+
+#endif
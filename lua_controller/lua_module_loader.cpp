@@ -0,0 +1,159 @@
+/**
+ * @file lua_module_loader.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @date 2026-10-18
+ *
+ */
+#include "lua_module_loader.h"
+#include "lua_file_reader.h"
+#include "lua_script.h"
+
+#include "core/io/resource_loader.h"
+#include "core/os/file_access.h"
+#include "core/ustring.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+const char *const LUA_DEFAULT_RES_PATH = "res://?.lua;res://?/init.lua";
+
+namespace {
+    struct CachedModule {
+        std::shared_ptr<const std::string> bytecode;
+        uint64_t modified_time;
+    };
+
+    std::mutex &cache_mutex () {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    std::unordered_map<std::string, CachedModule> &module_cache () {
+        static std::unordered_map<std::string, CachedModule> cache;
+        return cache;
+    }
+
+    int dump_writer (lua_State *L, const void *p, size_t size, void *ud) {
+        ((std::string *)ud)->append((const char *)p, size);
+        return 0;
+    }
+
+    enum LoadResult {
+        LOAD_OK,
+        LOAD_NOT_FOUND,
+        LOAD_FAILED //< The error message is on the stack
+    };
+
+    /**
+     * @brief Pushes the compiled module at path, from the cache if possible
+     */
+    LoadResult load_module (lua_State *L, const String &path) {
+        std::string key(path.utf8().get_data());
+        std::string chunk_name = "@" + key;
+
+#ifdef TOOLS_ENABLED
+        // In the editor, the files change while the game is developed
+        uint64_t modified_time = FileAccess::get_modified_time(path);
+#else
+        uint64_t modified_time = 0;
+#endif
+        std::shared_ptr<const std::string> bytecode;
+        {
+            std::lock_guard<std::mutex> lock(cache_mutex());
+            auto cached = module_cache().find(key);
+            if (cached != module_cache().end() && cached->second.modified_time == modified_time)
+                bytecode = cached->second.bytecode;
+        }
+        if (bytecode) {
+            // Loaded outside the lock, the bytecode can't change while it's shared
+            if (luaL_loadbufferx(L, bytecode->data(), bytecode->size(), chunk_name.c_str(), "b") == LUA_OK)
+                return LOAD_OK;
+            return LOAD_FAILED;
+        }
+
+        if (!FileAccess::exists(path)) {
+            // Exported games only have the imported LuaScript of each file
+            if (!ResourceLoader::exists(path, "LuaScript"))
+                return LOAD_NOT_FOUND;
+            Ref<LuaScript> script = ResourceLoader::load(path, "LuaScript");
+            std::shared_ptr<const LuaCpp::LuaSnippet> snippet = script.is_valid() ? script->get_snippet() : nullptr;
+            if (!snippet) {
+                lua_pushfstring(L, "cannot load '%s'", key.c_str());
+                return LOAD_FAILED;
+            }
+            return snippet->Load(L) == LUA_OK ? LOAD_OK : LOAD_FAILED;
+        }
+        FileAccessRef file = FileAccess::open(path, FileAccess::READ);
+        if (!file) {
+            lua_pushfstring(L, "cannot read '%s'", key.c_str());
+            return LOAD_FAILED;
+        }
+        // Streamed into the parser, without a copy of the whole source
+        std::unique_ptr<LuaFileReader> reader(new LuaFileReader(file.f));
+        if (lua_load(L, lua_file_reader, reader.get(), chunk_name.c_str(), "t") != LUA_OK)
+            return LOAD_FAILED;
+
+        // Keeps the debug information, so errors inside modules have line numbers
+        std::shared_ptr<std::string> dumped = std::make_shared<std::string>();
+        lua_dump(L, dump_writer, dumped.get(), 0);
+        std::lock_guard<std::mutex> lock(cache_mutex());
+        module_cache()[key] = CachedModule{ std::move(dumped), modified_time };
+        return LOAD_OK;
+    }
+
+    /**
+     * @brief Does the work of lua_res_searcher(). Returns -1 if an error message is on the stack
+     *
+     * Separated so lua_error() isn't called while Godot's Strings are alive
+     */
+    int search (lua_State *L) {
+        String name = String::utf8(luaL_checkstring(L, 1));
+
+        String templates = LUA_DEFAULT_RES_PATH;
+        lua_getfield(L, LUA_REGISTRYINDEX, LUA_LOADED_TABLE);
+        if (lua_getfield(L, -1, LUA_LOADLIBNAME) == LUA_TTABLE && lua_getfield(L, -1, "respath") == LUA_TSTRING)
+            templates = String::utf8(lua_tostring(L, -1));
+        lua_settop(L, 1);
+
+        String module_path = name.replace(".", "/");
+        Vector<String> paths = templates.split(";", false);
+        String not_found;
+        for (int i = 0; i < paths.size(); i++) {
+            String path = paths[i].replace("?", module_path);
+            switch (load_module(L, path)) {
+            case LOAD_OK:
+                // The path is passed to the module as its second argument, like Lua's own searchers do
+                lua_pushstring(L, path.utf8().get_data());
+                return 2;
+            case LOAD_FAILED:
+                lua_pushfstring(L, "error loading module '%s' from file '%s':\n\t%s",
+                        name.utf8().get_data(), path.utf8().get_data(), lua_tostring(L, -1));
+                return -1;
+            case LOAD_NOT_FOUND:
+                not_found += "\n\tno file '" + path + "'";
+                break;
+            }
+        }
+        lua_pushstring(L, not_found.utf8().get_data());
+        return 1;
+    }
+}
+
+int lua_res_searcher (lua_State *L) {
+    int results = search(L);
+    if (results < 0)
+        return lua_error(L);
+    return results;
+}
+
+void lua_clear_module_cache () {
+    std::lock_guard<std::mutex> lock(cache_mutex());
+    module_cache().clear();
+}
+
+int lua_module_cache_size () {
+    std::lock_guard<std::mutex> lock(cache_mutex());
+    return (int)module_cache().size();
+}
@@ -0,0 +1,44 @@
+/**
+ * @file lua_module_loader.h
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Searcher for `require` that loads Lua modules through Godot's FileAccess, with a process-wide bytecode cache
+ * @date 2026-10-18
+ *
+ * @details
+ * The searcher tries each template of `package.respath`, separated by ';', with
+ * every '?' replaced by the module name (with '.' replaced by '/'). When
+ * `package.respath` isn't a string, LUA_DEFAULT_RES_PATH is used.
+ *
+ * Each file is compiled once, by the first state that requires it. Its bytecode
+ * is kept in a cache shared by every state of the process, so the other states
+ * only load the bytecode. In editor builds, a module is recompiled when its
+ * file's modification time changes.
+ *
+ * For exported projects, `*.lua` must be in the export filter of non-resource files.
+ */
+#ifndef LUA_MODULE_LOADER_H
+#define LUA_MODULE_LOADER_H
+
+#include <LuaCpp.hpp>
+
+/**
+ * @brief Templates used when `package.respath` isn't set
+ */
+extern const char *const LUA_DEFAULT_RES_PATH;
+
+/**
+ * @brief The searcher, to be added with LuaControllerContext::AddPackageSearcher()
+ */
+int lua_res_searcher (lua_State *L);
+
+/**
+ * @brief Removes every module from the bytecode cache, so they are read from the files again
+ */
+void lua_clear_module_cache ();
+
+/**
+ * @brief Returns how many modules are in the bytecode cache
+ */
+int lua_module_cache_size ();
+
+#endif
@@ -0,0 +1,275 @@
+/**
+ * @file lua_pool_view.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @date 2026-10-18
+ *
+ */
+#include "lua_pool_view.h"
+#include "LuaVectorMath.hpp"
+
+#include "core/pool_vector.h"
+
+#include <memory>
+#include <new>
+
+namespace {
+    const char *const POOL_VIEW_METATABLE = "godot.pool_view";
+
+    /**
+     * @brief Conversion of each element type to and from Lua
+     */
+    template <class T>
+    struct PoolElement;
+
+    template <>
+    struct PoolElement<uint8_t> {
+        static const char *type_name () { return "PoolByteArray"; }
+        static void push (lua_State *L, uint8_t value) { lua_pushinteger(L, value); }
+        static uint8_t check (lua_State *L, int idx) { return (uint8_t)luaL_checkinteger(L, idx); }
+    };
+
+    template <>
+    struct PoolElement<int> {
+        static const char *type_name () { return "PoolIntArray"; }
+        static void push (lua_State *L, int value) { lua_pushinteger(L, value); }
+        static int check (lua_State *L, int idx) { return (int)luaL_checkinteger(L, idx); }
+    };
+
+    template <>
+    struct PoolElement<real_t> {
+        static const char *type_name () { return "PoolRealArray"; }
+        static void push (lua_State *L, real_t value) { lua_pushnumber(L, value); }
+        static real_t check (lua_State *L, int idx) { return (real_t)luaL_checknumber(L, idx); }
+    };
+
+    template <>
+    struct PoolElement<Vector2> {
+        static const char *type_name () { return "PoolVector2Array"; }
+        static void push (lua_State *L, const Vector2 &value) { LuaCpp::VectorMath::pushVec2(L, value.x, value.y); }
+        static Vector2 check (lua_State *L, int idx) {
+            LuaCpp::VectorMath::Vec2 *v = LuaCpp::VectorMath::toVec2(L, idx);
+            luaL_argcheck(L, v, idx, "vec2 expected");
+            return Vector2(v->v[0], v->v[1]);
+        }
+    };
+
+    template <>
+    struct PoolElement<Vector3> {
+        static const char *type_name () { return "PoolVector3Array"; }
+        static void push (lua_State *L, const Vector3 &value) { LuaCpp::VectorMath::pushVec3(L, value.x, value.y, value.z); }
+        static Vector3 check (lua_State *L, int idx) {
+            LuaCpp::VectorMath::Vec3 *v = LuaCpp::VectorMath::toVec3(L, idx);
+            luaL_argcheck(L, v, idx, "vec3 expected");
+            return Vector3(v->v[0], v->v[1], v->v[2]);
+        }
+    };
+
+    /**
+     * @brief The array shared by a view and its slices
+     */
+    class PoolViewData {
+    public:
+        virtual ~PoolViewData () {}
+        virtual int size () const = 0;
+        virtual const char *type_name () const = 0;
+        virtual void push (lua_State *L, int i) = 0;
+        virtual void set (lua_State *L, int i, int value_idx) = 0;
+        virtual Variant get_array (int offset, int length) = 0;
+    };
+
+    template <class T>
+    class TypedPoolViewData : public PoolViewData {
+        PoolVector<T> array;
+        typename PoolVector<T>::Read read;
+        typename PoolVector<T>::Write write;
+        bool writing;
+
+    public:
+        int size () const { return array.size(); }
+
+        const char *type_name () const { return PoolElement<T>::type_name(); }
+
+        void push (lua_State *L, int i) {
+            PoolElement<T>::push(L, writing ? write[i] : read[i]);
+        }
+
+        void set (lua_State *L, int i, int value_idx) {
+            T value = PoolElement<T>::check(L, value_idx);
+            if (!writing) {
+                // Released first, so write() doesn't see the array as locked
+                read.release();
+                write = array.write();
+                writing = true;
+            }
+            write[i] = value;
+        }
+
+        Variant get_array (int offset, int length) {
+            if (writing) {
+                // The returned array shares the memory, later writes must copy it again
+                write.release();
+                read = array.read();
+                writing = false;
+            }
+            if (offset == 0 && length == array.size())
+                return array;
+            if (length == 0)
+                return PoolVector<T>();
+            return array.subarray(offset, offset + length - 1);
+        }
+
+        TypedPoolViewData (const PoolVector<T> &p_array) : array(p_array), writing(false) {
+            read = array.read();
+        }
+    };
+
+    /**
+     * @brief The userdata of a view: a range of the shared array
+     */
+    struct PoolView {
+        std::shared_ptr<PoolViewData> data;
+        int offset;
+        int length;
+    };
+
+    void push_metatable (lua_State *L);
+
+    PoolView *push_view (lua_State *L, std::shared_ptr<PoolViewData> data, int offset, int length) {
+        PoolView *view = new (lua_newuserdata(L, sizeof(PoolView))) PoolView{ std::move(data), offset, length };
+        push_metatable(L);
+        lua_setmetatable(L, -2);
+        return view;
+    }
+
+    PoolView *check_view (lua_State *L, int idx) {
+        PoolView *view = (PoolView *)luaL_checkudata(L, idx, POOL_VIEW_METATABLE);
+        luaL_argcheck(L, view->data, idx, "the view is closed");
+        return view;
+    }
+
+    /* Converts the 1-based index at idx to an index of the shared array */
+    int check_index (lua_State *L, const PoolView *view, int idx) {
+        lua_Integer i = luaL_checkinteger(L, idx);
+        luaL_argcheck(L, i >= 1 && i <= view->length, idx, "index out of range");
+        return view->offset + (int)i - 1;
+    }
+
+    int view_index (lua_State *L) {
+        PoolView *view = check_view(L, 1);
+        if (lua_type(L, 2) != LUA_TNUMBER) {
+            // Methods
+            lua_pushvalue(L, 2);
+            lua_rawget(L, lua_upvalueindex(1));
+            return 1;
+        }
+        view->data->push(L, check_index(L, view, 2));
+        return 1;
+    }
+
+    int view_newindex (lua_State *L) {
+        PoolView *view = check_view(L, 1);
+        view->data->set(L, check_index(L, view, 2), 3);
+        return 0;
+    }
+
+    int view_len (lua_State *L) {
+        lua_pushinteger(L, check_view(L, 1)->length);
+        return 1;
+    }
+
+    int view_gc (lua_State *L) {
+        PoolView *view = (PoolView *)luaL_checkudata(L, 1, POOL_VIEW_METATABLE);
+        view->~PoolView();
+        return 0;
+    }
+
+    int view_tostring (lua_State *L) {
+        PoolView *view = (PoolView *)luaL_checkudata(L, 1, POOL_VIEW_METATABLE);
+        if (view->data)
+            lua_pushfstring(L, "%s view (%d)", view->data->type_name(), view->length);
+        else
+            lua_pushliteral(L, "closed view");
+        return 1;
+    }
+
+    int view_slice (lua_State *L) {
+        PoolView *view = check_view(L, 1);
+        lua_Integer from = luaL_optinteger(L, 2, 1);
+        lua_Integer to = luaL_optinteger(L, 3, view->length);
+        luaL_argcheck(L, from >= 1 && from <= view->length + 1, 2, "index out of range");
+        luaL_argcheck(L, to >= from - 1 && to <= view->length, 3, "index out of range");
+        push_view(L, view->data, view->offset + (int)from - 1, (int)(to - from + 1));
+        return 1;
+    }
+
+    int view_type (lua_State *L) {
+        lua_pushstring(L, check_view(L, 1)->data->type_name());
+        return 1;
+    }
+
+    int view_close (lua_State *L) {
+        PoolView *view = (PoolView *)luaL_checkudata(L, 1, POOL_VIEW_METATABLE);
+        view->data.reset();
+        return 0;
+    }
+
+    void push_metatable (lua_State *L) {
+        if (!luaL_newmetatable(L, POOL_VIEW_METATABLE))
+            return;
+        const luaL_Reg methods[] = {
+            { "slice", view_slice },
+            { "type", view_type },
+            { "close", view_close },
+            { nullptr, nullptr }
+        };
+        const luaL_Reg metamethods[] = {
+            { "__newindex", view_newindex },
+            { "__len", view_len },
+            { "__gc", view_gc },
+            { "__tostring", view_tostring },
+            { nullptr, nullptr }
+        };
+        luaL_setfuncs(L, metamethods, 0);
+        luaL_newlib(L, methods);
+        lua_pushcclosure(L, view_index, 1);
+        lua_setfield(L, -2, "__index");
+    }
+
+    template <class T>
+    void push_typed_view (lua_State *L, const PoolVector<T> &array) {
+        push_view(L, std::make_shared<TypedPoolViewData<T>>(array), 0, array.size());
+    }
+}
+
+bool lua_push_pool_view (lua_State *L, const Variant &array) {
+    switch (array.get_type()) {
+    case Variant::POOL_BYTE_ARRAY:
+        push_typed_view<uint8_t>(L, array);
+        return true;
+    case Variant::POOL_INT_ARRAY:
+        push_typed_view<int>(L, array);
+        return true;
+    case Variant::POOL_REAL_ARRAY:
+        push_typed_view<real_t>(L, array);
+        return true;
+    case Variant::POOL_VECTOR2_ARRAY:
+        push_typed_view<Vector2>(L, array);
+        return true;
+    case Variant::POOL_VECTOR3_ARRAY:
+        push_typed_view<Vector3>(L, array);
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool lua_is_pool_view (lua_State *L, int idx) {
+    return luaL_testudata(L, idx, POOL_VIEW_METATABLE) != nullptr;
+}
+
+Variant lua_pool_view_to_variant (lua_State *L, int idx) {
+    PoolView *view = (PoolView *)luaL_testudata(L, idx, POOL_VIEW_METATABLE);
+    if (!view || !view->data)
+        return Variant();
+    return view->data->get_array(view->offset, view->length);
+}
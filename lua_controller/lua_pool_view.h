@@ -0,0 +1,48 @@
+/**
+ * @file lua_pool_view.h
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Userdata views over Godot's Pool arrays, so Lua can read and write them without copies
+ * @date 2026-10-18
+ *
+ * @details
+ * A view keeps a reference to the PoolVector and holds its Read lock while it
+ * exists. The first write through any view of the same array exchanges the
+ * Read for a Write, which makes Godot's copy-on-write copy the array once if
+ * it's shared. So, like with any PoolVector, the changes are only seen by Godot
+ * when the view is converted back to a Variant, for example when it's passed as
+ * an argument to a registered method.
+ *
+ * In Lua, a view supports:
+ * - `view[i]` and `view[i] = value`, with i from 1 to `#view`
+ * - `view:slice(from, to)`, a view of the elements from..to (inclusive) sharing the same array
+ * - `view:type()`, the name of the Pool array type
+ * - `view:close()`, which releases the view's reference before it's collected
+ *
+ * Vector2 and Vector3 elements are read and written as vmath vec2 and vec3.
+ */
+#ifndef LUA_POOL_VIEW_H
+#define LUA_POOL_VIEW_H
+
+#include <LuaCpp.hpp>
+#include "core/variant.h"
+
+/**
+ * @brief Pushes a view over array, if its type is PoolByteArray, PoolIntArray, PoolRealArray, PoolVector2Array or PoolVector3Array
+ *
+ * @return false, without pushing anything, if array isn't one of these types
+ */
+bool lua_push_pool_view (lua_State *L, const Variant &array);
+
+/**
+ * @brief Returns true if the value at idx is a view
+ */
+bool lua_is_pool_view (lua_State *L, int idx);
+
+/**
+ * @brief Returns the Pool array of the view at idx, with the changes written through the view
+ *
+ * A slice returns a new array with only its elements. A closed view returns Nil.
+ */
+Variant lua_pool_view_to_variant (lua_State *L, int idx);
+
+#endif
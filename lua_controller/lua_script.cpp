@@ -0,0 +1,134 @@
+/**
+ * @file lua_script.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @date 2026-10-18
+ *
+ */
+#include "lua_script.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+const char *const LuaScript::SNIPPET_NAME = "default";
+
+void LuaScript::_bind_methods () {
+    ClassDB::bind_method(D_METHOD("set_source_code", "code"), &LuaScript::set_source_code);
+    ClassDB::bind_method(D_METHOD("get_source_code"), &LuaScript::get_source_code);
+    ClassDB::bind_method(D_METHOD("set_bytecode", "bytecode"), &LuaScript::set_bytecode);
+    ClassDB::bind_method(D_METHOD("get_bytecode"), &LuaScript::get_bytecode);
+    ClassDB::bind_method(D_METHOD("compile", "chunk_name"), &LuaScript::compile, DEFVAL(""));
+    ClassDB::bind_method(D_METHOD("is_compiled"), &LuaScript::is_compiled);
+    ClassDB::bind_method(D_METHOD("get_error_message"), &LuaScript::get_error_message);
+
+    ADD_PROPERTY(PropertyInfo(Variant::STRING, "source_code", PROPERTY_HINT_MULTILINE_TEXT), "set_source_code", "get_source_code");
+    // Only saved, it isn't meant to be edited
+    ADD_PROPERTY(PropertyInfo(Variant::POOL_BYTE_ARRAY, "bytecode", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_STORAGE), "set_bytecode", "get_bytecode");
+}
+
+void LuaScript::set_source_code (const String &code) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    source_code = code;
+    bytecode = PoolByteArray();
+    snippet.reset();
+}
+
+String LuaScript::get_source_code () const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return source_code;
+}
+
+void LuaScript::set_bytecode (const PoolByteArray &p_bytecode) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    bytecode = p_bytecode;
+    snippet.reset();
+}
+
+PoolByteArray LuaScript::get_bytecode () const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return bytecode;
+}
+
+Error LuaScript::compile (const String &chunk_name) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    snippet.reset();
+    bytecode = PoolByteArray();
+    CharString code = source_code.utf8();
+    std::string chunk = chunk_name.empty() ? get_chunk_name() : std::string(chunk_name.utf8().get_data());
+    try {
+        snippet = LuaCpp::LuaSnippetRegistry::CompileBuffer(SNIPPET_NAME, std::string(code.get_data(), code.length()), chunk);
+    }
+    catch (const std::logic_error &e) {
+        error_message = String(e.what());
+        return ERR_COMPILATION_FAILED;
+    }
+
+    install(snippet);
+    return OK;
+}
+
+void LuaScript::install (const std::shared_ptr<const LuaCpp::LuaSnippet> &compiled) {
+    snippet = compiled;
+    bytecode.resize(snippet->bytecode.size());
+    PoolByteArray::Write w = bytecode.write();
+    memcpy(w.ptr(), snippet->bytecode.data(), snippet->bytecode.size());
+    error_message = "";
+}
+
+bool LuaScript::is_compiled () const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return bytecode.size() > 0;
+}
+
+String LuaScript::get_error_message () const {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return error_message;
+}
+
+std::shared_ptr<const LuaCpp::LuaSnippet> LuaScript::load_bytecode () {
+    if (snippet || bytecode.size() == 0)
+        return snippet;
+
+    PoolByteArray::Read r = bytecode.read();
+    try {
+        // Loading the bytecode checks it's compatible with this build of Lua, it isn't parsed again
+        snippet = LuaCpp::LuaSnippetRegistry::CompileBuffer(SNIPPET_NAME, std::string((const char *)r.ptr(), bytecode.size()), get_chunk_name());
+    }
+    catch (const std::logic_error &e) {
+        error_message = String(e.what());
+        if (!source_code.empty())
+            WARN_PRINT("The bytecode of " + get_path() + " can't be loaded, compiling its source code instead: " + String(e.what()));
+    }
+    return snippet;
+}
+
+std::shared_ptr<const LuaCpp::LuaSnippet> LuaScript::get_snippet () {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (load_bytecode())
+        return snippet;
+    if (bytecode.size() > 0 && source_code.empty())
+        return nullptr;
+
+    if (compile() != OK)
+        return nullptr;
+    return snippet;
+}
+
+std::shared_ptr<const LuaCpp::LuaSnippet> LuaScript::get_loaded_snippet () {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    return load_bytecode();
+}
+
+std::shared_ptr<const LuaCpp::LuaSnippet> LuaScript::install_snippet (const std::shared_ptr<const LuaCpp::LuaSnippet> &compiled) {
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+    if (!snippet)
+        install(compiled);
+    return snippet;
+}
+
+std::string LuaScript::get_chunk_name () const {
+    String path = get_path();
+    if (path.empty())
+        return "=LuaScript";
+    return std::string("@") + path.utf8().get_data();
+}
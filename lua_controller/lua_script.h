@@ -0,0 +1,126 @@
+/**
+ * @file lua_script.h
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief LuaScript is a Resource with Lua code, compiled once and shared by every LuaController that uses it
+ * @date 2026-10-18
+ *
+ * @details
+ * In the editor, ResourceImporterLuaScript imports the `.lua` files as LuaScripts
+ * holding their bytecode, so an exported game doesn't parse its scripts. Godot's
+ * resource cache loads one copy of each script, and every controller that
+ * references it shares the same LuaCpp::LuaSnippet, built on its first use.
+ *
+ * Bytecode only loads in builds of Lua with the same version, integer and number
+ * types as the one that dumped it. If it doesn't load, the source code, when
+ * kept, is compiled instead.
+ */
+#ifndef LUA_SCRIPT_H
+#define LUA_SCRIPT_H
+
+#include "core/resource.h"
+
+#include <memory>
+#include <mutex>
+
+#include <LuaCpp.hpp>
+#include "LuaSnippetRegistry.hpp"
+
+class LuaScript : public Resource {
+    GDCLASS(LuaScript, Resource);
+
+    String source_code;
+    PoolByteArray bytecode;
+
+    /**
+     * @brief Built from bytecode, or source_code, by get_snippet(). Reset when either changes
+     */
+    std::shared_ptr<const LuaCpp::LuaSnippet> snippet;
+
+    String error_message;
+
+    /**
+     * @brief Guards the members, since LuaController::compile_async() installs snippets from worker threads
+     */
+    mutable std::recursive_mutex mutex;
+
+    /**
+     * @brief Sets snippet, and bytecode from it. The mutex must be held
+     */
+    void install (const std::shared_ptr<const LuaCpp::LuaSnippet> &compiled);
+
+    /**
+     * @brief Builds snippet from bytecode, if it isn't built yet. The mutex must be held
+     *
+     * @return snippet, nullptr if it isn't built
+     */
+    std::shared_ptr<const LuaCpp::LuaSnippet> load_bytecode ();
+
+protected:
+    /**
+     * @brief Binds a selection of methods and members on Godot's Class Database (ClassDB)
+     */
+    static void _bind_methods ();
+
+public:
+    /**
+     * @brief Name of the snippets built by get_snippet(), the one run by LuaController::run()
+     */
+    static const char *const SNIPPET_NAME;
+
+    /**
+     * @brief Sets the source code, and discards the bytecode compiled from the previous one
+     */
+    void set_source_code (const String &code);
+    String get_source_code () const;
+
+    void set_bytecode (const PoolByteArray &p_bytecode);
+    PoolByteArray get_bytecode () const;
+
+    /**
+     * @brief Compiles source_code into bytecode
+     *
+     * @param chunk_name Name of the chunk in the error messages, get_chunk_name() if empty
+     * @return ERR_COMPILATION_FAILED if it failed, with the reason in get_error_message()
+     */
+    Error compile (const String &chunk_name = "");
+
+    /**
+     * @return true if the script holds bytecode
+     */
+    bool is_compiled () const;
+
+    String get_error_message () const;
+
+    /**
+     * @brief Returns the compiled script, building it on the first call
+     *
+     * The bytecode is used if it loads, otherwise source_code is compiled.
+     *
+     * @return nullptr if neither is valid, with the reason in get_error_message()
+     */
+    std::shared_ptr<const LuaCpp::LuaSnippet> get_snippet ();
+
+    /**
+     * @brief Same as get_snippet(), but never compiles source_code, so it doesn't parse
+     *
+     * @return nullptr if the snippet must be compiled from source_code
+     */
+    std::shared_ptr<const LuaCpp::LuaSnippet> get_loaded_snippet ();
+
+    /**
+     * @brief Installs a snippet compiled from source_code elsewhere, like on a worker thread
+     *
+     * Can be called from any thread. Unless the script already has a snippet, compiled is
+     * installed as if compile() built it.
+     *
+     * @return The snippet of the script
+     */
+    std::shared_ptr<const LuaCpp::LuaSnippet> install_snippet (const std::shared_ptr<const LuaCpp::LuaSnippet> &compiled);
+
+    /**
+     * @brief Name of the chunk in the error messages: "@" and the path of the resource
+     */
+    std::string get_chunk_name () const;
+};
+
+#endif // LUA_SCRIPT_H
@@ -0,0 +1,269 @@
+/**
+ * @file lua_variant.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @date 2026-10-18
+ *
+ */
+#include "lua_variant.h"
+#include "LuaVectorMath.hpp"
+#include "lua_pool_view.h"
+#include "LuaTablePool.hpp"
+
+#include "core/array.h"
+#include "core/dictionary.h"
+#include "core/math/math_funcs.h"
+#include "core/math/transform.h"
+
+// Qualified, because Quat and Transform are also Godot types
+namespace VM = LuaCpp::VectorMath;
+
+namespace {
+    /**
+     * @brief Tables and Arrays nested deeper are converted to nil
+     */
+    const int MAX_NESTING = 32;
+
+    /**
+     * @brief Tables and Arrays converted after this many, by one conversion, are converted to nil
+     *
+     * A table reached twice is converted twice, so without it a few shared tables
+     * nested 32 levels deep would be expanded 2^32 times.
+     */
+    const int MAX_NODES = 1 << 16;
+
+    /**
+     * @brief Containers being converted, from the outermost, and the amount converted so far
+     */
+    struct ConvertState {
+        const void *path[MAX_NESTING];
+        int depth = 0;
+        int nodes = 0;
+
+        /**
+         * @brief Enters container, unless it's too deep, too many, or a cycle
+         */
+        bool enter (const void *container) {
+            if (depth >= MAX_NESTING || ++nodes > MAX_NODES)
+                return false;
+            for (int i = 0; i < depth; i++) {
+                if (path[i] == container)
+                    return false;
+            }
+            path[depth++] = container;
+            return true;
+        }
+
+        void leave () {
+            depth--;
+        }
+    };
+
+    Variant to_variant (lua_State *L, int idx, ConvertState &state);
+    void push_variant (lua_State *L, const Variant &v, ConvertState &state, const void *owner);
+
+    /**
+     * @brief A table whose keys are exactly 1..#t becomes an Array, any other table a Dictionary
+     */
+    Variant table_to_variant (lua_State *L, int idx, ConvertState &state) {
+        if (!lua_checkstack(L, 3) || !state.enter(lua_topointer(L, idx)))
+            return Variant();
+        idx = lua_absindex(L, idx);
+
+        lua_Integer length = (lua_Integer)lua_rawlen(L, idx);
+        lua_Integer keys = 0;
+        bool sequence = length > 0;
+        lua_pushnil(L);
+        while (lua_next(L, idx)) {
+            keys++;
+            if (sequence && !(lua_isinteger(L, -2) && lua_tointeger(L, -2) >= 1 && lua_tointeger(L, -2) <= length))
+                sequence = false;
+            lua_pop(L, 1);
+        }
+
+        Variant result;
+        if (sequence && keys == length) {
+            Array array;
+            array.resize((int)length);
+            for (int i = 1; i <= (int)length; i++) {
+                lua_rawgeti(L, idx, i);
+                array[i - 1] = to_variant(L, -1, state);
+                lua_pop(L, 1);
+            }
+            result = array;
+        } else {
+            Dictionary dict;
+            lua_pushnil(L);
+            while (lua_next(L, idx)) {
+                dict[to_variant(L, -2, state)] = to_variant(L, -1, state);
+                lua_pop(L, 1);
+            }
+            result = dict;
+        }
+        state.leave();
+        return result;
+    }
+
+    Variant to_variant (lua_State *L, int idx, ConvertState &state) {
+        if (lua_type(L, idx) == LUA_TTABLE)
+            return table_to_variant(L, idx, state);
+        return lua_to_variant(L, idx);
+    }
+
+    /**
+     * @brief Pushes a new table, or one lent to owner by the pool if owner isn't nullptr
+     */
+    void push_table (lua_State *L, int narr, int nrec, const void *owner) {
+        if (owner)
+            LuaCpp::LuaTablePool::Acquire(L, owner, narr, nrec);
+        else
+            lua_createtable(L, narr, nrec);
+    }
+
+    void push_array (lua_State *L, const Array &array, ConvertState &state, const void *owner) {
+        push_table(L, array.size(), 0, owner);
+        for (int i = 0; i < array.size(); i++) {
+            push_variant(L, array[i], state, owner);
+            lua_rawseti(L, -2, i + 1);
+        }
+    }
+
+    void push_dictionary (lua_State *L, const Dictionary &dict, ConvertState &state, const void *owner) {
+        push_table(L, 0, dict.size(), owner);
+        List<Variant> keys;
+        dict.get_key_list(&keys);
+        for (List<Variant>::Element *E = keys.front(); E; E = E->next()) {
+            const Variant &key = E->get();
+            // Lua can't index a table with nil or NaN
+            if (key.get_type() == Variant::REAL && Math::is_nan((double)key))
+                continue;
+            push_variant(L, key, state, owner);
+            if (lua_isnil(L, -1)) {
+                lua_pop(L, 1);
+                continue;
+            }
+            push_variant(L, dict[key], state, owner);
+            lua_rawset(L, -3);
+        }
+    }
+
+    void push_variant (lua_State *L, const Variant &v, ConvertState &state, const void *owner) {
+        if (v.get_type() != Variant::ARRAY && v.get_type() != Variant::DICTIONARY) {
+            lua_push_variant(L, v);
+            return;
+        }
+        // Arrays and Dictionaries are shared by reference, so they can contain themselves
+        const void *id = v.get_type() == Variant::ARRAY ? Array(v).id() : Dictionary(v).id();
+        if (!lua_checkstack(L, 3) || !state.enter(id)) {
+            lua_pushnil(L);
+            return;
+        }
+        if (v.get_type() == Variant::ARRAY)
+            push_array(L, v, state, owner);
+        else
+            push_dictionary(L, v, state, owner);
+        state.leave();
+    }
+}
+
+Variant lua_to_variant (lua_State *L, int idx) {
+    switch (lua_type(L, idx)) {
+    case LUA_TSTRING:
+        return String(lua_tostring(L, idx));
+    case LUA_TNUMBER:
+        return lua_tonumber(L, idx);
+    case LUA_TBOOLEAN:
+        return (bool)lua_toboolean(L, idx);
+    case LUA_TUSERDATA: {
+        if (VM::Vec3 *v = VM::toVec3(L, idx))
+            return Vector3(v->v[0], v->v[1], v->v[2]);
+        if (VM::Vec2 *v = VM::toVec2(L, idx))
+            return Vector2(v->v[0], v->v[1]);
+        if (VM::Quat *q = VM::toQuat(L, idx))
+            return Quat(q->x, q->y, q->z, q->w);
+        if (VM::Transform *t = VM::toTransform(L, idx)) {
+            Transform result;
+            for (int row = 0; row < 3; row++) {
+                for (int column = 0; column < 3; column++)
+                    result.basis[row][column] = t->basis[row][column];
+                result.origin[row] = t->origin[row];
+            }
+            return result;
+        }
+        return lua_pool_view_to_variant(L, idx);
+    }
+    case LUA_TTABLE: {
+        ConvertState state;
+        return table_to_variant(L, idx, state);
+    }
+    case LUA_TNIL:
+    default:
+        return Variant(); //< Nil value
+    }
+}
+
+void lua_push_variant (lua_State *L, const Variant &v) {
+    switch (v.get_type())
+    {
+    case Variant::STRING :
+        lua_pushstring(L,((String)v).ascii().get_data());
+        break;
+    case Variant::INT :
+    case Variant::REAL :
+        lua_pushnumber(L, (lua_Number)v);
+        break;
+    case Variant::BOOL :
+        lua_pushboolean(L, v ? 1 : 0);
+        break;
+    case Variant::VECTOR2 : {
+        Vector2 v2 = v;
+        VM::pushVec2(L, v2.x, v2.y);
+        break;
+    }
+    case Variant::VECTOR3 : {
+        Vector3 v3 = v;
+        VM::pushVec3(L, v3.x, v3.y, v3.z);
+        break;
+    }
+    case Variant::QUAT : {
+        Quat q = v;
+        VM::pushQuat(L, q.x, q.y, q.z, q.w);
+        break;
+    }
+    case Variant::TRANSFORM : {
+        Transform t = v;
+        VM::Transform result;
+        for (int row = 0; row < 3; row++) {
+            for (int column = 0; column < 3; column++)
+                result.basis[row][column] = t.basis[row][column];
+            result.origin[row] = t.origin[row];
+        }
+        VM::pushTransform(L, result);
+        break;
+    }
+    case Variant::POOL_BYTE_ARRAY :
+    case Variant::POOL_INT_ARRAY :
+    case Variant::POOL_REAL_ARRAY :
+    case Variant::POOL_VECTOR2_ARRAY :
+    case Variant::POOL_VECTOR3_ARRAY :
+        lua_push_pool_view(L, v);
+        break;
+    case Variant::ARRAY :
+    case Variant::DICTIONARY : {
+        ConvertState state;
+        push_variant(L, v, state, nullptr);
+        break;
+    }
+    case Variant::NIL :        // Same as default behaviour
+    default:
+        lua_pushnil(L);
+        break;
+    }
+}
+
+void lua_push_variant_pooled (lua_State *L, const Variant &v, const void *owner) {
+    if (v.get_type() == Variant::ARRAY || v.get_type() == Variant::DICTIONARY) {
+        ConvertState state;
+        push_variant(L, v, state, owner);
+    } else
+        lua_push_variant(L, v);
+}
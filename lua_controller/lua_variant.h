@@ -0,0 +1,42 @@
+/**
+ * @file lua_variant.h
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Conversion between values on a Lua stack and Godot's Variant
+ * @date 2026-10-18
+ *
+ */
+#ifndef LUA_VARIANT_H
+#define LUA_VARIANT_H
+
+#include <LuaCpp.hpp>
+#include "core/variant.h"
+
+/**
+ * @brief Converts the value at idx to a Variant
+ *
+ * Strings, numbers and booleans are converted to their Variant types, and the
+ * vmath userdata to Vector2, Vector3, Quat and Transform. Views made by
+ * lua_push_pool_view() return their Pool array. A table whose keys are exactly
+ * 1..#t becomes an Array, any other table (the empty one included) a Dictionary,
+ * converted recursively up to 32 levels deep. A table inside itself, or past the
+ * 65536th table of one conversion, is converted to Nil, like any other value.
+ */
+Variant lua_to_variant (lua_State *L, int idx);
+
+/**
+ * @brief Pushes the Lua value equivalent to v, the reverse of lua_to_variant(). Pushes nil if there isn't one
+ *
+ * Pool arrays of bytes, ints, reals, Vector2 and Vector3 are pushed as views, without copying them.
+ * Arrays and Dictionaries are copied into new tables, up to 32 levels deep and 65536 tables.
+ * An Array or Dictionary inside itself is pushed as nil.
+ */
+void lua_push_variant (lua_State *L, const Variant &v);
+
+/**
+ * @brief Same as lua_push_variant(), but the tables of Arrays and Dictionaries are lent by the LuaCpp::LuaTablePool of L to owner
+ *
+ * The tables are cleared and reused after LuaCpp::LuaTablePool::Release(L, owner), unless the script keeps them.
+ */
+void lua_push_variant_pooled (lua_State *L, const Variant &v, const void *owner);
+
+#endif
@@ -4,12 +4,34 @@
 
 #include "core/class_db.h"
 #include "lua_controller.h"
+#include "lua_blackboard.h"
+#include "lua_script.h"
 #include "lua_controller_unit_tester.h"
+#include "lua_controller_benchmark.h"
+
+#ifdef TOOLS_ENABLED
+#include "core/io/resource_importer.h"
+#include "resource_importer_lua_script.h"
+
+static Ref<ResourceImporterLuaScript> lua_script_importer;
+#endif
 
 void register_lua_controller_types () {
     ClassDB::register_class<LuaController>();
+    ClassDB::register_class<LuaBlackboard>();
+    ClassDB::register_class<LuaScript>();
     ClassDB::register_class<LuaControllerUnitTester>();
+    ClassDB::register_class<LuaControllerBenchmark>();
+
+#ifdef TOOLS_ENABLED
+    lua_script_importer.instance();
+    ResourceFormatImporter::get_singleton()->add_importer(lua_script_importer);
+#endif
 }
 
 void unregister_lua_controller_types () {
+#ifdef TOOLS_ENABLED
+    ResourceFormatImporter::get_singleton()->remove_importer(lua_script_importer);
+    lua_script_importer.unref();
+#endif
 }
\ No newline at end of file
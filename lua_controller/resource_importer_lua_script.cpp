@@ -0,0 +1,78 @@
+/**
+ * @file resource_importer_lua_script.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @date 2026-10-18
+ *
+ */
+#include "resource_importer_lua_script.h"
+
+#ifdef TOOLS_ENABLED
+
+#include "core/io/resource_saver.h"
+#include "core/os/file_access.h"
+
+#include "lua_script.h"
+
+String ResourceImporterLuaScript::get_importer_name () const {
+    return "lua_script";
+}
+
+String ResourceImporterLuaScript::get_visible_name () const {
+    return "Lua Script";
+}
+
+void ResourceImporterLuaScript::get_recognized_extensions (List<String> *p_extensions) const {
+    p_extensions->push_back("lua");
+}
+
+String ResourceImporterLuaScript::get_save_extension () const {
+    return "res";
+}
+
+String ResourceImporterLuaScript::get_resource_type () const {
+    return "LuaScript";
+}
+
+int ResourceImporterLuaScript::get_preset_count () const {
+    return 0;
+}
+
+String ResourceImporterLuaScript::get_preset_name (int p_idx) const {
+    return String();
+}
+
+void ResourceImporterLuaScript::get_import_options (List<ImportOption> *r_options, int p_preset) const {
+    r_options->push_back(ImportOption(PropertyInfo(Variant::BOOL, "keep_source"), true));
+}
+
+bool ResourceImporterLuaScript::get_option_visibility (const String &p_option, const Map<StringName, Variant> &p_options) const {
+    return true;
+}
+
+Error ResourceImporterLuaScript::import (const String &p_source_file, const String &p_save_path, const Map<StringName, Variant> &p_options,
+        List<String> *r_platform_variants, List<String> *r_gen_files, Variant *r_metadata) {
+    Error err;
+    Vector<uint8_t> source = FileAccess::get_file_as_array(p_source_file, &err);
+    ERR_FAIL_COND_V_MSG(err != OK, err, "Can't read the Lua script " + p_source_file);
+
+    Ref<LuaScript> script;
+    script.instance();
+    String code;
+    code.parse_utf8((const char *)source.ptr(), source.size());
+    script->set_source_code(code);
+    // Named after the source file, so the errors of the exported script still point to it
+    if (script->compile("@" + p_source_file) != OK) {
+        ERR_PRINT("Can't import " + p_source_file + ": " + script->get_error_message());
+        return ERR_PARSE_ERROR;
+    }
+    bool keep_source = p_options["keep_source"];
+    if (!keep_source) {
+        PoolByteArray bytecode = script->get_bytecode();
+        script->set_source_code(String());
+        script->set_bytecode(bytecode);
+    }
+
+    return ResourceSaver::save(p_save_path + "." + get_save_extension(), script);
+}
+
+#endif // TOOLS_ENABLED
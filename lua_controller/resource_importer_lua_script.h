@@ -0,0 +1,48 @@
+/**
+ * @file resource_importer_lua_script.h
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Imports `.lua` files as LuaScript resources holding their bytecode
+ * @date 2026-10-18
+ *
+ * @details
+ * Only compiled in the editor. The scripts are compiled when imported, and
+ * exported as the `.res` saved by the importer: the exported game loads their
+ * bytecode without parsing them.
+ */
+#ifndef RESOURCE_IMPORTER_LUA_SCRIPT_H
+#define RESOURCE_IMPORTER_LUA_SCRIPT_H
+
+#ifdef TOOLS_ENABLED
+
+#include "core/io/resource_importer.h"
+
+class ResourceImporterLuaScript : public ResourceImporter {
+    GDCLASS(ResourceImporterLuaScript, ResourceImporter);
+
+public:
+    virtual String get_importer_name () const;
+    virtual String get_visible_name () const;
+    virtual void get_recognized_extensions (List<String> *p_extensions) const;
+    virtual String get_save_extension () const;
+    virtual String get_resource_type () const;
+
+    virtual int get_preset_count () const;
+    virtual String get_preset_name (int p_idx) const;
+
+    /**
+     * @brief Options: "keep_source", to also save the source code, so a build of Lua
+     * that can't load the bytecode can still compile the script
+     */
+    virtual void get_import_options (List<ImportOption> *r_options, int p_preset = 0) const;
+    virtual bool get_option_visibility (const String &p_option, const Map<StringName, Variant> &p_options) const;
+
+    /**
+     * @return ERR_PARSE_ERROR if the script doesn't compile, the error is printed
+     */
+    virtual Error import (const String &p_source_file, const String &p_save_path, const Map<StringName, Variant> &p_options,
+            List<String> *r_platform_variants, List<String> *r_gen_files = nullptr, Variant *r_metadata = nullptr);
+};
+
+#endif // TOOLS_ENABLED
+
+#endif // RESOURCE_IMPORTER_LUA_SCRIPT_H
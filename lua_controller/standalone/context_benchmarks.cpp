@@ -0,0 +1,121 @@
+/**
+ * @file context_benchmarks.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Throughput benchmarks of LuaControllerContext, outside of Godot
+ * @date 2026-10-18
+ *
+ * Usage: context_benchmarks [iterations] [results.json]
+ *
+ * Measures the same context operations as LuaControllerBenchmark, which
+ * also measures the crossings into Godot, plus the vmath kernels.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <LuaCpp.hpp>
+#include "LuaBenchmark.hpp"
+#include "LuaControllerContext.hpp"
+#include "LuaVectorMath.hpp"
+
+using namespace LuaCpp;
+using Benchmark::Measure;
+using Benchmark::Result;
+
+int main (int argc, char **argv) {
+	size_t iterations = argc > 1 ? (size_t) std::strtoul(argv[1], nullptr, 10) : 1000;
+	std::vector<Result> results;
+
+	struct StateCase {
+		const char *name;
+		int flags;
+		bool lazy;
+	};
+	const StateCase state_cases[] = {
+		{ "new_state/none", LIB_NONE, false },
+		{ "new_state/base", LIB_BASE, false },
+		{ "new_state/base_string_table_math", LIB_BASE | LIB_STRING | LIB_TABLE | LIB_MATH, false },
+		{ "new_state/all", LIB_ALL, false },
+		{ "new_state/all_lazy", LIB_ALL, true },
+	};
+	for (const StateCase &state_case : state_cases) {
+		LuaControllerContext ctx;
+		ctx.setLuaCoreLibraries(state_case.flags);
+		ctx.setLazyCoreLibraries(state_case.lazy);
+		results.push_back(Measure(state_case.name, iterations, [&]() { ctx.newState(); }));
+	}
+
+	// Each operation creates 100 states, split among the threads: with a lock free read path, the time falls with the threads
+	for (unsigned threads : { 1u, 2u, 4u, 8u }) {
+		LuaControllerContext ctx;
+		ctx.CompileString("default", "local x = 1");
+		results.push_back(Measure("new_state_for/100_states_" + std::to_string(threads) + "_threads", iterations / 10, [&]() {
+			std::vector<std::thread> workers;
+			for (unsigned t = 0; t < threads; t++) {
+				workers.emplace_back([&ctx, threads]() {
+					for (unsigned i = 0; i < 100 / threads; i++) {
+						ctx.newStateFor("default");
+					}
+				});
+			}
+			for (std::thread &worker : workers) {
+				worker.join();
+			}
+		}));
+	}
+
+	for (int lines : { 10, 100, 1000 }) {
+		LuaControllerContext ctx;
+		std::string script = Benchmark::GenerateScript(lines);
+		results.push_back(Measure("compile_string/" + std::to_string(lines) + "_lines", iterations,
+			[&]() { ctx.CompileString("benchmark", script, true); }));
+	}
+
+	{
+		LuaControllerContext ctx;
+		ctx.CompileString("default", "local x = 1");
+		results.push_back(Measure("run/trivial", iterations, [&]() { ctx.Run("default"); }));
+	}
+	{
+		LuaControllerContext ctx;
+		ctx.AddGlobalVariable("answer", std::make_shared<Engine::LuaTNumber>(42));
+		ctx.CompileString("default", "local x = 0 for i = 1, 1000 do x = x + answer end");
+		results.push_back(Measure("run/1000_global_reads", iterations, [&]() { ctx.Run("default"); }));
+	}
+	{
+		LuaControllerContext ctx;
+		std::shared_ptr<Registry::LuaLibrary> vmath = newVectorMathLibrary();
+		ctx.AddLibrary(vmath);
+		ctx.setKeepState(true);
+		ctx.CompileString("setup",
+			"positions = vmath.vec3_array(10000) velocities = vmath.vec3_array(10000) "
+			"velocities:fill(vmath.vec3(1, 2, 3)) rotation = vmath.transform(vmath.quat(vmath.vec3(0, 1, 0), 0.01), vmath.vec3())");
+		ctx.Run("setup");
+		ctx.CompileString("integrate", "positions:integrate(velocities, 0.016)");
+		results.push_back(Measure("vmath/integrate_10000_vec3", iterations, [&]() { ctx.Run("integrate"); }));
+		ctx.CompileString("transform", "positions:transform(rotation)");
+		results.push_back(Measure("vmath/transform_10000_vec3", iterations, [&]() { ctx.Run("transform"); }));
+		ctx.CompileString("scalar",
+			"local p, v = vmath.vec3(), vmath.vec3(1, 2, 3) for i = 1, 10000 do p = p + v * 0.016 end");
+		results.push_back(Measure("vmath/scalar_10000_vec3_ops", iterations, [&]() { ctx.Run("scalar"); }));
+	}
+
+	for (const Result &r : results) {
+		printf("%-40s median %10.3f usec   p99 %10.3f usec   %12.1f ops/s\n",
+			r.name.c_str(), r.median_usec, r.p99_usec, r.ops_per_sec);
+	}
+	if (argc > 2) {
+		std::ofstream out(argv[2]);
+		out << Benchmark::ToJson(results);
+		if (!out) {
+			std::cerr << "Couldn't save the results to " << argv[2] << std::endl;
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,608 @@
+/**
+ * @file context_tests.cpp
+ * @author Rodrigo Leite (you@domain.com)
+ * @brief Unit tests of LuaControllerContext and the other Godot-free classes, outside of Godot
+ * @date 2026-10-18
+ *
+ * The tests that need Godot, or private members, are in LuaControllerUnitTester.
+ */
+
+#include <atomic>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <LuaCpp.hpp>
+#include "LuaControllerContext.hpp"
+#include "LuaVectorMath.hpp"
+#include "LuaBlackboard.hpp"
+#include "LuaChannel.hpp"
+#include "LuaTablePool.hpp"
+#include "LuaCheckpoint.hpp"
+#include "LuaSnapshot.hpp"
+#include "LuaSamplingProfiler.hpp"
+#include "LuaTracer.hpp"
+
+using namespace LuaCpp;
+
+namespace {
+	int test_count = 0;
+	int failure_count = 0;
+	std::string test_name;
+
+	/**
+	 * @brief Compiles and runs code on ctx, returning the error message, or "" on success
+	 */
+	std::string run (LuaControllerContext &ctx, const std::string &code) {
+		try {
+			ctx.CompileString("default", code, true);
+			ctx.Run("default");
+		} catch (std::exception &e) {
+			return e.what();
+		}
+		return "";
+	}
+
+	/* Finds the module "greeting" without any file */
+	int greeting_searcher (lua_State *L) {
+		if (std::string(luaL_checkstring(L, 1)) != "greeting") {
+			lua_pushliteral(L, "\n\tnot the greeting module");
+			return 1;
+		}
+		luaL_loadstring(L, "return { text = 'hello' }");
+		return 1;
+	}
+}
+
+/**
+ * Same convention as LuaControllerUnitTester: if the condition is true, it's a failure
+ */
+#define NEW_TEST(name) \
+	test_count++; \
+	test_name = name;
+
+#define UNIT_ASSERT(cond, msg) \
+	if ( ( cond ) ) { \
+		failure_count++; \
+		std::cerr << "[FAILURE] TEST " << test_count << " '" << test_name << "' : " << msg << std::endl; \
+	}
+
+int main () {
+	{
+		NEW_TEST("Compile and run");
+		LuaControllerContext ctx;
+		std::string err = run(ctx, "local x = 1 + 1 assert(x == 2)");
+		UNIT_ASSERT( !err.empty(), err );
+		err = run(ctx, "error('expected')");
+		UNIT_ASSERT( err.find("expected") == std::string::npos, "A runtime error wasn't reported" );
+		bool raised = false;
+		try {
+			ctx.CompileString("broken", "local = 1");
+		} catch (std::logic_error &e) {
+			raised = true;
+		}
+		UNIT_ASSERT( !raised, "A syntax error wasn't reported" );
+	}
+	{
+		NEW_TEST("keep_state and isolated runs");
+		LuaControllerContext ctx;
+		ctx.CompileString("default", "counter = (counter or 0) + 1 assert(counter <= 2)");
+		ctx.setKeepState(true);
+		ctx.Run("default");
+		bool raised = false;
+		try {
+			ctx.Run("default");
+			ctx.Run("default");
+		} catch (std::runtime_error &e) {
+			raised = true;
+		}
+		UNIT_ASSERT( !raised, "The variables weren't kept between runs" );
+		ctx.setKeepState(false);
+		std::string err = run(ctx, "assert(counter == nil)");
+		UNIT_ASSERT( !err.empty(), "The variables were kept with keep_state false: " + err );
+	}
+	{
+		NEW_TEST("Global variables");
+		LuaControllerContext ctx;
+		ctx.AddGlobalVariable("answer", std::make_shared<Engine::LuaTNumber>(42));
+		std::string err = run(ctx, "assert(answer == 42)");
+		UNIT_ASSERT( !err.empty(), err );
+		// Assigned values are read back into the variable, and seen by the next runs
+		err = run(ctx, "answer = 7");
+		UNIT_ASSERT( !err.empty(), err );
+		auto answer = std::static_pointer_cast<Engine::LuaTNumber>(ctx.getGlobalVariable("answer"));
+		UNIT_ASSERT( answer->getValue() != 7, "The assigned value wasn't read back" );
+		err = run(ctx, "assert(answer == 7)");
+		UNIT_ASSERT( !err.empty(), err );
+		// The new value is published to the states created afterwards
+		std::unique_ptr<Engine::LuaState> state = ctx.newState();
+		lua_getglobal(*state, "answer");
+		UNIT_ASSERT( lua_tointeger(*state, -1) != 7, "The assigned value wasn't published" );
+		state.reset();
+		err = run(ctx, "answer = 'text'");
+		UNIT_ASSERT( err.empty(), "A value of the wrong type was read back" );
+		ctx.RemoveGlobalVariable("answer");
+		UNIT_ASSERT( ctx.getGlobalVariable("answer") != nullptr, "A removed global variable was still found" );
+		err = run(ctx, "assert(answer == nil)");
+		UNIT_ASSERT( !err.empty(), "A removed global variable was still visible: " + err );
+	}
+	{
+		NEW_TEST("Lazy core libraries");
+		LuaControllerContext ctx;
+		ctx.setLazyCoreLibraries(true);
+		std::string err = run(ctx, "assert(rawget(_G, 'math') == nil) assert(math.max(1, 2) == 2) assert(rawget(_G, 'math'))");
+		UNIT_ASSERT( !err.empty(), err );
+		ctx.setLuaCoreLibraries(LIB_BASE);
+		err = run(ctx, "assert(math == nil)");
+		UNIT_ASSERT( !err.empty(), "A library that wasn't selected was opened: " + err );
+	}
+	{
+		NEW_TEST("Package searchers");
+		LuaControllerContext ctx;
+		ctx.AddPackageSearcher(greeting_searcher);
+		std::string err = run(ctx, "assert(require('greeting').text == 'hello')");
+		UNIT_ASSERT( !err.empty(), err );
+		ctx.setLazyCoreLibraries(true);
+		err = run(ctx, "assert(require('greeting').text == 'hello')");
+		UNIT_ASSERT( !err.empty(), "The searcher wasn't added with lazy libraries: " + err );
+	}
+	{
+		NEW_TEST("Snippets compiled on another thread");
+		LuaControllerContext ctx;
+		ctx.setKeepState(true);
+		ctx.CompileString("default", "version = 1");
+		std::shared_ptr<const LuaSnippet> snippet;
+		std::thread worker([&]() { snippet = LuaSnippetRegistry::CompileString("default", "version = 2"); });
+		worker.join();
+		std::shared_ptr<const LuaSnippet> old = ctx.getSnippet("default");
+		ctx.AddSnippet(snippet);
+		UNIT_ASSERT( ctx.getSnippet("default") != snippet, "The snippet wasn't replaced" );
+		UNIT_ASSERT( old == nullptr || old->bytecode.empty(), "The replaced snippet didn't stay alive" );
+		ctx.Run("default");
+		std::string err = run(ctx, "assert(version == 2)");
+		UNIT_ASSERT( !err.empty(), "The new snippet wasn't run: " + err );
+		bool raised = false;
+		try {
+			LuaSnippetRegistry::CompileString("broken", "local = 1");
+		} catch (std::logic_error &e) {
+			raised = true;
+		}
+		UNIT_ASSERT( !raised, "A syntax error wasn't reported" );
+	}
+	{
+		NEW_TEST("LuaSnapshot readers and writers");
+		LuaSnapshot<std::vector<int>> snapshot(std::vector<int>{ 0 });
+		std::atomic<bool> done(false);
+		std::atomic<int> torn(0);
+		std::vector<std::thread> readers;
+		for (int t = 0; t < 4; t++) {
+			readers.emplace_back([&]() {
+				while (!done) {
+					LuaSnapshot<std::vector<int>>::Reader values(snapshot);
+					// Every published vector holds 0..n-1, a freed or half written one wouldn't
+					for (size_t i = 0; i < values->size(); i++) {
+						if ((*values)[i] != (int) i) {
+							torn++;
+						}
+					}
+				}
+			});
+		}
+		for (int i = 1; i < 500; i++) {
+			snapshot.Update([i] (std::vector<int> &values) { values.push_back(i); });
+		}
+		done = true;
+		for (std::thread &reader : readers) {
+			reader.join();
+		}
+		LuaSnapshot<std::vector<int>>::Reader values(snapshot);
+		UNIT_ASSERT( torn > 0, "A reader saw a vector being changed or freed" );
+		UNIT_ASSERT( values->size() != 500, "An update was lost" );
+	}
+	{
+		NEW_TEST("newStateFor() on many threads while the snippet is replaced");
+		LuaControllerContext ctx;
+		ctx.AddGlobalVariable("answer", std::make_shared<Engine::LuaTNumber>(42));
+		ctx.CompileString("default", "return answer");
+		std::atomic<bool> done(false);
+		std::atomic<int> failures(0);
+		std::atomic<int> created(0);
+		std::vector<std::thread> workers;
+		for (int t = 0; t < 4; t++) {
+			workers.emplace_back([&]() {
+				while (!done || created < 100) {
+					try {
+						std::unique_ptr<Engine::LuaState> L = ctx.newStateFor("default");
+						if (lua_pcall(*L, 0, 1, 0) != LUA_OK || lua_tointeger(*L, -1) != 42) {
+							failures++;
+						}
+						created++;
+					} catch (std::exception &e) {
+						failures++;
+					}
+				}
+			});
+		}
+		for (int i = 0; i < 200; i++) {
+			ctx.CompileString("default", "return answer + " + std::to_string(i) + " * 0", true);
+			ctx.AddGlobalVariable("other" + std::to_string(i % 10), std::make_shared<Engine::LuaTNumber>(i));
+		}
+		done = true;
+		for (std::thread &worker : workers) {
+			worker.join();
+		}
+		UNIT_ASSERT( failures > 0, "A state failed to be created or to run: " + std::to_string(failures) );
+		const LuaMemoryStats &stats = ctx.getMemoryStats();
+		UNIT_ASSERT( stats.current_bytes != 0, "The closed states left bytes accounted for: " + std::to_string(stats.current_bytes) );
+		UNIT_ASSERT( stats.allocations == 0, "The allocations of the other threads weren't counted" );
+	}
+	{
+		NEW_TEST("Parallel compilation with CompileAll()");
+		LuaControllerContext ctx;
+		std::vector<std::pair<std::string, std::string>> sources;
+		for (int i = 0; i < 100; i++) {
+			sources.emplace_back("snippet" + std::to_string(i), "return " + std::to_string(i));
+		}
+		sources.emplace_back("broken", "return return");
+		std::map<std::string, std::string> errors = ctx.CompileAll(sources, 4);
+		UNIT_ASSERT( errors.size() != 1 || errors.count("broken") == 0, "Only the broken snippet should fail" );
+		UNIT_ASSERT( ctx.getSnippetNames().size() != 100, "The snippets that compiled weren't added" );
+		UNIT_ASSERT( ctx.getSnippet("snippet99") == nullptr, "snippet99 wasn't added" );
+	}
+	{
+		NEW_TEST("Garbage collector and memory statistics");
+		LuaControllerContext ctx;
+		ctx.setGCAutomatic(false);
+		ctx.setKeepState(true);
+		std::string err = run(ctx, "for i = 1, 1000 do local t = { i } end");
+		UNIT_ASSERT( !err.empty(), err );
+		UNIT_ASSERT( !ctx.StepGC(100000), "StepGC() didn't finish a cycle" );
+		const LuaMemoryStats &stats = ctx.getMemoryStats();
+		UNIT_ASSERT( stats.current_bytes <= 0, "No memory was accounted for" );
+		UNIT_ASSERT( stats.current_bytes != ctx.getRunStateBytes(), "The allocator and LUA_GCCOUNT disagree" );
+		UNIT_ASSERT( stats.gc_cycles == 0, "The finished cycle wasn't counted" );
+	}
+	{
+		NEW_TEST("vmath library");
+		LuaControllerContext ctx;
+		std::shared_ptr<Registry::LuaLibrary> vmath = newVectorMathLibrary();
+		ctx.AddLibrary(vmath);
+		std::string err = run(ctx,
+			"local a = vmath.vec3(1, 2, 3) "
+			"assert(a + a == a * 2 and 2 * a == a * 2 and a:length_squared() == 14) "
+			"assert(not pcall(vmath.vec3_array, 1 << 62)) "
+			"assert(vmath.vec2(0, 0) ~= vmath.vec3(0, 0, 0) and vmath.quat(0, 0, 0, 1) ~= vmath.transform()) "
+			"local points = vmath.vec3_array(9) "
+			"points:fill(a) "
+			"points:transform(vmath.transform():translated(a)) "
+			"assert(points[9] == a * 2)");
+		UNIT_ASSERT( !err.empty(), err );
+	}
+	{
+		NEW_TEST("Blackboard");
+		std::shared_ptr<LuaBlackboard> blackboard = std::make_shared<LuaBlackboard>();
+		int health = blackboard->Intern("health");
+		blackboard->SetInt(health, 100);
+		blackboard->SetVec3(blackboard->Intern("target"), 1, 2, 3);
+		Engine::LuaState L;
+		luaL_openlibs(L);
+		pushBlackboard(L, blackboard);
+		lua_setglobal(L, "blackboard");
+		int res = luaL_dostring(L,
+			"local health = blackboard('health') "
+			"assert(blackboard[health] == 100 and blackboard.health == 100) "
+			"assert(blackboard.target.z == 3 and blackboard.missing == nil) "
+			"blackboard[health] = blackboard[health] - 1.5 "
+			"blackboard.name = 'orc' "
+			"assert(not pcall(function () blackboard.bad = {} end)) "
+			"assert(#blackboard == 3)");
+		UNIT_ASSERT( res != LUA_OK, lua_tostring(L, -1) );
+		UNIT_ASSERT( blackboard->getSlot(health).type != LuaBlackboard::SLOT_FLOAT || blackboard->getFloat(health) != 98.5,
+			"The float written by Lua wasn't stored" );
+		UNIT_ASSERT( blackboard->getString(blackboard->Find("name")) != "orc", "The string written by Lua wasn't stored" );
+		UNIT_ASSERT( blackboard->Find("bad") < 0 || blackboard->getSlot(blackboard->Find("bad")).type != LuaBlackboard::SLOT_NIL,
+			"A table was stored" );
+	}
+	{
+		NEW_TEST("RunChecked() statuses and error details");
+		LuaControllerContext ctx;
+		UNIT_ASSERT( ctx.RunChecked("missing") != RUN_ERROR_NOT_FOUND, "A missing snippet was run" );
+		ctx.CompileString("fails", "local x = 1\nlocal function f () error('deep') end\nf()");
+		UNIT_ASSERT( ctx.RunChecked("fails") != RUN_ERROR_RUNTIME, "The error wasn't reported" );
+		UNIT_ASSERT( ctx.getLastError().message.find("deep") == std::string::npos, ctx.getLastError().message );
+		UNIT_ASSERT( ctx.getLastError().line != -1 || !ctx.getLastError().traceback.empty(), "Details were captured while disabled" );
+		ctx.setErrorDetails(true);
+		UNIT_ASSERT( ctx.RunChecked("fails") != RUN_ERROR_RUNTIME, "The error wasn't reported" );
+		const LuaRunError &error = ctx.getLastError();
+		UNIT_ASSERT( error.line != 2, "Wrong line: " + std::to_string(error.line) );
+		UNIT_ASSERT( error.message.find("stack traceback") != std::string::npos, "The message holds the traceback" );
+		UNIT_ASSERT( error.traceback.find("stack traceback") == std::string::npos || error.traceback.find("'f'") == std::string::npos,
+			"Wrong traceback: " + error.traceback );
+		ctx.CompileString("table_error", "error({})");
+		UNIT_ASSERT( ctx.RunChecked("table_error") != RUN_ERROR_RUNTIME || ctx.getLastError().message.find("table value") == std::string::npos,
+			"A non-string error wasn't described: " + ctx.getLastError().message );
+		ctx.CompileString("passes", "return 1");
+		UNIT_ASSERT( ctx.RunChecked("passes") != RUN_OK, ctx.getLastError().message );
+		bool raised = false;
+		try {
+			ctx.Run("fails");
+		} catch (std::runtime_error &e) {
+			raised = std::string(e.what()).find("deep") != std::string::npos;
+		}
+		UNIT_ASSERT( !raised, "Run() didn't throw the message" );
+	}
+	{
+		NEW_TEST("RunBatch() with an environment per run");
+		LuaControllerContext ctx;
+		ctx.AddGlobalVariable("total", std::make_shared<Engine::LuaTNumber>(0));
+		ctx.CompileString("entity", "assert(seen == nil) seen = true if id == 2 then error('bad entity') end total = total + 1 return id * 10");
+		std::vector<long long> returned;
+		std::vector<RunStatus> statuses;
+		RunStatus status = ctx.RunBatch("entity", 4,
+			[](lua_State *L, size_t index) {
+				lua_pushinteger(L, (lua_Integer) index);
+				lua_setfield(L, -2, "id");
+			},
+			[&](lua_State *L, size_t index, RunStatus run_status, int env, int nresults) {
+				statuses.push_back(run_status);
+				returned.push_back(nresults == 1 ? (long long) lua_tointeger(L, -1) : -1);
+				lua_getfield(L, env, "seen");
+				UNIT_ASSERT( run_status == RUN_OK && !lua_toboolean(L, -1), "The environment isn't passed to the result" );
+				lua_pop(L, 1);
+			});
+		UNIT_ASSERT( status != RUN_OK, ctx.getLastError().message );
+		UNIT_ASSERT( returned.size() != 4 || returned[0] != 0 || returned[3] != 30, "Wrong results" );
+		UNIT_ASSERT( statuses.size() != 4 || statuses[2] != RUN_ERROR_RUNTIME || statuses[3] != RUN_OK, "A failure stopped the batch" );
+		UNIT_ASSERT( std::static_pointer_cast<Engine::LuaTNumber>(ctx.getGlobalVariable("total"))->getValue() != 3,
+			"The global variable assigned by the runs wasn't read back" );
+		UNIT_ASSERT( ctx.RunBatch("missing", 1, [](lua_State *, size_t) {}, [](lua_State *, size_t, RunStatus, int, int) {}) != RUN_ERROR_NOT_FOUND,
+			"A missing snippet was run" );
+	}
+	{
+		NEW_TEST("Checkpoint() and Restore()");
+		std::shared_ptr<Registry::LuaLibrary> vmath = newVectorMathLibrary();
+		LuaControllerContext ctx;
+		ctx.AddLibrary(vmath);
+		bool raised = false;
+		try {
+			ctx.Checkpoint();
+		} catch (std::runtime_error &) {
+			raised = true;
+		}
+		UNIT_ASSERT( !raised, "Checkpoint() didn't need keep_state" );
+
+		ctx.setKeepState(true);
+		std::string err = run(ctx,
+			"local count = 0 "
+			"counter = { step = function () count = count + 1 return count end, "
+			"            peek = function () return count end } "
+			"node = { name = 'root', at = vmath.vec3(1, 2, 3), big = 1 << 62, half = 0.5 } "
+			"node.self = node "
+			"list = { node, node } "
+			"floor = math.floor "
+			"setmetatable(list, { __index = function () return 'missing' end }) "
+			"counter.step() counter.step()");
+		UNIT_ASSERT( !err.empty(), err );
+		std::string checkpoint;
+		try {
+			checkpoint = ctx.Checkpoint();
+		} catch (std::runtime_error &e) {
+			UNIT_ASSERT( true, e.what() );
+		}
+		err = run(ctx, "counter.step() node = nil extra = true");
+		UNIT_ASSERT( !err.empty(), err );
+
+		std::string check =
+			"assert(extra == nil and node.self == node and list[1] == node and list[2] == node) "
+			"assert(node.at == vmath.vec3(1, 2, 3) and node.big == 1 << 62 and math.type(node.big) == 'integer' and node.half == 0.5) "
+			"assert(floor == math.floor and list[3] == 'missing') "
+			"assert(counter.peek() == 2 and counter.step() == 3 and counter.peek() == 3)";
+		try {
+			ctx.Restore(checkpoint);
+		} catch (std::runtime_error &e) {
+			UNIT_ASSERT( true, e.what() );
+		}
+		err = run(ctx, check);
+		UNIT_ASSERT( !err.empty(), err );
+
+		// Into a fresh state of another context
+		LuaControllerContext other;
+		other.AddLibrary(vmath);
+		other.setKeepState(true);
+		try {
+			other.Restore(checkpoint);
+		} catch (std::runtime_error &e) {
+			UNIT_ASSERT( true, e.what() );
+		}
+		err = run(other, check);
+		UNIT_ASSERT( !err.empty(), err );
+
+		// A value that can't be saved leaves the environment as it was
+		err = run(ctx, "worker = coroutine.create(print)");
+		UNIT_ASSERT( !err.empty(), err );
+		raised = false;
+		try {
+			ctx.Checkpoint();
+		} catch (std::runtime_error &e) {
+			raised = std::string(e.what()).find("worker") != std::string::npos;
+		}
+		UNIT_ASSERT( !raised, "A coroutine was saved, or the error doesn't name it" );
+		raised = false;
+		try {
+			ctx.Restore(checkpoint.substr(0, checkpoint.size() / 2));
+		} catch (std::runtime_error &) {
+			raised = true;
+		}
+		UNIT_ASSERT( !raised, "A truncated checkpoint was restored" );
+		raised = false;
+		try {
+			std::string corrupted = checkpoint;
+			corrupted[corrupted.size() - 1] ^= 1;
+			ctx.Restore(corrupted);
+		} catch (std::runtime_error &) {
+			raised = true;
+		}
+		UNIT_ASSERT( !raised, "A corrupted checkpoint was restored" );
+		err = run(ctx, "assert(worker ~= nil)");
+		UNIT_ASSERT( !err.empty(), err );
+	}
+	{
+		NEW_TEST("Channels between states");
+		LuaControllerContext producer;
+		LuaControllerContext consumer;
+		std::shared_ptr<Registry::LuaLibrary> vmath = newVectorMathLibrary();
+		std::shared_ptr<Registry::LuaLibrary> channels = newChannelLibrary();
+		for (LuaControllerContext *ctx : { &producer, &consumer }) {
+			ctx->AddLibrary(vmath);
+			ctx->AddLibrary(channels);
+		}
+		std::string err = run(producer,
+			"local ch = channel.open('context_tests', 4) "
+			"assert(ch:capacity() == 4) "
+			"assert(ch:post({ id = -300, name = 'orc', at = vmath.vec3(1, 2, 3), path = { 1.5, true } })) "
+			"assert(ch:post(nil) and ch:post(1 << 62) and ch:post('last')) "
+			"assert(not ch:post('full')) "
+			"assert(not pcall(ch.post, ch, print)) "
+			"local cycle = {} cycle.self = cycle "
+			"assert(not pcall(ch.post, ch, cycle)) "
+			"local doubled = {} for i = 1, 30 do doubled = { doubled, doubled } end "
+			"assert(not pcall(ch.post, ch, doubled)) "
+			"assert(not pcall(channel.open, 'context_tests_huge', 1 << 62))");
+		UNIT_ASSERT( !err.empty(), err );
+		err = run(consumer,
+			"local ch = channel.open('context_tests') "
+			"assert(#ch == 4) "
+			"local ok, m = ch:receive() "
+			"assert(ok and m.id == -300 and m.name == 'orc' and m.at == vmath.vec3(1, 2, 3)) "
+			"assert(m.path[1] == 1.5 and m.path[2] == true) "
+			"ok, m = ch:receive() assert(ok and m == nil) "
+			"ok, m = ch:receive() assert(ok and m == 1 << 62 and math.type(m) == 'integer') "
+			"ok, m = ch:receive() assert(ok and m == 'last') "
+			"assert(not ch:receive())");
+		UNIT_ASSERT( !err.empty(), err );
+		LuaChannel::Remove("context_tests");
+
+		// Several threads posting to one channel, while another receives
+		const int producers = 4;
+		const int messages = 10000;
+		LuaChannel channel(64);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < producers; t++) {
+			threads.emplace_back([&channel, t]() {
+				std::string message;
+				for (int i = 0; i < messages; i++) {
+					message.assign(1, (char) t);
+					while (!channel.Post(message)) {
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+		int received[producers] = { 0 };
+		std::string message;
+		for (int total = 0; total < producers * messages; ) {
+			if (channel.Receive(message)) {
+				received[(int) message[0]]++;
+				total++;
+			}
+		}
+		for (std::thread &thread : threads) {
+			thread.join();
+		}
+		for (int t = 0; t < producers; t++) {
+			UNIT_ASSERT( received[t] != messages, "Messages were lost or duplicated" );
+		}
+		UNIT_ASSERT( channel.Size() != 0, "The channel isn't empty" );
+	}
+	{
+		NEW_TEST("Table pool");
+		LuaControllerContext ctx;
+		std::shared_ptr<Registry::LuaLibrary> tables = newTablePoolLibrary();
+		ctx.AddLibrary(tables);
+		std::string err = run(ctx, "assert(not pcall(tables.keep, 1))");
+		UNIT_ASSERT( !err.empty(), err );
+
+		Engine::LuaState L;
+		int owner = 0;
+		LuaTablePool::Acquire(L, &owner, 4, 0);
+		const void *table = lua_topointer(L, -1);
+		for (int i = 1; i <= 4; i++) {
+			lua_pushinteger(L, i);
+			lua_rawseti(L, -2, i);
+		}
+		lua_newtable(L);
+		lua_setmetatable(L, -2);
+		lua_pop(L, 1);
+		LuaTablePool::Release(L, &owner);
+		UNIT_ASSERT( LuaTablePool::FreeCount(L) != 1, "The table wasn't returned to the free list" );
+		LuaTablePool::Acquire(L, &owner);
+		UNIT_ASSERT( lua_topointer(L, -1) != table, "The table wasn't reused" );
+		UNIT_ASSERT( lua_rawlen(L, -1) != 0 || lua_getmetatable(L, -1), "The table wasn't cleared" );
+		lua_settop(L, 0);
+		LuaTablePool::Release(L, &owner);
+
+		// A table in a kept table is kept too
+		LuaTablePool::Acquire(L, &owner);
+		LuaTablePool::Acquire(L, &owner);
+		lua_setfield(L, -2, "inner");
+		LuaTablePool::Keep(L, -1);
+		lua_pop(L, 1);
+		LuaTablePool::Release(L, &owner);
+		UNIT_ASSERT( LuaTablePool::FreeCount(L) != 0, "A kept table was returned to the free list" );
+		UNIT_ASSERT( lua_gettop(L) != 0, "The stack wasn't left as it was" );
+
+		// A forgotten owner has no list left
+		int other_owner = 0;
+		LuaTablePool::Acquire(L, &other_owner);
+		lua_pop(L, 1);
+		LuaTablePool::Forget(L, &other_owner);
+		UNIT_ASSERT( LuaTablePool::FreeCount(L) != 1, "The forgotten owner's table wasn't released" );
+		lua_getfield(L, LUA_REGISTRYINDEX, TABLE_POOL_KEY);
+		lua_rawgeti(L, -1, 2);  // The lists of the owners
+		UNIT_ASSERT( lua_rawgetp(L, -1, &other_owner) != LUA_TNIL, "The forgotten owner's list was kept" );
+		lua_settop(L, 0);
+	}
+	{
+		NEW_TEST("Sampling profiler");
+		LuaControllerContext ctx;
+		ctx.StartProfiler(LuaSamplingProfiler::MIN_SAMPLE_PERIOD_USEC, 100);
+		std::string err = run(ctx, "local function busy () local x = 0 for i = 1, 2000000 do x = x + i end end busy()");
+		ctx.StopProfiler();
+		UNIT_ASSERT( !err.empty(), err );
+		UNIT_ASSERT( ctx.getProfiler()->getSampleCount() == 0, "No samples were taken" );
+		UNIT_ASSERT( ctx.getProfiler()->getFoldedStacks().find(";busy (") == std::string::npos, "busy wasn't sampled" );
+	}
+	{
+		NEW_TEST("Tracer");
+		LuaTracer::Clear();
+		LuaTracer::setEnabled(true);
+		LuaControllerContext ctx;
+		std::string err = run(ctx, "local x = 1");
+		std::thread worker([]() { LUA_TRACE_SCOPE("worker \"scope\""); });
+		worker.join();
+		LuaTracer::setEnabled(false);
+		run(ctx, "local y = 2");
+		std::string json = LuaTracer::FlushChromeJson();
+		UNIT_ASSERT( !err.empty(), err );
+		UNIT_ASSERT( json.find("{\"name\":\"newState\",\"cat\":\"lua\",\"ph\":\"B\"") == std::string::npos, "newState wasn't traced: " + json );
+		UNIT_ASSERT( json.find("\"name\":\"run\",\"cat\":\"lua\",\"ph\":\"E\"") == std::string::npos, "The run wasn't traced: " + json );
+		UNIT_ASSERT( json.find("\"name\":\"worker \\\"scope\\\"\"") == std::string::npos, "The other thread wasn't traced: " + json );
+		UNIT_ASSERT( json.find("\"tid\":1}") == std::string::npos || json.find("\"tid\":2}") == std::string::npos,
+			"The threads weren't told apart: " + json );
+		UNIT_ASSERT( LuaTracer::FlushChromeJson().find("\"ph\"") != std::string::npos, "The flush didn't remove the events" );
+		// The ring of the finished thread was removed, and its id is given to the next thread
+		LuaTracer::setEnabled(true);
+		std::thread next([]() { LUA_TRACE_SCOPE("next"); });
+		next.join();
+		LuaTracer::setEnabled(false);
+		json = LuaTracer::FlushChromeJson();
+		UNIT_ASSERT( json.find("\"tid\":2}") == std::string::npos || json.find("\"tid\":3}") != std::string::npos,
+			"The id of the finished thread wasn't reused: " + json );
+	}
+
+	std::cout << test_count << " tests, " << failure_count << " failures" << std::endl;
+	return failure_count == 0 ? 0 : 1;
+}
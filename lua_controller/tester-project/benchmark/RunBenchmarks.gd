@@ -0,0 +1,24 @@
+# Runs LuaControllerBenchmark and saves the results as JSON
+# Usage: $GODOT_BIN --no-window -s res://benchmark/RunBenchmarks.gd [--iterations=N] [--output=path]
+extends SceneTree
+
+func _init():
+	var iterations := 1000
+	var output := "user://benchmark.json"
+	for arg in OS.get_cmdline_args():
+		if arg.begins_with("--iterations="):
+			iterations = int(arg.split("=")[1])
+		elif arg.begins_with("--output="):
+			output = arg.split("=")[1]
+
+	var benchmark := LuaControllerBenchmark.new()
+	var results : Dictionary = benchmark.run_benchmarks(iterations)
+	for name in results["results"]:
+		var result : Dictionary = results["results"][name]
+		print("%-40s median %10.3f usec   p99 %10.3f usec   %12.1f ops/s" % [name, result["median_usec"], result["p99_usec"], result["ops_per_sec"]])
+	if benchmark.save_results(output) != OK:
+		printerr("Couldn't save the results to ", output)
+	else:
+		print("Results saved to ", ProjectSettings.globalize_path(output))
+	benchmark.free()
+	quit()
@@ -0,0 +1,150 @@
+# Spawns N StressControllers, runs each once per frame, and saves the frame times,
+# the time spent in Lua and the memory used to a CSV, one line per node count
+# Usage: $GODOT_BIN --no-window -s res://benchmark/RunStress.gd [--nodes=100,1000,10000] [--frames=300] [--warmup=30] [--output=path]
+extends SceneTree
+
+const STRESS_CODE := """
+local position = get_position()
+local offset = get_target() - position
+local distance = offset:length()
+if distance < 1 then
+	set_velocity(vmath.vec2(0, 0))
+else
+	local speed = math.min(distance, 100)
+	set_velocity(offset:normalized() * speed)
+end
+"""
+
+const CSV_HEADER := "nodes,frames,frame_p50_ms,frame_p95_ms,frame_p99_ms,frame_max_ms,lua_mean_ms,lua_p99_ms,static_memory_mb,lua_memory_mb,lua_peak_mb,gc_cycles,errors"
+
+var node_counts := [100, 1000, 10000]
+var frames := 300
+var warmup := 30
+var output := "user://stress.csv"
+
+var script : LuaScript
+var controllers := []
+var frame_stats := {"lua_usec": 0, "errors": 0}
+var frame_usec := []
+var lua_usec := []
+var errors := 0
+var current := -1
+var frame := 0
+var last_tick := 0
+var gc_cycles_start := 0
+var lines := PoolStringArray([CSV_HEADER])
+
+func _init():
+	for arg in OS.get_cmdline_args():
+		if arg.begins_with("--nodes="):
+			node_counts = []
+			for count in arg.split("=")[1].split(","):
+				node_counts.append(int(count))
+		elif arg.begins_with("--frames="):
+			frames = int(arg.split("=")[1])
+		elif arg.begins_with("--warmup="):
+			warmup = int(arg.split("=")[1])
+		elif arg.begins_with("--output="):
+			output = arg.split("=")[1]
+
+	# Every controller shares the same compiled script
+	script = LuaScript.new()
+	script.set_source_code(STRESS_CODE)
+	if script.compile("=stress") != OK:
+		printerr("Couldn't compile the stress script: ", script.get_error_message())
+		quit(1)
+		return
+	connect("idle_frame", self, "_on_idle_frame")
+	_next_count()
+
+func _next_count():
+	for controller in controllers:
+		controller.queue_free()
+	controllers.clear()
+	current += 1
+	if current >= node_counts.size():
+		_save()
+		return
+
+	var stress_controller := load("res://benchmark/StressController.gd")
+	var count : int = node_counts[current]
+	for i in count:
+		var controller : LuaController = stress_controller.new()
+		controller.frame_stats = frame_stats
+		controller.position = Vector2(i % 100, i / 100) * 10.0
+		controller.target = Vector2(500, 500)
+		root.add_child(controller)
+		controller.set_lua_script(script)
+		if controller.compile() != OK:
+			printerr("Couldn't compile controller ", i, ": ", controller.get_error_message())
+		controllers.append(controller)
+	frame = 0
+	errors = 0
+	frame_usec.clear()
+	lua_usec.clear()
+	last_tick = OS.get_ticks_usec()
+
+func _on_idle_frame():
+	if current >= node_counts.size():
+		return
+	var now := OS.get_ticks_usec()
+	if frame == warmup:
+		gc_cycles_start = controllers[0].get_global_lua_stats()["gc_cycles"]
+	if frame >= warmup:
+		frame_usec.append(now - last_tick)
+		lua_usec.append(frame_stats["lua_usec"])
+		errors += frame_stats["errors"]
+	last_tick = now
+	frame_stats["lua_usec"] = 0
+	frame_stats["errors"] = 0
+	frame += 1
+	if frame >= warmup + frames:
+		_record()
+		_next_count()
+
+func _record():
+	# The stats are global, any controller returns them
+	var stats : Dictionary = controllers[0].get_global_lua_stats()
+	frame_usec.sort()
+	var lua_sorted := lua_usec.duplicate()
+	lua_sorted.sort()
+	var lua_total := 0
+	for usec in lua_usec:
+		lua_total += usec
+	var row := [
+		node_counts[current],
+		frame_usec.size(),
+		_percentile(frame_usec, 0.50) / 1000.0,
+		_percentile(frame_usec, 0.95) / 1000.0,
+		_percentile(frame_usec, 0.99) / 1000.0,
+		frame_usec.back() / 1000.0,
+		lua_total / 1000.0 / max(lua_usec.size(), 1),
+		_percentile(lua_sorted, 0.99) / 1000.0,
+		OS.get_static_memory_usage() / 1048576.0,
+		stats["current_bytes"] / 1048576.0,
+		stats["peak_bytes"] / 1048576.0,
+		stats["gc_cycles"] - gc_cycles_start,
+		errors,
+		]
+	var line := PoolStringArray()
+	for value in row:
+		line.append(str(value))
+	lines.append(line.join(","))
+	print("%6d nodes   frame p50 %8.3f ms   p99 %8.3f ms   lua %8.3f ms/frame   static %8.1f MB   lua %8.1f MB" % [
+		row[0], row[2], row[4], row[6], row[8], row[9]])
+
+func _percentile(sorted : Array, p : float) -> float:
+	if sorted.empty():
+		return 0.0
+	return float(sorted[min(int(sorted.size() * p), sorted.size() - 1)])
+
+func _save():
+	var file := File.new()
+	if file.open(output, File.WRITE) != OK:
+		printerr("Couldn't save the results to ", output)
+		quit(1)
+		return
+	file.store_string(lines.join("\n") + "\n")
+	file.close()
+	print("Results saved to ", ProjectSettings.globalize_path(output))
+	quit()
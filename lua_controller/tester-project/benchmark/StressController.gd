@@ -0,0 +1,33 @@
+# A LuaController driven by RunStress.gd: its script steers it towards a target
+# through callables, and it runs once per frame
+extends LuaController
+
+var position := Vector2()
+var velocity := Vector2()
+var target := Vector2()
+# Shared by every controller, it sums the usec spent in run() this frame
+var frame_stats : Dictionary
+
+func _ready():
+	set_methods_to_register({
+		"get_position":"get_position",
+		"get_target":"get_target",
+		"set_velocity":"set_velocity"
+		})
+
+func _process(delta):
+	var start := OS.get_ticks_usec()
+	var err := run()
+	frame_stats["lua_usec"] += OS.get_ticks_usec() - start
+	if err != OK:
+		frame_stats["errors"] += 1
+	position += velocity * delta
+
+func get_position():
+	return position
+
+func get_target():
+	return target
+
+func set_velocity(v):
+	velocity = v
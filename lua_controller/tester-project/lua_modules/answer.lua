@@ -0,0 +1,10 @@
+-- Module used by the unit tests of require() with res:// paths
+local answer = {}
+
+answer.value = 42
+
+function answer.double ()
+	return answer.value * 2
+end
+
+return answer
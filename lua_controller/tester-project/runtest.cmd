@@ -7,6 +7,8 @@ IF NOT DEFINED GODOT_BIN (
 	EXIT /b -1
 )
 
+IF "%1"=="--stress" GOTO stress
+
 %GODOT_BIN% --no-window -s -d .\addons\gdUnit3\bin\GdUnitCmdTool.gd %*
 SET exit_code=%errorlevel%
 %GODOT_BIN% --no-window --quiet -s -d .\addons\gdUnit3\bin\GdUnitCopyLog.gd %*
@@ -14,3 +16,7 @@ SET exit_code=%errorlevel%
 ECHO %exit_code%
 
 EXIT /B %exit_code%
+
+:stress
+%GODOT_BIN% --no-window -s res://benchmark/RunStress.gd %2 %3 %4 %5 %6 %7 %8 %9
+EXIT /B %errorlevel%
@@ -6,6 +6,13 @@ if [ -z "$GODOT_BIN" ]; then
     exit 1
 fi
 
+# ./runtest.sh --stress [--nodes=100,1000,10000] [--frames=300] [--output=path] runs the stress benchmark instead
+if [ "$1" = "--stress" ]; then
+    shift
+    $GODOT_BIN --no-window -s res://benchmark/RunStress.gd $*
+    exit $?
+fi
+
 $GODOT_BIN --no-window -s -d ./addons/gdUnit3/bin/GdUnitCmdTool.gd $*
 exit_code=$?
 $GODOT_BIN --no-window --quiet -s -d ./addons/gdUnit3/bin/GdUnitCopyLog.gd $* > /dev/null
@@ -0,0 +1,65 @@
+# GdUnit generated TestSuite
+#warning-ignore-all:unused_argument
+#warning-ignore-all:return_value_discarded
+class_name StateAsyncCompileTest
+extends GdUnitTestSuite
+
+var ctrl : LuaController
+var ctrl_script := load("res://HasResult.gd")
+
+func before_test():
+	ctrl = LuaController.new()
+	ctrl.set_script(ctrl_script)
+	add_child(ctrl)
+
+func after_test():
+	ctrl.queue_free()
+
+
+func test_compile_async_ok():
+	ctrl.set_lua_code("result(7)")
+	assert_int(ctrl.compile_async()) \
+		.is_equal(OK)
+	assert_bool(ctrl.is_compiling()).is_true()
+	assert_int(ctrl.compile_async()) \
+		.is_equal(ERR_BUSY)
+	assert_int(ctrl.run()) \
+		.is_equal(ERR_BUSY)
+	var err = yield(ctrl, "compiled")
+	assert_int(err).is_equal(OK)
+	assert_bool(ctrl.is_compiling()).is_false()
+	assert_int(ctrl.run()) \
+		.is_equal(OK)
+	assert_that(ctrl.result).is_equal(7)
+
+func test_compile_async_error():
+	ctrl.set_lua_code("p")
+	ctrl.compile_async()
+	var err = yield(ctrl, "compiled")
+	assert_int(err).is_equal(ERR_COMPILATION_FAILED)
+	assert_str(ctrl.get_error_message()) \
+		.is_equal("[LOGIC ERROR] : [string \"p\"]:1: syntax error near <eof>".c_unescape())
+	assert_int(ctrl.run()) \
+		.is_equal(ERR_INVALID_DATA)
+
+func test_compile_async_code_changed():
+	ctrl.set_lua_code("result(1)")
+	ctrl.compile_async()
+	ctrl.set_lua_code("result(2)")
+	var err = yield(ctrl, "compiled")
+	assert_int(err).is_equal(ERR_INVALID_DATA)
+	assert_int(ctrl.run()) \
+		.is_equal(ERR_INVALID_DATA)
+
+func test_compile_async_script_source():
+	var script := LuaScript.new()
+	script.set_source_code("result(3)")
+	ctrl.set_lua_script(script)
+	ctrl.compile_async()
+	var err = yield(ctrl, "compiled")
+	assert_int(err).is_equal(OK)
+	# The snippet compiled on the thread is installed into the script
+	assert_bool(script.is_compiled()).is_true()
+	assert_int(ctrl.run()) \
+		.is_equal(OK)
+	assert_that(ctrl.result).is_equal(3)